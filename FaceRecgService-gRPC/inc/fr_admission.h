@@ -0,0 +1,169 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Admission control of rpcs, ahead of their work.
+ * @details	Each rpc serves at most maxConcurrent requests at once. Others
+ *          wait in its queue, first come first served, and a finishing
+ *          request hands its slot to the oldest one. The queues of all rpcs
+ *          together hold at most maxQueue requests; past that a request is
+ *          rejected at once instead of making every queued one later.
+ *          A request is dropped as late when its deadline has passed, when
+ *          the expected wait plus the mean service time of its rpc go past
+ *          it, or when it expires while waiting. The expected wait is the
+ *          requests ahead times the mean service time, over maxConcurrent.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <ostream>
+
+#include "fr_histogram.h"
+#include "fr_metrics.h"
+
+/**
+ * @brief Limits of FrAdmission.
+ */
+struct FrAdmissionOptions {
+    /// Requests of one rpc served at once, 0 means one per core.
+    int maxConcurrent = 0;
+    /// Requests waiting for a slot, all rpcs together.
+    int maxQueue = 64;
+};
+
+/**
+ * @brief Bounded queues and concurrency limits of the rpcs of a server.
+ */
+class FrAdmission {
+    public:
+        typedef std::chrono::system_clock::time_point Deadline;
+        enum Verdict {
+            kAdmitted,
+            /// The queues are full.
+            kQueueFull,
+            /// The deadline has passed or cannot be met.
+            kLate
+        };
+
+        /// No default constructor.
+        FrAdmission() = delete;
+        explicit FrAdmission(const FrAdmissionOptions &options);
+        FrAdmission(const FrAdmission&) = delete;
+        FrAdmission& operator=(const FrAdmission&) = delete;
+
+        /**
+         * @brief			    Take a slot of an rpc, waiting for it if
+         *                      needed.
+         * @param[in] rpc 	    Rpc of the request.
+         * @param[in] deadline  Deadline of the request, as given by
+         *                      grpc::ServerContext::deadline().
+         * @return			    kAdmitted if the request holds a slot and
+         *                      must leave() once done.
+         */
+        Verdict enter(FrMetrics::Rpc rpc, Deadline deadline);
+        /**
+         * @brief			Give the slot of an admitted request back.
+         * @param[in] rpc 	Rpc of the request.
+         * @param[in] us 	Time the request held the slot.
+         * @return			Void.
+         */
+        void leave(FrMetrics::Rpc rpc, uint64_t us);
+
+        /// Slots of each rpc.
+        int maxConcurrent() const { return maxConcurrent_; }
+        /// Print admitted, rejected and dropped requests, and queue waits.
+        void dump(std::ostream &os) const;
+        /// Same counters in Prometheus text format.
+        void exposition(std::ostream &os) const;
+
+    private:
+        /// Request parked in a queue.
+        struct Waiter {
+            std::condition_variable ready;
+            /// Set with the slot handed over.
+            bool admitted = false;
+        };
+        struct Lane {
+            int running = 0;
+            /// Oldest first.
+            std::list<Waiter*> waiters;
+            /// Moving average of the time a slot is held, in us.
+            double serviceUs = 0;
+            uint64_t admitted = 0;
+            uint64_t queueFull = 0;
+            uint64_t late = 0;
+            /// Time admitted requests waited, in us.
+            FrHistogram waitUs;
+        };
+
+        const int maxConcurrent_;
+        const int maxQueue_;
+        mutable std::mutex mutex_;
+        /// Requests in all the queues.
+        int waiting_ = 0;
+        Lane lanes_[FrMetrics::kRpcCount];
+};
+
+/**
+ * @brief Slot of one request, given back on destruction.
+ * @code
+ * FrAdmitScope admit(admission, FrMetrics::kIdentify, context->deadline());
+ * if (!admit.admitted()) {
+ *     return rejection(admit.verdict());
+ * }
+ * @endcode
+ */
+class FrAdmitScope {
+    public:
+        /**
+         * @brief			    Enter admission.
+         * @param[in] admission Admission of the server, null admits all.
+         * @param[in] rpc 	    Rpc of the request.
+         * @param[in] deadline  Deadline of the request.
+         */
+        FrAdmitScope(FrAdmission *admission, FrMetrics::Rpc rpc,
+                    FrAdmission::Deadline deadline)
+                : admission_(admission), rpc_(rpc),
+                verdict_(nullptr == admission ? FrAdmission::kAdmitted
+                        : admission->enter(rpc, deadline)),
+                begin_(std::chrono::steady_clock::now()) {
+        }
+        ~FrAdmitScope() {
+            if (nullptr != admission_ && admitted()) {
+                admission_->leave(rpc_,
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - begin_).count());
+            }
+        }
+        FrAdmitScope(const FrAdmitScope&) = delete;
+        FrAdmitScope& operator=(const FrAdmitScope&) = delete;
+
+        bool admitted() const { return FrAdmission::kAdmitted == verdict_; }
+        FrAdmission::Verdict verdict() const { return verdict_; }
+
+    private:
+        FrAdmission *admission_;
+        const FrMetrics::Rpc rpc_;
+        const FrAdmission::Verdict verdict_;
+        const std::chrono::steady_clock::time_point begin_;
+};
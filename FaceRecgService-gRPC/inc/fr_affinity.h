@@ -0,0 +1,58 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	CPU sets of the worker threads, NUMA nodes included.
+ * @details	Linux places the pages a thread touches first on the node of the
+ *          CPU running it. A worker pinned to one CPU before allocating its
+ *          own buffers thus keeps them on its node, without libnuma.
+ *          Nodes are read from /sys/devices/system/node.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief			Parse a CPU list such as "0-7,16-23".
+ * @param[in] text 	Ranges and single CPUs, comma separated.
+ * @param[out] cpus CPUs in the given order.
+ * @return			False if the text is malformed.
+ */
+bool frParseCpuList(const std::string &text, std::vector<int> *cpus);
+
+/// CPUs of each NUMA node, a single node of all CPUs without sysfs.
+std::vector<std::vector<int>> frNumaNodes();
+
+/**
+ * @brief			Resolve the CPUs of a worker pool.
+ * @param[in] spec 	"" for no pinning, "all" for every CPU, "node:N" for
+ *                  the CPUs of node N, or a CPU list. CPUs of "all" are
+ *                  taken from each node in turn, so that a pool smaller
+ *                  than the machine is spread over every node.
+ * @param[out] cpus CPUs the workers are pinned to, one each in turn.
+ * @return			False if the spec is malformed or names no CPU.
+ */
+bool frResolveCpus(const std::string &spec, std::vector<int> *cpus);
+
+/// Node of a CPU, 0 if unknown.
+int frNodeOfCpu(int cpu);
+
+/// Pin the calling thread to one CPU, false if refused.
+bool frPinThread(int cpu);
@@ -0,0 +1,324 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Approximate nearest-neighbour indexes for the face gallery.
+ * @details	Two indexes trade recall for speed on unit-length features:
+ *          - FrHnswIndex, a hierarchical navigable small world graph, for
+ *            low latency. efSearch tunes recall against latency.
+ *          - FrIvfPqIndex, an inverted file over a coarse k-means quantizer
+ *            whose residuals are product-quantized to subvectors bytes, for
+ *            memory footprint. nprobe and refine tune recall against
+ *            latency.
+ *          Indexes refer to faces by a stable uint32 label and read the
+ *          features they need through a FrVectorStore, so the gallery's
+ *          matrix stays the only copy of the floats.
+ *          Indexes are not thread-safe: the gallery serializes writers
+ *          against readers. An index needing a slow training hands it out
+ *          as an FrAnnTrainer, which the gallery runs without its lock.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "interface_face_recognizer.h"
+
+/**
+ * @brief Gives read access to the unit features by label.
+ */
+class FrVectorStore {
+    public:
+        virtual ~FrVectorStore() {}
+        /// HIAR_FACE_FEATURE_LEN floats of the label, valid until next write.
+        virtual const float* vectorOf(uint32_t label) const = 0;
+};
+
+/**
+ * @brief One result of an index search.
+ */
+struct FrAnnResult {
+    uint32_t label;
+    /// Cosine similarity, approximate for quantized indexes.
+    float score;
+};
+
+/**
+ * @brief Training of an index on a copy of its faces.
+ */
+class FrAnnTrainer {
+    public:
+        virtual ~FrAnnTrainer() {}
+        /// The slow part, touches neither the index nor the store.
+        virtual void run() = 0;
+};
+
+/**
+ * @brief Interface of approximate indexes.
+ */
+class FrAnnIndex {
+    public:
+        virtual ~FrAnnIndex() {}
+        /**
+         * @brief			Index a face, its feature is read from the store.
+         * @param[in] label Label never indexed before.
+         * @return			Void.
+         */
+        virtual void add(uint32_t label) = 0;
+        /**
+         * @brief			Forget a face.
+         * @param[in] label Indexed label.
+         * @return			Void.
+         */
+        virtual void remove(uint32_t label) = 0;
+        /**
+         * @brief			    Approximate best matches of a probe.
+         * @param[in] probe 	Unit feature.
+         * @param[in] topK      Max number of results.
+         * @param[in] effort    Overrides efSearch / nprobe if positive.
+         * @return			    Results, best first.
+         */
+        virtual std::vector<FrAnnResult> search(const float *probe, int topK,
+                                                int effort) const = 0;
+        /// False while the index cannot answer, e.g. not trained yet.
+        virtual bool ready() const = 0;
+        /**
+         * @brief   Copy what a training needs once it is due, with read
+         *          access only. At most one trainer is out at a time.
+         * @return  Trainer to run then give to finishTraining(),
+         *          null if no training is due.
+         */
+        virtual std::unique_ptr<FrAnnTrainer> startTraining() const {
+            return nullptr;
+        }
+        /**
+         * @brief			    Install a training run since startTraining(),
+         *                      with the faces added or removed meanwhile.
+         * @param[in] trainer   Trainer of this index, already run.
+         * @return			    Void.
+         */
+        virtual void finishTraining(
+                        std::unique_ptr<FrAnnTrainer> /* trainer */) {
+        }
+        /// Bytes held by the index itself, features of the store excluded.
+        virtual size_t memoryBytes() const = 0;
+        /// Short description with the parameters.
+        virtual std::string describe() const = 0;
+};
+
+/**
+ * @brief Parameters of FrHnswIndex.
+ */
+struct FrHnswParams {
+    /// Links per node on upper layers, twice as many on layer 0.
+    int M = 16;
+    /// Candidates kept while linking a new node.
+    int efConstruction = 200;
+    /// Candidates kept while searching, at least topK.
+    int efSearch = 64;
+    uint32_t seed = 100;
+};
+
+/**
+ * @brief Hierarchical navigable small world graph.
+ *        Removing a face relinks the nodes linking to it, kept as reverse
+ *        links, and frees its slot for the next face added.
+ */
+class FrHnswIndex final : public FrAnnIndex {
+    public:
+        /// No default constructor.
+        FrHnswIndex() = delete;
+        /**
+         * @brief			    Constructor.
+         * @param[in] store 	Features of the labels, outlives the index.
+         * @param[in] params    Parameters.
+         */
+        FrHnswIndex(const FrVectorStore *store, const FrHnswParams &params);
+
+        void add(uint32_t label) override;
+        void remove(uint32_t label) override;
+        std::vector<FrAnnResult> search(const float *probe, int topK,
+                                        int effort) const override;
+        bool ready() const override { return true; }
+        size_t memoryBytes() const override;
+        std::string describe() const override;
+
+    private:
+        /// (distance, node), distance is 1 - cosine.
+        typedef std::pair<float, uint32_t> Candidate;
+
+        const float* vectorOfNode(uint32_t node) const {
+            return store_->vectorOf(labels_[node]);
+        }
+        float distance(const float *probe, uint32_t node) const;
+        /// Neighbours of node on level, count first.
+        uint32_t* linksOf(uint32_t node, int level);
+        const uint32_t* linksOf(uint32_t node, int level) const;
+        int maxLinks(int level) const { return 0 == level ? 2 * M_ : M_; }
+        /// Closest node reachable greedily from entry on level.
+        uint32_t greedy(const float *probe, uint32_t entry, int level) const;
+        /// Up to ef closest nodes from entry on level, closest first.
+        std::vector<Candidate> searchLayer(const float *probe, uint32_t entry,
+                                            int ef, int level) const;
+        /// Keep up to maxCount diverse neighbours, closest first.
+        std::vector<Candidate> selectNeighbours(
+                            const std::vector<Candidate> &candidates,
+                            int maxCount) const;
+        /// Replace the links of node on level, keeping linkedFrom_ in step.
+        void setLinks(uint32_t node, int level,
+                    const std::vector<uint32_t> &targets);
+        /// Link node to neighbour on level, pruning when full.
+        void connect(uint32_t node, uint32_t neighbour, int level);
+
+        const FrVectorStore *store_;
+        const int M_;
+        const int efConstruction_;
+        const int efSearch_;
+        const double levelMult_;
+        std::mt19937 rng_;
+
+        std::vector<uint32_t> labels_;
+        std::vector<uint8_t> deleted_;
+        std::vector<int> levels_;
+        /// Layer 0 links, (2M + 1) words per node: count then ids.
+        std::vector<uint32_t> links0_;
+        /// Upper layers links of each node, (M + 1) words per level.
+        std::vector<std::vector<uint32_t>> upperLinks_;
+        /// Nodes linking to each node, by level.
+        std::vector<std::vector<std::vector<uint32_t>>> linkedFrom_;
+        /// Slots of removed nodes, linked from nowhere.
+        std::vector<uint32_t> freeNodes_;
+        std::unordered_map<uint32_t, uint32_t> nodeOf_;
+        uint32_t entry_ = 0;
+        int maxLevel_ = -1;
+        size_t alive_ = 0;
+};
+
+/**
+ * @brief Parameters of FrIvfPqIndex.
+ */
+struct FrIvfPqParams {
+    /// Coarse centroids, i.e. inverted lists.
+    int nlist = 1024;
+    /// Lists scanned per search.
+    int nprobe = 16;
+    /// Bytes per code, must divide HIAR_FACE_FEATURE_LEN.
+    int subvectors = 64;
+    /// Best candidates re-scored exactly, as a multiple of topK, 0 disables.
+    int refine = 4;
+    /// Faces gathered before training, as a multiple of nlist; the
+    /// quantizers are trained on that many faces at most.
+    int trainPerList = 32;
+    /// Retrain once the faces added or removed since the last training
+    /// reach this fraction of the faces it saw, 0 disables.
+    float retrain = 1.0f;
+    /// Iterations of each k-means.
+    int trainIters = 10;
+    uint32_t seed = 100;
+};
+
+/**
+ * @brief Inverted file with product-quantized residuals.
+ *        Faces added before training wait in a pending list; once
+ *        nlist * trainPerList faces wait, startTraining() copies them and
+ *        the quantizers are trained on the copy, searches falling back to
+ *        the exhaustive scan until finishTraining(). Once enough faces
+ *        came or went, the index is retrained the same way on a copy of
+ *        all its faces, searches using the old quantizers meanwhile.
+ */
+class FrIvfPqIndex final : public FrAnnIndex {
+    public:
+        /// Centroids of each sub-quantizer, one byte per subvector.
+        static const int kCodebook = 256;
+
+        /// No default constructor.
+        FrIvfPqIndex() = delete;
+        /**
+         * @brief			    Constructor.
+         * @param[in] store 	Features of the labels, outlives the index.
+         * @param[in] params    Parameters.
+         */
+        FrIvfPqIndex(const FrVectorStore *store, const FrIvfPqParams &params);
+
+        void add(uint32_t label) override;
+        void remove(uint32_t label) override;
+        std::vector<FrAnnResult> search(const float *probe, int topK,
+                                        int effort) const override;
+        bool ready() const override { return trained_; }
+        std::unique_ptr<FrAnnTrainer> startTraining() const override;
+        void finishTraining(std::unique_ptr<FrAnnTrainer> trainer) override;
+        size_t memoryBytes() const override;
+        std::string describe() const override;
+
+    private:
+        class Trainer;
+
+        struct InvertedList {
+            std::vector<uint32_t> labels;
+            /// subvectors bytes per label.
+            std::vector<uint8_t> codes;
+        };
+
+        /// Append a face to its inverted list.
+        void encode(uint32_t label);
+        /// Append a face encoded elsewhere.
+        void append(uint32_t label, int list, const uint8_t *code);
+        int nearestCentroid(const float *feature) const;
+
+        const FrVectorStore *store_;
+        const FrIvfPqParams params_;
+        const int subDim_;
+
+        bool trained_ = false;
+        /// A trainer is out.
+        mutable std::atomic<bool> training_{false};
+        /// Faces seen by the last training.
+        size_t trainedFaces_ = 0;
+        /// Faces added or removed since the last training.
+        size_t changes_ = 0;
+        std::vector<uint32_t> pending_;
+        /// nlist x HIAR_FACE_FEATURE_LEN.
+        std::vector<float> centroids_;
+        /// subvectors x kCodebook x subDim_.
+        std::vector<float> codebooks_;
+        std::vector<InvertedList> lists_;
+        /// label -> (list, position).
+        std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> where_;
+};
+
+/**
+ * @brief				Create an index by name.
+ * @param[in] type 		"hnsw" or "ivfpq", anything else gives null,
+ *                      i.e. exhaustive search.
+ * @param[in] store     Features of the labels.
+ * @param[in] hnsw      Parameters used for "hnsw".
+ * @param[in] ivfpq     Parameters used for "ivfpq".
+ * @return				New index or null.
+ */
+std::unique_ptr<FrAnnIndex> frCreateAnnIndex(const std::string &type,
+                                        const FrVectorStore *store,
+                                        const FrHnswParams &hnsw,
+                                        const FrIvfPqParams &ivfpq);
@@ -0,0 +1,66 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Protobuf arenas of one rpc, on blocks reused by each thread.
+ * @details	A reply with faces grows its rects and features through small
+ *          allocations, and the request adds its own. Messages created on
+ *          an FrCallArena take them from one block, released at once with
+ *          the arena. The block comes from a small cache of the thread and
+ *          goes back to the cache of the thread destroying the arena, so
+ *          that a warm server does no malloc for its messages; bytes
+ *          fields still allocate their buffers.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include <google/protobuf/arena.h>
+
+/**
+ * @brief Arena of the messages of one rpc.
+ * @code
+ * FrCallArena arena;
+ * FeatureReply *reply = arena.create<FeatureReply>();
+ * @endcode
+ */
+class FrCallArena {
+    public:
+        /// Bytes of the reused block, a reply of 20 faces as floats.
+        static const size_t kBlockBytes = 64 << 10;
+
+        FrCallArena();
+        /// Frees every message of the arena, then keeps the block.
+        ~FrCallArena();
+        FrCallArena(const FrCallArena&) = delete;
+        FrCallArena& operator=(const FrCallArena&) = delete;
+
+        /// New message owned by the arena.
+        template <class Message>
+        Message* create() {
+            return google::protobuf::Arena::CreateMessage<Message>(&arena_);
+        }
+        google::protobuf::Arena* get() { return &arena_; }
+
+    private:
+        /// Block of the thread cache or a new one, before the arena.
+        std::unique_ptr<char[]> block_;
+        google::protobuf::Arena arena_;
+};
@@ -0,0 +1,148 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Pipelined client keeping many unary rpcs in flight.
+ * @details	A blocking stub waits a whole round trip per image, so an
+ *          uploader far from the server is bound by the latency instead of
+ *          the bandwidth. This client starts rpcs on a completion queue
+ *          without waiting, spreads them over several channels, and hands
+ *          the replies to callbacks or futures as they come back.
+ *          At most "window" rpcs are in flight: a call finding the window
+ *          full blocks until a reply frees a slot, which throttles the
+ *          caller to the pace of the server.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <grpcpp/grpcpp.h>
+
+#include "FaceRecg.grpc.pb.h"
+
+/**
+ * @brief Asynchronous client of the service.
+ * @code
+ * FrAsyncClient client("localhost:50051", 2, 16);
+ * for (const auto &request : requests) {
+ *     client.featureDetect(request, [](const grpc::Status &status,
+ *                                      facerecg::FeatureReply &reply) {
+ *         // Runs on a thread of the client, keep it short.
+ *     });
+ * }
+ * client.drain();
+ * @endcode
+ */
+class FrAsyncClient {
+    public:
+        template <class Reply>
+        using Callback = std::function<void(const grpc::Status&, Reply&)>;
+
+        /// No default constructor.
+        FrAsyncClient() = delete;
+        /**
+         * @brief			    Constructor, connects lazily.
+         * @param[in] target 	Server address.
+         * @param[in] channels 	Channels, i.e. connections, used in turn.
+         * @param[in] window 	Max rpcs in flight, std::invalid_argument
+         *                      unless positive.
+         */
+        FrAsyncClient(const std::string &target, int channels, int window);
+        /// Waits for the rpcs in flight.
+        ~FrAsyncClient();
+        FrAsyncClient(const FrAsyncClient&) = delete;
+        FrAsyncClient& operator=(const FrAsyncClient&) = delete;
+
+        /**
+         * @brief			    Start a featureDetect, blocking while the
+         *                      window is full.
+         * @param[in] request 	Request, copied before returning.
+         * @param[in] done 	    Called once with the outcome, on a thread of
+         *                      the client. It may start new rpcs, which
+         *                      never block: the first one takes the slot
+         *                      of the finished rpc, the next ones go past
+         *                      the window.
+         * @return			    Void.
+         */
+        void featureDetect(const facerecg::DetectRequest &request,
+                            Callback<facerecg::FeatureReply> done);
+        /// featureExtract, same as featureDetect.
+        void featureExtract(const facerecg::FeatureRequest &request,
+                            Callback<facerecg::FeatureReply> done);
+        /// getFaceQuality, same as featureDetect.
+        void getFaceQuality(const facerecg::QualityRequest &request,
+                            Callback<facerecg::QualityReply> done);
+
+        /**
+         * @brief			    Future flavours, failed rpcs throw
+         *                      std::runtime_error from get().
+         * @param[in] request 	Request, copied before returning.
+         * @return			    Future of the reply.
+         */
+        std::future<facerecg::FeatureReply> featureDetect(
+                            const facerecg::DetectRequest &request);
+        std::future<facerecg::FeatureReply> featureExtract(
+                            const facerecg::FeatureRequest &request);
+        std::future<facerecg::QualityReply> getFaceQuality(
+                            const facerecg::QualityRequest &request);
+
+        /// Wait until every rpc started has run its callback.
+        void drain();
+        /// Max rpcs in flight.
+        int window() const { return window_; }
+
+    private:
+        struct Call;
+        template <class Request, class Reply>
+        struct UnaryCall;
+        template <class Request, class Reply>
+        using Prepare = std::unique_ptr<grpc::ClientAsyncResponseReader<Reply>>
+                        (facerecg::Frecg::Stub::*)(grpc::ClientContext*,
+                                                    const Request&,
+                                                    grpc::CompletionQueue*);
+
+        template <class Request, class Reply>
+        void start(Prepare<Request, Reply> prepare, const Request &request,
+                    Callback<Reply> done);
+        template <class Request, class Reply>
+        std::future<Reply> startFuture(Prepare<Request, Reply> prepare,
+                                        const Request &request);
+        /// Poller loop, one thread per channel.
+        void poll();
+
+        const int window_;
+        std::vector<std::unique_ptr<facerecg::Frecg::Stub>> stubs_;
+        grpc::CompletionQueue cq_;
+        std::vector<std::thread> pollers_;
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        /// Rpcs holding a slot of the window.
+        int inFlight_ = 0;
+        /// Rpcs whose callback has not returned yet.
+        int pending_ = 0;
+        size_t nextStub_ = 0;
+};
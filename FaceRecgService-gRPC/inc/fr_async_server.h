@@ -0,0 +1,156 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Completion-queue based asynchronous mode of the Frecg service.
+ * @details	The synchronous FrServiceImpl keeps one gRPC thread busy for the
+ *          whole life of an rpc. In asynchronous mode every rpc is accepted
+ *          on one of several ServerCompletionQueue objects (one per core by
+ *          default) and a fixed number of poller threads drive them. The
+ *          business logic itself is not duplicated: every call is handed to
+ *          the very same Frecg::Service implementation used in sync mode.
+ *          Handlers run on a pool of their own, so a slow SDK call keeps
+ *          the pollers accepting and finishing the other rpcs of its queue.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <grpcpp/grpcpp.h>
+
+#include "FaceRecg.grpc.pb.h"
+
+#include "fr_thread_pool.h"
+
+/**
+ * @brief Service type registered with the server in asynchronous mode.
+ *        Unary rpcs are asynchronous. Streaming rpcs own a thread for the
+ *        whole stream anyway, so they keep the sync handler of the logic.
+ */
+class FrAsyncService final
+        : public facerecg::Frecg::WithAsyncMethod_logIn<
+                facerecg::Frecg::WithAsyncMethod_featureExtract<
+                facerecg::Frecg::WithAsyncMethod_featureDetect<
+                facerecg::Frecg::WithAsyncMethod_compareFeature<
+                facerecg::Frecg::WithAsyncMethod_compareImage<
+                facerecg::Frecg::WithAsyncMethod_getFaceQuality<
+                facerecg::Frecg::WithAsyncMethod_enroll<
+                facerecg::Frecg::WithAsyncMethod_remove<
+                facerecg::Frecg::WithAsyncMethod_identify<
+                facerecg::Frecg::WithAsyncMethod_getStats<
+                facerecg::Frecg::WithAsyncMethod_compareBatch<
+                facerecg::Frecg::Service>>>>>>>>>>> {
+    public:
+        /// No default constructor.
+        FrAsyncService() = delete;
+        /**
+         * @brief			Constructor.
+         * @param[in] logic Implementation streaming rpcs are delegated to.
+         */
+        explicit FrAsyncService(facerecg::Frecg::Service *logic)
+                : logic_(logic) {}
+
+        grpc::Status featureStream(grpc::ServerContext* context,
+                    grpc::ServerReaderWriter<facerecg::FeatureReply,
+                                            facerecg::FrameRequest>* stream)
+                    override {
+            return logic_->featureStream(context, stream);
+        }
+
+    private:
+        facerecg::Frecg::Service *logic_;
+};
+
+/**
+ * @brief Drives the asynchronous Frecg service.
+ * @code
+ * FrServiceImpl logic("tmp/");
+ * FrAsyncServer asyncServer(&logic, 0, 2, 0);
+ * grpc::ServerBuilder builder;
+ * asyncServer.attach(builder);
+ * server = builder.BuildAndStart();
+ * asyncServer.start();
+ * server->Wait();
+ * asyncServer.stop();
+ * @endcode
+ */
+class FrAsyncServer {
+    public:
+        /// No default constructor.
+        FrAsyncServer() = delete;
+        /**
+         * @brief			        Constructor.
+         * @param[in] logic         Implementation every rpc is delegated to.
+         * @param[in] numCqs        Number of completion queues,
+         *                          0 means one per core.
+         * @param[in] pollersPerCq  Threads polling each completion queue.
+         * @param[in] handlers      Threads running the handlers, 0 means
+         *                          one per core and a negative number runs
+         *                          them on the pollers, which then stall
+         *                          their queue while the SDK works.
+         */
+        FrAsyncServer(facerecg::Frecg::Service *logic,
+                        int numCqs, int pollersPerCq, int handlers);
+        ~FrAsyncServer();
+        /**
+         * @brief			    Register the async service and
+         *                      its completion queues to the builder.
+         * @param[in] builder   Builder of the server, not built yet.
+         * @return			    Void.
+         */
+        void attach(grpc::ServerBuilder &builder);
+        /**
+         * @brief   Arm every rpc and launch the pollers.
+         *          Must be called after BuildAndStart().
+         * @return  Void.
+         */
+        void start();
+        /**
+         * @brief   Run the handlers queued so far, drain the completion
+         *          queues and join the pollers.
+         *          Must be called after Server::Shutdown().
+         * @return  Void.
+         */
+        void stop();
+        /// Number of completion queues in use.
+        int numCqs() const { return numCqs_; }
+        /// Number of pollers attached to each completion queue.
+        int pollersPerCq() const { return pollersPerCq_; }
+        /// Run the handler of an accepted rpc, on the pollers once stopped.
+        void dispatch(std::function<void()> handler);
+
+    private:
+        /// Poller loop of one thread.
+        void poll(grpc::ServerCompletionQueue *cq);
+
+        facerecg::Frecg::Service *logic_;
+        FrAsyncService service_;
+        int numCqs_;
+        int pollersPerCq_;
+        std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> cqs_;
+        std::vector<std::thread> pollers_;
+        bool started_ = false;
+        std::mutex handlersMutex_;
+        /// Null when handlers run on the pollers.
+        std::unique_ptr<FrThreadPool> handlers_;
+};
@@ -0,0 +1,136 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Dynamic batching of feature extraction across concurrent rpcs.
+ * @details	Callers of extract() are parked in a queue. A worker closes a
+ *          batch once it holds maxBatch faces or once its oldest job waited
+ *          maxWaitUs, runs the whole batch with one call of the executor and
+ *          wakes every caller with its own slice of the result.
+ *          The default executor merges the jobs sharing the same image into
+ *          one HiarFace_extractFeature call, since the SDK takes one encoded
+ *          image per call; a backend with a real batched entry only needs
+ *          another executor.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "fr_histogram.h"
+
+/**
+ * @brief One caller's share of a batch.
+ *        Same inputs and outputs as HiarFace_extractFeature.
+ */
+struct FrExtractJob {
+    const unsigned char *imgData = nullptr;
+    int lenImg = 0;
+    const int *faceBboxes = nullptr;
+    int numBbox = 0;
+    /// Output, allocated with new[], released by the caller.
+    float *feature = nullptr;
+    int lenFeatures = 0;
+    /// Output, 1: success, other: fail.
+    int ret = 0;
+    /// Set once the batch holding the job is done.
+    bool done = false;
+    std::chrono::steady_clock::time_point enqueued;
+};
+
+/**
+ * @brief Collects extraction jobs of concurrent callers into batches.
+ */
+class FrExtractBatcher {
+    public:
+        /// Runs a batch, must fill feature, lenFeatures and ret of each job.
+        typedef std::function<void(std::vector<FrExtractJob*>&)> Executor;
+        /// Same contract as HiarFace_extractFeature.
+        typedef std::function<int(const unsigned char*, const int,
+                                const int*, const int, float**, int*)>
+                                Extractor;
+
+        /// No default constructor.
+        FrExtractBatcher() = delete;
+        /**
+         * @brief			    Constructor, launches the workers.
+         * @param[in] maxBatch  Max faces in one batch, a single job with
+         *                      more faces makes a batch on its own.
+         * @param[in] maxWaitUs Max time a job waits for its batch to fill.
+         * @param[in] workers   Number of batches run at the same time.
+         * @param[in] executor  Runs a batch, see defaultExecutor().
+         */
+        FrExtractBatcher(int maxBatch, int maxWaitUs, int workers,
+                        Executor executor = defaultExecutor);
+        ~FrExtractBatcher();
+        /**
+         * @brief   Same contract as HiarFace_extractFeature,
+         *          blocks until the batch holding the faces is done.
+         */
+        int extract(const unsigned char *imgData, const int lenImg,
+                    const int *faceBboxes, const int numBbox,
+                    float **feature, int *lenFeatures);
+        /**
+         * @brief			Print batch-size and queueing-delay histograms.
+         * @param[in] os 	Output stream.
+         * @return			Void.
+         */
+        void dump(std::ostream &os) const;
+        /// Same histograms in Prometheus text format.
+        void exposition(std::ostream &os) const;
+        /// Faces per batch.
+        const FrHistogram& batchSizes() const { return batchSizes_; }
+        /// Time between enqueueing a job and running its batch, in us.
+        const FrHistogram& queueDelays() const { return queueDelays_; }
+        /**
+         * @brief   Default executor: one HiarFace_extractFeature call
+         *          per distinct image of the batch.
+         */
+        static void defaultExecutor(std::vector<FrExtractJob*> &batch);
+        /// Same as the default executor, with another extraction call.
+        static Executor groupingExecutor(Extractor extractor);
+
+    private:
+        /// Worker loop.
+        void run();
+        static void runGrouped(std::vector<FrExtractJob*> &batch,
+                                const Extractor &extractor);
+
+        const int maxBatch_;
+        const std::chrono::microseconds maxWait_;
+        Executor executor_;
+
+        std::mutex mutex_;
+        std::condition_variable pending_;
+        std::condition_variable finished_;
+        std::deque<FrExtractJob*> queue_;
+        /// Faces of all queued jobs.
+        int queuedFaces_ = 0;
+        bool stopping_ = false;
+        std::vector<std::thread> workers_;
+
+        FrHistogram batchSizes_;
+        FrHistogram queueDelays_;
+};
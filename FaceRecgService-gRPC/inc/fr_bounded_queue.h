@@ -0,0 +1,107 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Blocking FIFO with a fixed capacity.
+ * @details	Producers block while the queue is full, so the capacity bounds
+ *          the work that may be pending between two threads, e.g. the frames
+ *          of one stream read from the network but not served yet.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+/**
+ * @brief Blocking FIFO with a fixed capacity, closable from any side.
+ */
+template <class T>
+class FrBoundedQueue {
+    public:
+        /// No default constructor.
+        FrBoundedQueue() = delete;
+        /**
+         * @brief			    Constructor.
+         * @param[in] capacity 	Max number of pending items, at least 1.
+         */
+        explicit FrBoundedQueue(size_t capacity)
+                : capacity_(0 < capacity ? capacity : 1) {}
+        /**
+         * @brief			Append an item, blocking while the queue is full.
+         * @param[in] item 	Item to append.
+         * @return			False if the queue was closed, item is dropped.
+         */
+        bool push(T item) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            notFull_.wait(lock, [this]() {
+                return closed_ || items_.size() < capacity_;
+            });
+            if (closed_) {
+                return false;
+            }
+            items_.push_back(std::move(item));
+            notEmpty_.notify_one();
+            return true;
+        }
+        /**
+         * @brief			Take the oldest item, blocking while empty.
+         * @param[out] item Taken item.
+         * @return			False once the queue is closed and drained.
+         */
+        bool pop(T *item) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            notEmpty_.wait(lock, [this]() {
+                return closed_ || !items_.empty();
+            });
+            if (items_.empty()) {
+                return false;
+            }
+            *item = std::move(items_.front());
+            items_.pop_front();
+            notFull_.notify_one();
+            return true;
+        }
+        /**
+         * @brief   Refuse new items and wake up every waiter.
+         *          Items already queued can still be popped.
+         * @return  Void.
+         */
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            notFull_.notify_all();
+            notEmpty_.notify_all();
+        }
+        /// Number of pending items.
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return items_.size();
+        }
+
+    private:
+        const size_t capacity_;
+        bool closed_ = false;
+        std::deque<T> items_;
+        mutable std::mutex mutex_;
+        std::condition_variable notFull_;
+        std::condition_variable notEmpty_;
+};
@@ -0,0 +1,47 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Configuration file of the server.
+ * @details	One "key = value" per line, the keys being the ones of the
+ *          command line without their "--"; blank lines and lines
+ *          starting with '#' are skipped. Options given on the command
+ *          line override the file, e.g.
+ * @code
+ * # Dual-socket host, compute pinned to the first socket.
+ * address = 0.0.0.0:50051
+ * io_threads = 8
+ * compute_threads = 16
+ * compute_cpus = node:0
+ * @endcode
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief			    Read a configuration file as arguments.
+ * @param[in] path 	    Configuration file.
+ * @param[out] args 	"--key=value" of each option, appended.
+ * @param[out] error    Reason of a failure, with the line number.
+ * @return			    False if the file is unreadable or malformed.
+ */
+bool frReadConfig(const std::string &path, std::vector<std::string> *args,
+                    std::string *error);
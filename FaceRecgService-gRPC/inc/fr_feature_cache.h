@@ -0,0 +1,134 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Cache of extracted features, keyed by image content and face box.
+ * @details	Clients resend the same enrollment photo or frame with the same
+ *          box, and compareImage extracts both faces at every call. The key
+ *          is a 128-bit hash of the image bytes and of the box, so equal
+ *          requests hit whatever their origin. Each shard is an LRU with
+ *          its own lock and its share of the memory budget; entries older
+ *          than the TTL are dropped when met.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "fr_hash.h"
+
+/**
+ * @brief Features of faces already extracted.
+ */
+class FrFeatureCache {
+    public:
+        static const int kShards = 16;
+
+        /// No default constructor.
+        FrFeatureCache() = delete;
+        /**
+         * @brief			        Constructor.
+         * @param[in] budgetBytes   Memory of the entries, bookkeeping
+         *                          included.
+         * @param[in] ttlSeconds    Lifetime of an entry, 0 for no limit.
+         * @param[in] featureLen    Floats of a feature.
+         */
+        FrFeatureCache(size_t budgetBytes, double ttlSeconds, int featureLen);
+        FrFeatureCache(const FrFeatureCache&) = delete;
+        FrFeatureCache& operator=(const FrFeatureCache&) = delete;
+
+        /**
+         * @brief			Key of one face.
+         * @param[in] image Hash of the image, see FrImageContext.
+         * @param[in] box 	Left, top, width and height of the face.
+         * @return			Key.
+         */
+        static FrContentHash keyOf(const FrContentHash &image,
+                                    const int *box);
+        /**
+         * @brief			    Copy the feature of a face if cached.
+         * @param[in] key 	    Key of the face.
+         * @param[out] feature  featureLen floats.
+         * @return			    False on a miss.
+         */
+        bool lookup(const FrContentHash &key, float *feature);
+        /**
+         * @brief			    Cache the feature of a face, evicting the
+         *                      least recently used ones past the budget.
+         * @param[in] key 	    Key of the face.
+         * @param[in] feature   featureLen floats.
+         * @return			    Void.
+         */
+        void insert(const FrContentHash &key, const float *feature);
+
+        /// Print hits, misses, evictions and size.
+        void dump(std::ostream &os) const;
+        /// Same counters in Prometheus text format.
+        void exposition(std::ostream &os) const;
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+        struct Entry {
+            FrContentHash key;
+            Clock::time_point expires;
+            std::vector<float> feature;
+        };
+        struct KeyHash {
+            size_t operator()(const FrContentHash &key) const {
+                return static_cast<size_t>(key.lo);
+            }
+        };
+        struct Shard {
+            mutable std::mutex mutex;
+            /// Most recently used first.
+            std::list<Entry> lru;
+            std::unordered_map<FrContentHash, std::list<Entry>::iterator,
+                                KeyHash> index;
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+            uint64_t expired = 0;
+        };
+        struct Totals {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+            uint64_t expired = 0;
+            size_t entries = 0;
+        };
+
+        Shard& shardOf(const FrContentHash &key) {
+            return shards_[key.hi % kShards];
+        }
+        Totals totals() const;
+
+        const int featureLen_;
+        /// Estimated memory of one entry.
+        const size_t entryBytes_;
+        /// Entries of one shard within the budget.
+        const size_t shardCapacity_;
+        const Clock::duration ttl_;
+        Shard shards_[kShards];
+};
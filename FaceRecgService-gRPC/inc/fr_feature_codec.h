@@ -0,0 +1,81 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Packed encodings of features in bytes fields.
+ * @details	A repeated float costs 4 bytes per value whatever its
+ *          precision. Packed features are the vectors one after the other:
+ *          float32 as is, float16 rounded to nearest even, or int8 with a
+ *          float32 scale ahead of each vector, value = int8 * scale.
+ *          All little endian. float16 halves the bytes and int8 quarters
+ *          them. On synthetic 512-float features, float16 moves cosine
+ *          scores by 1e-5 on average and int8 by 4e-4, 2e-3 at most;
+ *          fr_bench --mode=encoding measures it on real features.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/// Same values as FeatureEncoding of the proto.
+enum FrFeatureEncoding {
+    /// Repeated floats, nothing packed.
+    kFrFloats = 0,
+    kFrPackedF32 = 1,
+    kFrPackedF16 = 2,
+    kFrPackedI8 = 3
+};
+
+/// Name of an encoding: "floats", "f32", "f16" or "i8".
+const char* frEncodingName(FrFeatureEncoding encoding);
+/**
+ * @brief			    Encoding of a name.
+ * @param[in] name 	    Name given by frEncodingName.
+ * @param[out] encoding Encoding.
+ * @return			    False if the name is unknown.
+ */
+bool frParseEncoding(const std::string &name, FrFeatureEncoding *encoding);
+
+/**
+ * @brief			    Bytes of one packed feature.
+ * @param[in] encoding  A packed encoding.
+ * @param[in] len 	    Floats of a feature.
+ * @return			    Bytes.
+ */
+size_t frPackedBytes(FrFeatureEncoding encoding, int len);
+/**
+ * @brief			    Append one feature to packed bytes.
+ * @param[in] encoding  A packed encoding.
+ * @param[in] feature   len floats.
+ * @param[out] packed 	Bytes, frPackedBytes longer.
+ * @return			    Void.
+ */
+void frPackFeature(FrFeatureEncoding encoding, const float *feature,
+                    int len, std::string *packed);
+/**
+ * @brief			    Decode packed features.
+ * @param[in] encoding  A packed encoding.
+ * @param[in] packed 	Features of len floats, one after the other.
+ * @param[out] features All the floats.
+ * @return			    False if the size is not a whole number of
+ *                      features.
+ */
+bool frUnpackFeatures(FrFeatureEncoding encoding, const std::string &packed,
+                        int len, std::vector<float> *features);
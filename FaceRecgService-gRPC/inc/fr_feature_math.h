@@ -0,0 +1,101 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Small numeric kernels on face features.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <cmath>
+
+/**
+ * @brief			Dot product of two float vectors.
+ * @details         Independent partial sums let the compiler keep
+ *                  them in vector registers.
+ * @param[in] a 	First vector.
+ * @param[in] b 	Second vector.
+ * @param[in] len 	Length of both vectors.
+ * @return			Sum of a[i] * b[i].
+ */
+inline float frDotProduct(const float *a, const float *b, int len) {
+    float acc[16] = {0};
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        for (int k = 0; k < 16; k++) {
+            acc[k] += a[i + k] * b[i + k];
+        }
+    }
+    float sum = 0;
+    for (; i < len; i++) {
+        sum += a[i] * b[i];
+    }
+    for (int k = 0; k < 16; k++) {
+        sum += acc[k];
+    }
+    return sum;
+}
+
+/**
+ * @brief			Squared euclidean distance of two float vectors.
+ * @param[in] a 	First vector.
+ * @param[in] b 	Second vector.
+ * @param[in] len 	Length of both vectors.
+ * @return			Sum of (a[i] - b[i])^2.
+ */
+inline float frSquaredL2(const float *a, const float *b, int len) {
+    float acc[16] = {0};
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        for (int k = 0; k < 16; k++) {
+            float d = a[i + k] - b[i + k];
+            acc[k] += d * d;
+        }
+    }
+    float sum = 0;
+    for (; i < len; i++) {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    for (int k = 0; k < 16; k++) {
+        sum += acc[k];
+    }
+    return sum;
+}
+
+/**
+ * @brief			Copy a vector scaled to unit length.
+ * @param[in] src 	Vector to normalize.
+ * @param[out] dst 	Normalized vector, may be src.
+ * @param[in] len 	Length of both vectors.
+ * @return			False if src is all zeros, dst is left untouched.
+ */
+inline bool frNormalize(const float *src, float *dst, int len) {
+    double norm = 0;
+    for (int i = 0; i < len; i++) {
+        norm += static_cast<double>(src[i]) * src[i];
+    }
+    if (0 >= norm) {
+        return false;
+    }
+    float scale = static_cast<float>(1.0 / std::sqrt(norm));
+    for (int i = 0; i < len; i++) {
+        dst[i] = src[i] * scale;
+    }
+    return true;
+}
@@ -0,0 +1,193 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	In-memory gallery of enrolled faces for 1:N identification.
+ * @details	Features are L2-normalized at enrollment and kept as one
+ *          contiguous row-major matrix of HIAR_FACE_FEATURE_LEN floats per
+ *          row, 64-byte aligned, so a probe is scored against the whole
+ *          gallery with a vectorized dot product (i.e. cosine similarity).
+ *          The rows are split across the threads of a pool, each thread keeps
+ *          its own top-k and the partial lists are merged at the end.
+ *          An approximate index (see fr_ann_index.h) may be attached to
+ *          replace the exhaustive scan; it reads the features of this matrix
+ *          through stable labels, since rows move when faces are removed.
+ *          An index needing training is trained on a copy of the faces by
+ *          the caller of train(), outside the lock; a gallery store leaves
+ *          it to its background thread.
+ *          The faces may also start from a gallery file (see
+ *          fr_gallery_file.h): its mapped matrix is searched in place, faces
+ *          enrolled later go to an in-memory delta and faces removed from it
+ *          are masked. The whole content is one State swapped atomically, so
+ *          a new file or index is prepared without blocking searches.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "interface_face_recognizer.h"
+#include "fr_ann_index.h"
+#include "fr_gallery_file.h"
+#include "fr_gallery_wal.h"
+#include "fr_rwlock.h"
+#include "fr_thread_pool.h"
+
+/**
+ * @brief One candidate of an identification.
+ */
+struct FrMatch {
+    std::string id;
+    /// Cosine similarity in [-1, 1].
+    float score;
+};
+
+/**
+ * @brief Enrolled features with their ids, searched exhaustively
+ *        or through an approximate index.
+ */
+class FrGallery {
+    public:
+        /// Bytes alignment of the feature matrix.
+        static const size_t kAlignment = 64;
+
+        /// Builds an empty index reading its features from a store.
+        typedef std::function<std::unique_ptr<FrAnnIndex>(
+                                            const FrVectorStore*)> IndexFactory;
+        /// Content of the gallery: file, delta, masks and index.
+        class State;
+
+        /// No default constructor.
+        FrGallery() = delete;
+        /**
+         * @brief			        Constructor.
+         * @param[in] pool          Threads sharing a scan, may be null.
+         * @param[in] rowsPerTask   Min rows scanned by one thread,
+         *                          small galleries stay on the caller thread.
+         */
+        explicit FrGallery(FrThreadPool *pool, size_t rowsPerTask = 4096);
+        ~FrGallery();
+        FrGallery(const FrGallery&) = delete;
+        FrGallery& operator=(const FrGallery&) = delete;
+
+        /**
+         * @brief			    Add a face, or replace the feature of the id.
+         * @param[in] id 	    Identity of the face.
+         * @param[in] feature   HIAR_FACE_FEATURE_LEN floats.
+         * @param[in] train     Train the index if due before returning,
+         *                      else the caller calls train() later.
+         * @return			    False if the feature is all zeros.
+         */
+        bool enroll(const std::string &id, const float *feature,
+                    bool train = true);
+        /**
+         * @brief			Remove a face.
+         * @param[in] id 	Identity of the face.
+         * @return			False if the id was not enrolled.
+         */
+        bool remove(const std::string &id);
+        /**
+         * @brief			    Best matches of a probe.
+         * @param[in] probe 	HIAR_FACE_FEATURE_LEN floats.
+         * @param[in] topK      Max number of matches.
+         * @param[in] minScore  Matches below are dropped.
+         * @param[in] effort    Search effort of the index if positive,
+         *                      see FrAnnIndex::search.
+         * @return			    Matches, best first.
+         */
+        std::vector<FrMatch> identify(const float *probe, int topK,
+                                    float minScore, int effort = 0) const;
+        /**
+         * @brief			        Exhaustive search, even with an index.
+         * @param[in] probe 	    HIAR_FACE_FEATURE_LEN floats.
+         * @param[in] topK          Max number of matches.
+         * @param[in] minScore      Matches below are dropped.
+         * @return			        Matches, best first.
+         */
+        std::vector<FrMatch> identifyExact(const float *probe, int topK,
+                                        float minScore) const;
+        /**
+         * @brief			    Index the faces with indexes of a factory,
+         *                      or search exhaustively with an empty one.
+         *                      Faces already enrolled get indexed.
+         * @param[in] factory   Builds the indexes of this gallery.
+         * @return			    Void.
+         */
+        void setIndex(IndexFactory factory);
+        /// Description of the search in use.
+        std::string describeIndex() const;
+        /// Number of enrolled faces.
+        size_t size() const;
+
+        /**
+         * @brief			    Build a content starting from a gallery file,
+         *                      without blocking the gallery.
+         * @param[in] file 	    Gallery file, may be null.
+         * @param[in] withIndex Also index the faces of the file, slow.
+         * @return			    Content to commit.
+         */
+        std::shared_ptr<State> prepare(
+                                std::shared_ptr<const FrGalleryFile> file,
+                                bool withIndex) const;
+        /**
+         * @brief			Replace the content, after applying changes to it.
+         * @param[in] state Content from prepare().
+         * @param[in] ops   Changes made since the file of the content.
+         * @param[in] train Train the index if due before returning,
+         *                  else the caller calls train() later.
+         * @return			Void.
+         */
+        void commit(std::shared_ptr<State> state,
+                    const std::vector<FrGalleryOp> &ops, bool train = true);
+        /**
+         * @brief   Train the index if it is due, on a copy of the faces and
+         *          without holding the lock meanwhile: searches scan
+         *          exhaustively and writers go on until it is installed.
+         * @return  Void.
+         */
+        void train();
+        /// Copy of the content, without its index.
+        std::shared_ptr<const State> snapshot() const;
+        /**
+         * @brief			    Write the faces of a content to a gallery file.
+         * @param[in] state 	Content, e.g. a snapshot.
+         * @param[in] path 	    File replaced once complete.
+         * @param[in] walSeq    Last log record included in the content.
+         * @param[out] error    Reason of a failure.
+         * @return			    False on i/o error.
+         */
+        static bool save(const State &state, const std::string &path,
+                        uint64_t walSeq, std::string *error);
+
+    private:
+        std::vector<FrMatch> scan(const State &state, const float *normed,
+                                int topK, float minScore) const;
+
+        FrThreadPool *pool_;
+        size_t rowsPerTask_;
+
+        mutable FrRwLock lock_;
+        std::shared_ptr<State> state_;
+        IndexFactory factory_;
+};
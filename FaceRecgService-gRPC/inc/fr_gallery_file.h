@@ -0,0 +1,142 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	On-disk gallery snapshot, mapped read-only at startup.
+ * @details	Layout, all integers little-endian:
+ *          - header, one page, see FileHeader in fr_gallery_file.cc;
+ *          - features: rows x HIAR_FACE_FEATURE_LEN unit floats, page
+ *            aligned, so the matrix is searched straight from the mapping;
+ *          - id offsets: rows + 1 uint64 into the id blob;
+ *          - id blob: the ids back to back;
+ *          - id index: rows (hash, row) uint64 pairs sorted by hash, so an
+ *            id is found by binary search without parsing the table.
+ *          The header and the tables are checksummed and checked at open;
+ *          the features only on request since that reads the whole file.
+ *          A file is written aside and renamed over the old one, so readers
+ *          see either snapshot complete.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "interface_face_recognizer.h"
+
+/**
+ * @brief Read-only mapping of a gallery file.
+ */
+class FrGalleryFile {
+    public:
+        /// Format version written in the header.
+        static const uint32_t kVersion = 1;
+
+        /**
+         * @brief			    Map a gallery file.
+         * @param[in] path 	    File to map.
+         * @param[in] verify    Also check the checksum of the features.
+         * @param[out] error    Reason of a failure.
+         * @return			    Mapping, null on failure.
+         */
+        static std::shared_ptr<const FrGalleryFile> open(
+                                            const std::string &path,
+                                            bool verify, std::string *error);
+        ~FrGalleryFile();
+        FrGalleryFile(const FrGalleryFile&) = delete;
+        FrGalleryFile& operator=(const FrGalleryFile&) = delete;
+
+        /// Number of faces.
+        size_t rows() const { return rows_; }
+        /// HIAR_FACE_FEATURE_LEN unit floats of a row, 64-byte aligned.
+        const float* feature(size_t row) const {
+            return features_ + row * HIAR_FACE_FEATURE_LEN;
+        }
+        /// Id of a row.
+        std::string idOf(size_t row) const;
+        /**
+         * @brief			Row of an id.
+         * @param[in] id 	Identity to look up.
+         * @param[out] row 	Its row if found.
+         * @return			False if the id is not in the file.
+         */
+        bool find(const std::string &id, size_t *row) const;
+        /// Last write-ahead log record included in the file.
+        uint64_t walSeq() const { return walSeq_; }
+
+    private:
+        FrGalleryFile() = default;
+
+        void *map_ = nullptr;
+        size_t mapBytes_ = 0;
+        size_t rows_ = 0;
+        uint64_t walSeq_ = 0;
+        const float *features_ = nullptr;
+        const uint64_t *idOffsets_ = nullptr;
+        const char *idBlob_ = nullptr;
+        /// (hash, row) pairs sorted by hash.
+        const uint64_t *idIndex_ = nullptr;
+};
+
+/**
+ * @brief Writes a gallery file face by face.
+ *        Features are streamed to disk, only the ids are kept in memory.
+ */
+class FrGalleryFileWriter {
+    public:
+        /// No default constructor.
+        FrGalleryFileWriter() = delete;
+        /**
+         * @brief			Constructor, writes to path.tmp until finish().
+         * @param[in] path 	Final path of the file.
+         */
+        explicit FrGalleryFileWriter(const std::string &path);
+        /// Removes the temporary file if not finished.
+        ~FrGalleryFileWriter();
+        FrGalleryFileWriter(const FrGalleryFileWriter&) = delete;
+        FrGalleryFileWriter& operator=(const FrGalleryFileWriter&) = delete;
+
+        /**
+         * @brief			    Append a face.
+         * @param[in] id 	    Identity, unique within the file.
+         * @param[in] feature   HIAR_FACE_FEATURE_LEN unit floats.
+         * @return			    False on i/o error.
+         */
+        bool add(const std::string &id, const float *feature);
+        /**
+         * @brief			    Write the tables and header, sync, then
+         *                      rename over the final path.
+         * @param[in] walSeq    Last log record included.
+         * @param[out] error    Reason of a failure.
+         * @return			    False on i/o error.
+         */
+        bool finish(uint64_t walSeq, std::string *error);
+
+    private:
+        std::string path_;
+        std::string tmpPath_;
+        FILE *file_ = nullptr;
+        bool failed_ = false;
+        uint64_t featuresChecksum_ = 0;
+        std::vector<uint64_t> idOffsets_;
+        std::string idBlob_;
+};
@@ -0,0 +1,123 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Persistence of a gallery: file, write-ahead log and compaction.
+ * @details	At open the gallery file is mapped and the log replayed on top of
+ *          it, so faces are served right away, exhaustively until the index
+ *          of the file is built in the background.
+ *          Changes are appended to the log before being applied. Once the
+ *          log grows past compactBytes, a background thread rotates it,
+ *          writes a snapshot of the gallery to a new file, maps and indexes
+ *          it, then swaps it in with the changes made in the meantime.
+ *          A crash at any point is recovered from the file and both logs:
+ *          records already in the file are skipped by sequence number.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "fr_gallery.h"
+#include "fr_gallery_wal.h"
+
+/**
+ * @brief Options of FrGalleryStore.
+ */
+struct FrGalleryStoreOptions {
+    /// fdatasync the log at each change.
+    bool syncWal = false;
+    /// Log size starting a compaction.
+    size_t compactBytes = 64 << 20;
+    /// Check the checksum of the features when mapping the file.
+    bool verify = false;
+};
+
+/**
+ * @brief Keeps a gallery on disk, all changes go through it.
+ */
+class FrGalleryStore {
+    public:
+        /// No default constructor.
+        FrGalleryStore() = delete;
+        /**
+         * @brief			    Constructor.
+         * @param[in] gallery 	Gallery loaded and persisted, outlives the store.
+         * @param[in] path 	    Gallery file, the log is path.wal.
+         * @param[in] options   Options.
+         */
+        FrGalleryStore(FrGallery *gallery, const std::string &path,
+                        const FrGalleryStoreOptions &options);
+        /// Waits for a running compaction.
+        ~FrGalleryStore();
+        FrGalleryStore(const FrGalleryStore&) = delete;
+        FrGalleryStore& operator=(const FrGalleryStore&) = delete;
+
+        /**
+         * @brief			    Load the file and the log into the gallery,
+         *                      then index it in the background.
+         * @param[out] error    Reason of a failure.
+         * @return			    False if the file or the log is unusable.
+         */
+        bool open(std::string *error);
+        /**
+         * @brief			    Log then apply an enrollment.
+         * @param[in] id 	    Identity of the face.
+         * @param[in] feature   HIAR_FACE_FEATURE_LEN floats.
+         * @return			    False if the feature is all zeros.
+         */
+        bool enroll(const std::string &id, const float *feature);
+        /**
+         * @brief			Log then apply a removal.
+         * @param[in] id 	Identity of the face.
+         * @return			False if the id was not enrolled.
+         */
+        bool remove(const std::string &id);
+
+    private:
+        /// Background thread: indexing of file, then trainings and
+        /// compactions when asked.
+        void run(std::shared_ptr<const FrGalleryFile> file);
+        /// Replace the content by file with its index, plus the log after it.
+        void reload(std::shared_ptr<const FrGalleryFile> file);
+        /// Snapshot the gallery to a new file and reload from it.
+        bool compact(std::string *error);
+
+        FrGallery *gallery_;
+        const std::string path_;
+        const FrGalleryStoreOptions options_;
+        FrGalleryWal wal_;
+
+        /// Orders the changes, held while logging and applying one.
+        std::mutex writeMutex_;
+        uint64_t lastSeq_ = 0;
+
+        std::mutex workMutex_;
+        std::condition_variable workCv_;
+        bool compactWanted_ = false;
+        /// The gallery changed, its index may be due for training.
+        bool trainWanted_ = false;
+        bool stopping_ = false;
+        std::thread worker_;
+};
@@ -0,0 +1,108 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Append-only write-ahead log of gallery changes.
+ * @details	Each record is a small header (magic, payload size, payload
+ *          checksum) followed by the payload: sequence number, operation,
+ *          id and, for enrollments, the unit feature. Reading stops at the
+ *          first torn or corrupted record, so a crash in the middle of an
+ *          append loses that record only.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One change of the gallery.
+ */
+struct FrGalleryOp {
+    uint64_t seq = 0;
+    bool remove = false;
+    std::string id;
+    /// HIAR_FACE_FEATURE_LEN floats of an enrollment, empty for a removal.
+    std::vector<float> feature;
+};
+
+/**
+ * @brief Log file receiving the changes of the gallery in order.
+ */
+class FrGalleryWal {
+    public:
+        /// No default constructor.
+        FrGalleryWal() = delete;
+        /**
+         * @brief			Constructor.
+         * @param[in] path 	Log file, rotated to path.1 by rotate().
+         * @param[in] sync 	fdatasync each record, else records survive a
+         *                  crash of the process but not of the host.
+         */
+        FrGalleryWal(const std::string &path, bool sync);
+        ~FrGalleryWal();
+        FrGalleryWal(const FrGalleryWal&) = delete;
+        FrGalleryWal& operator=(const FrGalleryWal&) = delete;
+
+        /**
+         * @brief			    Open for appending, dropping a torn tail.
+         * @param[out] error    Reason of a failure.
+         * @return			    False on i/o error.
+         */
+        bool open(std::string *error);
+        /**
+         * @brief			Append a record.
+         * @param[in] op 	Change to log.
+         * @return			False on i/o error.
+         */
+        bool append(const FrGalleryOp &op);
+        /**
+         * @brief			Move the records aside to path.1, appending to
+         *                  it if a previous rotation was not dropped, and
+         *                  start an empty log.
+         * @return			False on i/o error.
+         */
+        bool rotate();
+        /// Delete path.1 once its records are in the gallery file.
+        void dropRotated();
+        /// Bytes of the current log.
+        size_t bytes() const { return bytes_; }
+
+        /**
+         * @brief			    Read the valid records of path.1 then path.
+         * @param[in] afterSeq  Records up to this sequence are skipped.
+         * @param[out] ops      Records, oldest first.
+         * @return			    Void.
+         */
+        void readAll(uint64_t afterSeq, std::vector<FrGalleryOp> *ops) const;
+
+    private:
+        /**
+         * @brief			    Read the valid records of one file.
+         * @return			    Bytes of the valid records.
+         */
+        static size_t readFile(const std::string &path, uint64_t afterSeq,
+                                std::vector<FrGalleryOp> *ops);
+
+        std::string path_;
+        bool sync_;
+        int fd_ = -1;
+        size_t bytes_ = 0;
+};
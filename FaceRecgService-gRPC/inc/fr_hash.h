@@ -0,0 +1,109 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Fast non-cryptographic 64-bit hash, for checksums and tables.
+ * @details	Consumes 8 bytes per step with a multiply-xorshift mix, which
+ *          runs near memory bandwidth on large buffers.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// Final avalanche of a 64-bit state.
+inline uint64_t frMix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @brief			Hash of a byte buffer.
+ * @param[in] data 	Bytes to hash.
+ * @param[in] len 	Number of bytes.
+ * @param[in] seed 	Start value, chains calls over several buffers.
+ * @return			64-bit hash.
+ */
+inline uint64_t frHash64(const void *data, size_t len, uint64_t seed = 0) {
+    const uint64_t kMul = 0x9ddfea08eb382d69ULL;
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    uint64_t h = seed ^ (len * kMul);
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        h = (h ^ (word * kMul)) * kMul;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, len - i);
+    h = (h ^ (tail * kMul)) * kMul;
+    return frMix64(h);
+}
+
+/**
+ * @brief 128-bit hash of content, low odds of collision over a server's
+ *        lifetime.
+ */
+struct FrContentHash {
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+
+    bool operator==(const FrContentHash &other) const {
+        return lo == other.lo && hi == other.hi;
+    }
+};
+
+/**
+ * @brief			Hash of a large byte buffer, e.g. a whole image.
+ *                  Four independent lanes keep the multipliers busy, about
+ *                  twice the throughput of frHash64.
+ * @param[in] data 	Bytes to hash.
+ * @param[in] len 	Number of bytes.
+ * @param[in] seed 	Start value, chains calls over several buffers.
+ * @return			128-bit hash.
+ */
+inline FrContentHash frHash128(const void *data, size_t len,
+                                const FrContentHash &seed = FrContentHash()) {
+    const uint64_t kMul = 0x9ddfea08eb382d69ULL;
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    uint64_t lane[4] = {seed.lo ^ (len * kMul),
+                        seed.hi ^ 0x9e3779b97f4a7c15ULL,
+                        seed.lo + 0x632be59bd9b4e019ULL,
+                        seed.hi - 0x85ebca77c2b2ae63ULL};
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        for (int l = 0; l < 4; l++) {
+            uint64_t word;
+            memcpy(&word, bytes + i + 8 * l, 8);
+            lane[l] = (lane[l] ^ (word * kMul)) * kMul;
+            lane[l] ^= lane[l] >> 29;
+        }
+    }
+    FrContentHash hash;
+    uint64_t tail = frHash64(bytes + i, len - i, lane[0] ^ lane[2]);
+    hash.lo = frMix64(lane[0] + frMix64(lane[1] ^ tail));
+    hash.hi = frMix64(lane[2] + frMix64(lane[3] ^ tail) + hash.lo);
+    return hash;
+}
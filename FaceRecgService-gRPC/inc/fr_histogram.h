@@ -0,0 +1,218 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Lock-free log-linear histogram.
+ * @details	Values are counted in buckets of 2^kSubBits linear steps per power
+ *          of two, like an HDR histogram with ~12% relative precision, so any
+ *          uint64 value fits in a fixed array and recording is one atomic add.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * @brief Log-linear histogram of uint64 values, safe to record concurrently.
+ */
+class FrHistogram {
+    public:
+        /// Linear steps of each power of two, as a number of bits.
+        static const int kSubBits = 3;
+        static const int kSubCount = 1 << kSubBits;
+        static const int kBuckets = (64 - kSubBits + 1) * kSubCount;
+
+        FrHistogram() {
+            reset();
+        }
+        FrHistogram(const FrHistogram&) = delete;
+        FrHistogram& operator=(const FrHistogram&) = delete;
+
+        /**
+         * @brief			Count one value.
+         * @param[in] value Value to count.
+         * @return			Void.
+         */
+        void record(uint64_t value) {
+            buckets_[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+            count_.fetch_add(1, std::memory_order_relaxed);
+            sum_.fetch_add(value, std::memory_order_relaxed);
+            uint64_t prev = max_.load(std::memory_order_relaxed);
+            while (prev < value && !max_.compare_exchange_weak(prev, value,
+                                                std::memory_order_relaxed)) {
+            }
+        }
+        /**
+         * @brief			Add all values counted by another histogram.
+         * @param[in] other Histogram to merge from.
+         * @return			Void.
+         */
+        void merge(const FrHistogram &other) {
+            for (int i = 0; i < kBuckets; i++) {
+                uint64_t n = other.buckets_[i].load(std::memory_order_relaxed);
+                if (0 != n) {
+                    buckets_[i].fetch_add(n, std::memory_order_relaxed);
+                }
+            }
+            count_.fetch_add(other.count(), std::memory_order_relaxed);
+            sum_.fetch_add(other.sum(), std::memory_order_relaxed);
+            uint64_t value = other.max();
+            uint64_t prev = max_.load(std::memory_order_relaxed);
+            while (prev < value && !max_.compare_exchange_weak(prev, value,
+                                                std::memory_order_relaxed)) {
+            }
+        }
+        /// Forget every value.
+        void reset() {
+            for (int i = 0; i < kBuckets; i++) {
+                buckets_[i].store(0, std::memory_order_relaxed);
+            }
+            count_.store(0, std::memory_order_relaxed);
+            sum_.store(0, std::memory_order_relaxed);
+            max_.store(0, std::memory_order_relaxed);
+        }
+
+        uint64_t count() const {
+            return count_.load(std::memory_order_relaxed);
+        }
+        uint64_t sum() const {
+            return sum_.load(std::memory_order_relaxed);
+        }
+        uint64_t max() const {
+            return max_.load(std::memory_order_relaxed);
+        }
+        double mean() const {
+            uint64_t n = count();
+            return 0 == n ? 0.0 : static_cast<double>(sum()) / n;
+        }
+        /// Counter of the idx-th bucket.
+        uint64_t bucketCount(int idx) const {
+            return buckets_[idx].load(std::memory_order_relaxed);
+        }
+        /**
+         * @brief			    Value at a quantile.
+         * @param[in] quantile 	In [0, 1], e.g. 0.99 for p99.
+         * @return			    Upper bound of the bucket reaching the
+         *                      quantile, never above the recorded max.
+         */
+        uint64_t percentile(double quantile) const {
+            uint64_t n = count();
+            if (0 == n) {
+                return 0;
+            }
+            uint64_t rank = static_cast<uint64_t>(quantile * n + 0.5);
+            rank = 0 < rank ? rank : 1;
+            uint64_t seen = 0;
+            for (int i = 0; i < kBuckets; i++) {
+                seen += bucketCount(i);
+                if (seen >= rank) {
+                    uint64_t upper = bucketUpper(i);
+                    return upper < max() ? upper : max();
+                }
+            }
+            return max();
+        }
+        /**
+         * @brief			    Print count, mean and usual percentiles.
+         * @param[in] os 	    Output stream.
+         * @param[in] name      Label of the line.
+         * @param[in] unit      Unit of the values, e.g. "us".
+         * @return			    Void.
+         */
+        void dump(std::ostream &os, const std::string &name,
+                    const std::string &unit) const {
+            os << name << ": count " << count()
+                << " mean " << mean() << unit
+                << " p50 " << percentile(0.5) << unit
+                << " p90 " << percentile(0.9) << unit
+                << " p99 " << percentile(0.99) << unit
+                << " max " << max() << unit << std::endl;
+        }
+
+        /**
+         * @brief			Write as a Prometheus histogram in seconds,
+         *                  values being microseconds. A bound splitting a
+         *                  bucket counts it in the next one.
+         * @param[in] os 	Output stream.
+         * @param[in] name  Name of the metric, with no suffix.
+         * @param[in] labels Labels of the series, e.g. rpc="identify".
+         * @return			Void.
+         */
+        void prometheus(std::ostream &os, const char *name,
+                        const std::string &labels) const {
+            static const double kBoundsSec[] = {
+                0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+                0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+            };
+            uint64_t cumulative = 0;
+            int idx = 0;
+            for (double bound : kBoundsSec) {
+                uint64_t boundUs = static_cast<uint64_t>(bound * 1e6);
+                for (; idx < kBuckets && bucketUpper(idx) <= boundUs; idx++) {
+                    cumulative += bucketCount(idx);
+                }
+                os << name << "_bucket{" << labels << ",le=\"" << bound
+                    << "\"} " << cumulative << '\n';
+            }
+            for (; idx < kBuckets; idx++) {
+                cumulative += bucketCount(idx);
+            }
+            // +Inf and _count must agree, recorders may run meanwhile.
+            os << name << "_bucket{" << labels << ",le=\"+Inf\"} "
+                << cumulative << '\n'
+                << name << "_sum{" << labels << "} " << sum() * 1e-6 << '\n'
+                << name << "_count{" << labels << "} " << cumulative << '\n';
+        }
+
+        /// Index of the bucket counting value.
+        static int bucketOf(uint64_t value) {
+            if (value < static_cast<uint64_t>(kSubCount)) {
+                return static_cast<int>(value);
+            }
+            int msb = 63 - __builtin_clzll(value);
+            int shift = msb - kSubBits;
+            return ((shift + 1) << kSubBits)
+                    | static_cast<int>((value >> shift) & (kSubCount - 1));
+        }
+        /// Smallest value counted by the idx-th bucket.
+        static uint64_t bucketLower(int idx) {
+            if (idx < kSubCount) {
+                return static_cast<uint64_t>(idx);
+            }
+            int shift = (idx >> kSubBits) - 1;
+            uint64_t mantissa = kSubCount | (idx & (kSubCount - 1));
+            return mantissa << shift;
+        }
+        /// Largest value counted by the idx-th bucket.
+        static uint64_t bucketUpper(int idx) {
+            if (idx < kSubCount) {
+                return static_cast<uint64_t>(idx);
+            }
+            int shift = (idx >> kSubBits) - 1;
+            return bucketLower(idx) + ((static_cast<uint64_t>(1) << shift) - 1);
+        }
+
+    private:
+        std::atomic<uint64_t> buckets_[kBuckets];
+        std::atomic<uint64_t> count_;
+        std::atomic<uint64_t> sum_;
+        std::atomic<uint64_t> max_;
+};
@@ -0,0 +1,150 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Image of one request, decoded once for all the SDK calls on it.
+ * @details	The SDK only accepts encoded image files and decodes them again
+ *          at every call, so a request running detection or extraction then
+ *          quality scoring decodes its JPEG twice. A context decodes the
+ *          JPEG once and hands the SDK an uncompressed BMP of the pixels,
+ *          whose decoding is a plain copy. Images used by a single call are
+ *          passed through untouched, transcoding would only add work.
+ *          Raw pixels sent by a device are wrapped as they are, with no
+ *          decoding at all, and handed to the SDK as a BMP as well.
+ *          The wrappers mirror interface_face_recognizer.h with the image
+ *          arguments replaced by a context.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <chrono>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "interface_face_recognizer.h"
+#include "fr_hash.h"
+
+/// Layouts of raw pixels, same values as RawImage.PixelFormat.
+enum FrPixelFormat {
+    kFrPixelBgr = 0,
+    kFrPixelRgb = 1,
+    kFrPixelGray = 2,
+    kFrPixelNv12 = 3
+};
+
+/**
+ * @brief			    BGR pixels out of raw ones.
+ * @param[in] data 	    First row, must outlive the result.
+ * @param[in] len 	    Bytes of data.
+ * @param[in] width 	Width in pixels, even for NV12.
+ * @param[in] height 	Height in pixels, even for NV12.
+ * @param[in] stride 	Bytes between rows, 0 for packed rows.
+ * @param[in] format 	Layout of the pixels; NV12 is the Y plane followed
+ *                      by the interleaved UV plane, both with stride.
+ * @param[out] bgr 	    Wraps data for BGR, a converted copy otherwise.
+ * @return			    False if the geometry does not fit in data, or
+ *                      for NV12 if len is not exactly its size.
+ */
+bool frWrapPixels(const unsigned char *data, size_t len, int width,
+                    int height, int stride, FrPixelFormat format,
+                    cv::Mat *bgr);
+
+/**
+ * @brief Encoded bytes of an image and, on demand, its pixels.
+ */
+class FrImageContext {
+    public:
+        /// No default constructor.
+        FrImageContext() = delete;
+        /**
+         * @brief			    Constructor, the bytes must outlive it.
+         * @param[in] data 	    Encoded image file.
+         * @param[in] len 	    Bytes of data.
+         * @param[in] sdkCalls  SDK calls planned on the image, transcoded
+         *                      for the SDK only if more than one.
+         * @param[in] decodeOnce False never transcodes, e.g. for an SDK
+         *                      build without BMP support.
+         */
+        FrImageContext(const unsigned char *data, int len, int sdkCalls,
+                        bool decodeOnce = false);
+        /**
+         * @brief			    Constructor from pixels, never decoded.
+         * @param[in] bgr 	    BGR pixels, e.g. from frWrapPixels.
+         * @param[in] wrapMs 	Time taken to get them, counted as decoding.
+         */
+        FrImageContext(const cv::Mat &bgr, double wrapMs);
+        /// Keeps the transcoding buffer for the next image of the thread.
+        ~FrImageContext();
+        FrImageContext(const FrImageContext&) = delete;
+        FrImageContext& operator=(const FrImageContext&) = delete;
+
+        /// BGR pixels, decoded at first use, empty if undecodable.
+        const cv::Mat& pixels();
+        /// Image file given to the SDK.
+        const unsigned char* sdkData();
+        /// Bytes of sdkData().
+        int sdkLen();
+        /// Milliseconds spent decoding, converting and transcoding so far.
+        double decodeMs() const { return decodeMs_; }
+        /// True once the pixels are here, decoded or given raw. Until
+        /// then the SDK decodes the file itself, inside its calls.
+        bool decoded() const { return decoded_; }
+        /// Hash of the bytes or of the raw pixels, computed at first use.
+        const FrContentHash& contentHash();
+        /// Deadline of the request, bounds the wait for a recognizer
+        /// worker; none by default.
+        void setDeadline(std::chrono::system_clock::time_point deadline) {
+            deadline_ = deadline;
+        }
+        std::chrono::system_clock::time_point deadline() const {
+            return deadline_;
+        }
+
+    private:
+        void transcode();
+
+        const unsigned char *data_;
+        const int len_;
+        const bool transcode_;
+        bool decoded_ = false;
+        bool transcoded_ = false;
+        cv::Mat pixels_;
+        /// Uncompressed BMP of pixels_.
+        std::vector<uchar> sdkImage_;
+        double decodeMs_ = 0;
+        bool hashed_ = false;
+        FrContentHash hash_;
+        std::chrono::system_clock::time_point deadline_
+                            = std::chrono::system_clock::time_point::max();
+};
+
+/// HiarFace_extractFeature on a context.
+int FrFace_extractFeature(FrImageContext &image, const int *face_bboxes,
+                        const int num_bbox, float **feature,
+                        int *len_features);
+
+/// HiarFace_detectAndExtractFeature on a context.
+int FrFace_detectAndExtractFeature(FrImageContext &image, int **face_bboxes,
+                                int *num_bbox, float **feature,
+                                int *len_features);
+
+/// HiarFace_getQualityFaceCrops on a context.
+int FrFace_getQualityFaceCrops(FrImageContext &image, const int *face_bboxes,
+                                const int num_bbox, int *face_quality,
+                                float *face_direction);
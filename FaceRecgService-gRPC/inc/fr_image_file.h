@@ -0,0 +1,35 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Loading of image files into the bytes fields of requests.
+ * @details	The file is mapped and copied once, straight from the page cache
+ *          into the string of the field, with no intermediate heap buffer.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <string>
+
+/**
+ * @brief			    Load a whole file.
+ * @param[in] path 	    File to load.
+ * @param[out] bytes    Content of the file, e.g. request.mutable_imagedata().
+ * @return			    False if the file is missing, empty or unreadable.
+ */
+bool frLoadImage(const std::string &path, std::string *bytes);
@@ -0,0 +1,78 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Load generator of the client, for capacity planning.
+ * @details	Closed loop: "concurrency" workers each send their next request
+ *          as soon as the previous one is answered, which measures the
+ *          peak throughput. Open loop: requests are scheduled at a fixed
+ *          rate whatever the server does and the latency of a request
+ *          counts from its scheduled time, so a stalled server shows up as
+ *          latency instead of silently slowing the senders down; there
+ *          "concurrency" is the max number of requests in flight.
+ *          The report is one JSON object on one line, to be kept and
+ *          diffed between server versions.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <ostream>
+#include <string>
+
+/**
+ * @brief Options of a load run, given to the client as --key=value.
+ */
+struct FrLoadOptions {
+    /// Server address.
+    std::string target = "localhost:50051";
+    /// "closed" or "open".
+    std::string mode = "closed";
+    /// Workers of closed loop, max requests in flight of open loop.
+    int concurrency = 8;
+    /// Requests per second of open loop.
+    double qps = 50;
+    /// Seconds of the run, warm-up excluded.
+    double duration = 30;
+    /// Channels the requests are spread over, one connection each.
+    int channels = 1;
+    /// Directory of the images sent, every regular file in it is used.
+    std::string images = "./images";
+    /**
+     * Weights of the rpcs, e.g. "featureDetect:8,featureExtract:1".
+     * Known rpcs: logIn, featureDetect, featureExtract, getFaceQuality,
+     * compareImage and identify. The ones needing faces use the faces
+     * detected in each image during the warm-up.
+     */
+    std::string mix = "featureDetect:1";
+    /// Deadline of each request in ms, 0 for none. Requests shed by the
+    /// server or past their deadline are reported apart from errors.
+    double deadlineMs = 0;
+    /// Sent as "fr-tenant" and "fr-priority" metadata when not empty,
+    /// see the scheduler of the server.
+    std::string tenant;
+    std::string priority;
+};
+
+/**
+ * @brief			    Run a load and write its report.
+ * @param[in] options   Options of the run.
+ * @param[out] report   Output of the JSON report.
+ * @return			    False if the run could not start, the reason being
+ *                      printed to std::cout.
+ */
+bool frRunLoad(const FrLoadOptions &options, std::ostream &report);
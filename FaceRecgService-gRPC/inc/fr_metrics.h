@@ -0,0 +1,197 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Counters and latency histograms of the server, in Prometheus
+ *          text format.
+ * @details	Every thread records into one of kShards shards, chosen once
+ *          per thread, so recording is a few relaxed atomic adds on cache
+ *          lines mostly owned by that thread. Shards are only summed when
+ *          the metrics are exported. Metrics are cumulative since startup
+ *          and latencies are exported as histograms, so that rates and
+ *          percentiles over a window are left to Prometheus, e.g.
+ *          histogram_quantile(0.99, rate(fr_rpc_latency_seconds_bucket[1m])).
+ *          The HTTP endpoint only listens on the loopback by default.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fr_histogram.h"
+#include "fr_stage_timer.h"
+
+/**
+ * @brief Metrics of one server.
+ */
+class FrMetrics {
+    public:
+        /// Rpcs measured, featureStream is measured per frame.
+        enum Rpc {
+            kLogIn,
+            kFeatureExtract,
+            kFeatureDetect,
+            kFeatureStream,
+            kCompareFeature,
+            kCompareImage,
+            kGetFaceQuality,
+            kEnroll,
+            kRemove,
+            kIdentify,
+            kGetStats,
+            kCompareBatch,
+            kRpcCount
+        };
+        /// Stages of FrStageTimer measured, others are ignored.
+        enum Stage {
+            kDecode,
+            kDetectExtract,
+            kExtract,
+            kQuality,
+            /// Wait of a request served by an identical one in flight.
+            kCoalesced,
+            kStageCount
+        };
+        static const int kShards = 16;
+
+        FrMetrics();
+        FrMetrics(const FrMetrics&) = delete;
+        FrMetrics& operator=(const FrMetrics&) = delete;
+
+        /// Name of an rpc in the service.
+        static const char* rpcName(Rpc rpc);
+        /// Name of a stage in FrStageTimer.
+        static const char* stageName(Stage stage);
+
+        /// Count an rpc as in flight.
+        void started(Rpc rpc);
+        /**
+         * @brief			Count an rpc as done.
+         * @param[in] rpc 	Rpc started before.
+         * @param[in] us 	Latency in microseconds.
+         * @return			Void.
+         */
+        void finished(Rpc rpc, uint64_t us);
+        /**
+         * @brief			    Count the faces of a request.
+         * @param[in] rpc 	    Rpc serving the request.
+         * @param[in] faces 	Faces returned.
+         * @param[in] skipped   Faces rejected by the quality gate.
+         * @return			    Void.
+         */
+        void faces(Rpc rpc, int faces, int skipped);
+        /// Record the stages of a request.
+        void stages(const FrStageTimer &timer);
+        /**
+         * @brief			    Add metrics kept elsewhere to the
+         *                      exposition, before serving starts.
+         * @param[in] collector Writes Prometheus text to a stream.
+         * @return			    Void.
+         */
+        void addCollector(std::function<void(std::ostream&)> collector) {
+            collectors_.push_back(std::move(collector));
+        }
+        /**
+         * @brief			Write every metric in Prometheus text format.
+         * @param[in] os 	Output stream.
+         * @return			Void.
+         */
+        void exposition(std::ostream &os) const;
+
+    private:
+        /// Kilobytes large, so shards share at most a line at their edges.
+        struct Shard {
+            FrHistogram latencyUs[kRpcCount];
+            FrHistogram stageUs[kStageCount];
+            std::atomic<int64_t> inFlight[kRpcCount];
+            std::atomic<uint64_t> faces[kRpcCount];
+            std::atomic<uint64_t> skipped[kRpcCount];
+        };
+        /// Shard of the calling thread.
+        Shard& shard();
+
+        std::unique_ptr<Shard[]> shards_;
+        std::vector<std::function<void(std::ostream&)>> collectors_;
+        const std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * @brief Measures an rpc from its construction to its destruction.
+ */
+class FrRpcScope {
+    public:
+        FrRpcScope(FrMetrics *metrics, FrMetrics::Rpc rpc)
+                : metrics_(metrics), rpc_(rpc),
+                begin_(std::chrono::steady_clock::now()) {
+            metrics_->started(rpc_);
+        }
+        ~FrRpcScope() {
+            metrics_->finished(rpc_,
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - begin_).count());
+        }
+        FrRpcScope(const FrRpcScope&) = delete;
+        FrRpcScope& operator=(const FrRpcScope&) = delete;
+
+    private:
+        FrMetrics *metrics_;
+        const FrMetrics::Rpc rpc_;
+        const std::chrono::steady_clock::time_point begin_;
+};
+
+/**
+ * @brief Minimal HTTP endpoint answering every request with the metrics,
+ *        for Prometheus to scrape.
+ */
+class FrMetricsHttp {
+    public:
+        /// No default constructor.
+        FrMetricsHttp() = delete;
+        /**
+         * @brief			Constructor.
+         * @param[in] metrics Metrics exported, outlive the endpoint.
+         * @param[in] port 	TCP port.
+         * @param[in] host 	IPv4 address listened on, "0.0.0.0" for every
+         *                  interface.
+         */
+        FrMetricsHttp(const FrMetrics *metrics, int port,
+                        const std::string &host = "127.0.0.1");
+        /// Stops listening.
+        ~FrMetricsHttp();
+        FrMetricsHttp(const FrMetricsHttp&) = delete;
+        FrMetricsHttp& operator=(const FrMetricsHttp&) = delete;
+
+        /// False if the port could not be listened on.
+        bool listening() const { return 0 <= fd_; }
+
+    private:
+        void run();
+
+        const FrMetrics *metrics_;
+        int fd_ = -1;
+        std::atomic<bool> stopping_;
+        std::thread thread_;
+};
@@ -0,0 +1,72 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Readers-writer lock on top of pthread_rwlock_t.
+ * @details	C++11 has no shared mutex, the server only runs on posix systems.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <pthread.h>
+
+/**
+ * @brief Readers-writer lock, many readers or one writer.
+ */
+class FrRwLock {
+    public:
+        FrRwLock() { pthread_rwlock_init(&lock_, nullptr); }
+        ~FrRwLock() { pthread_rwlock_destroy(&lock_); }
+        FrRwLock(const FrRwLock&) = delete;
+        FrRwLock& operator=(const FrRwLock&) = delete;
+
+        void lockShared() { pthread_rwlock_rdlock(&lock_); }
+        void lockExclusive() { pthread_rwlock_wrlock(&lock_); }
+        void unlock() { pthread_rwlock_unlock(&lock_); }
+
+    private:
+        pthread_rwlock_t lock_;
+};
+
+/**
+ * @brief Holds a FrRwLock for reading in the current scope.
+ */
+class FrReadGuard {
+    public:
+        explicit FrReadGuard(FrRwLock &lock) : lock_(lock) { lock_.lockShared(); }
+        ~FrReadGuard() { lock_.unlock(); }
+        FrReadGuard(const FrReadGuard&) = delete;
+        FrReadGuard& operator=(const FrReadGuard&) = delete;
+
+    private:
+        FrRwLock &lock_;
+};
+
+/**
+ * @brief Holds a FrRwLock for writing in the current scope.
+ */
+class FrWriteGuard {
+    public:
+        explicit FrWriteGuard(FrRwLock &lock) : lock_(lock) { lock_.lockExclusive(); }
+        ~FrWriteGuard() { lock_.unlock(); }
+        FrWriteGuard(const FrWriteGuard&) = delete;
+        FrWriteGuard& operator=(const FrWriteGuard&) = delete;
+
+    private:
+        FrRwLock &lock_;
+};
@@ -0,0 +1,182 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Priority and fair scheduling of the recognizer calls.
+ * @details	At most slots recognizer calls run at once, one per core by
+ *          default, so that an expensive detection does not slow down the
+ *          calls running beside it. A call waiting for a slot belongs to a
+ *          priority class and a tenant. A freed slot goes to the highest
+ *          class with waiters: interactive, then normal, then bulk. Within
+ *          a class, tenants share the slots in proportion to their weights
+ *          by start-time fair queuing: a call is tagged with
+ *          start = max(virtual time, finish of the previous call of its
+ *          tenant) and finish = start + cost / weight, the smallest start
+ *          runs first and sets the virtual time. A tenant sending a burst
+ *          thus waits behind its own calls, not the others.
+ *          Bulk calls only run when no interactive nor normal call waits.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "fr_histogram.h"
+
+/// Priority classes, the first ones served first.
+enum FrPriority {
+    kFrInteractive,
+    kFrNormal,
+    kFrBulk,
+    kFrPriorityCount
+};
+
+/// Name of a class: "interactive", "normal" or "bulk".
+const char* frPriorityName(FrPriority priority);
+/**
+ * @brief			    Class of a name.
+ * @param[in] name 	    Name given by frPriorityName.
+ * @param[out] priority Class.
+ * @return			    False if the name is unknown.
+ */
+bool frParsePriority(const std::string &name, FrPriority *priority);
+
+/**
+ * @brief Who a recognizer call works for.
+ */
+struct FrSchedClass {
+    FrPriority priority = kFrNormal;
+    std::string tenant;
+};
+
+/**
+ * @brief Slots of the recognizer calls, handed out by class and tenant.
+ */
+class FrScheduler {
+    public:
+        /// No default constructor.
+        FrScheduler() = delete;
+        /**
+         * @brief			    Constructor.
+         * @param[in] slots     Calls run at once, 0 means one per core.
+         * @param[in] weights   Weight of each tenant, 1 for the others.
+         */
+        FrScheduler(int slots, const std::map<std::string, double> &weights);
+        FrScheduler(const FrScheduler&) = delete;
+        FrScheduler& operator=(const FrScheduler&) = delete;
+
+        /**
+         * @brief			Parse weights such as "kiosk:4,ingest:0.5".
+         * @param[in] text 	Tenants and weights, comma separated.
+         * @param[out] weights Weights, all positive.
+         * @return			False if the text is malformed.
+         */
+        static bool parseWeights(const std::string &text,
+                                std::map<std::string, double> *weights);
+
+        /**
+         * @brief			Wait for a slot.
+         * @param[in] work  Class and tenant of the call.
+         * @param[in] cost  Work of the call, e.g. its faces.
+         * @return			Void, release() must follow.
+         */
+        void acquire(const FrSchedClass &work, double cost);
+        /// Give a slot back, to the next call waiting.
+        void release();
+
+        /// Calls run at once.
+        int slots() const { return slots_; }
+        /// Print calls and queue times of each class.
+        void dump(std::ostream &os) const;
+        /// Same in Prometheus text format.
+        void exposition(std::ostream &os) const;
+
+    private:
+        /// Call waiting for a slot.
+        struct Waiter {
+            std::condition_variable ready;
+            bool granted = false;
+            double start = 0;
+            /// Arrival order, breaks ties of start.
+            uint64_t seq = 0;
+        };
+        struct Class {
+            std::vector<Waiter*> waiters;
+            double virtualTime = 0;
+            /// Finish tag of the last call of each tenant.
+            std::unordered_map<std::string, double> lastFinish;
+            uint64_t calls = 0;
+            /// Time calls waited for a slot, in us.
+            FrHistogram waitUs;
+        };
+
+        /// Tag a call of a class, return its start.
+        double tag(Class &cls, const FrSchedClass &work, double cost);
+
+        const int slots_;
+        const std::map<std::string, double> weights_;
+        mutable std::mutex mutex_;
+        int running_ = 0;
+        int waiting_ = 0;
+        uint64_t nextSeq_ = 0;
+        Class classes_[kFrPriorityCount];
+};
+
+/**
+ * @brief Slot of the scheduler held by a scope.
+ * @code
+ * {
+ *     FrSchedScope slot(scheduler, work, num_bbox);
+ *     HiarFace_extractFeature(...);
+ * }
+ * @endcode
+ */
+class FrSchedScope {
+    public:
+        /**
+         * @brief			    Wait for a slot.
+         * @param[in] scheduler Scheduler, null to run at once.
+         * @param[in] work      Class and tenant of the call.
+         * @param[in] cost      Work of the call.
+         */
+        FrSchedScope(FrScheduler *scheduler, const FrSchedClass &work,
+                    double cost)
+                : scheduler_(scheduler) {
+            if (nullptr != scheduler_) {
+                scheduler_->acquire(work, cost);
+            }
+        }
+        ~FrSchedScope() {
+            if (nullptr != scheduler_) {
+                scheduler_->release();
+            }
+        }
+        FrSchedScope(const FrSchedScope&) = delete;
+        FrSchedScope& operator=(const FrSchedScope&) = delete;
+
+    private:
+        FrScheduler *scheduler_;
+};
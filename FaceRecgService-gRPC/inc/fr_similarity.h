@@ -0,0 +1,73 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Scores of many probes against many candidates.
+ * @details	Features are packed one after the other, len floats each, as
+ *          they come in a repeated float field. The dot products run on
+ *          the widest kernel the CPU supports, picked once at startup:
+ *          AVX-512, AVX2 with FMA, SSE or portable C++.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Score of two features.
+enum FrSimilarity {
+    /// Cosine similarity, as identify, in [-1, 1].
+    kFrCosine = 0,
+    /// Dot product, cosine for features already normalized.
+    kFrDot = 1
+};
+
+/// Kernel in use: "avx512", "avx2", "sse" or "scalar".
+const char* frSimilarityKernel();
+/// Kernels runnable on this CPU, widest first.
+std::vector<std::string> frSimilarityKernels();
+/**
+ * @brief			Use another kernel, for benchmarks.
+ * @param[in] name 	One of frSimilarityKernels().
+ * @return			False if the CPU cannot run it, nothing changed.
+ */
+bool frSelectSimilarityKernel(const std::string &name);
+
+/**
+ * @brief			        Score every probe against every candidate.
+ * @param[in] probes 	    m packed features.
+ * @param[in] candidates    n packed features.
+ * @param[in] len 	        Floats of a feature.
+ * @param[out] scores 	    m x n scores, row major: scores[i * n + j] is
+ *                          probe i against candidate j. A zero feature
+ *                          has a cosine of 0 with everything.
+ * @return			        Void.
+ */
+void frScoreMatrix(const float *probes, int m, const float *candidates,
+                    int n, int len, FrSimilarity similarity, float *scores);
+
+/**
+ * @brief			    Best candidates of one row of scores.
+ * @param[in] scores 	n scores of one probe.
+ * @param[in] topK 	    Max candidates kept.
+ * @param[out] best 	Candidate and score, best first.
+ * @return			    Void.
+ */
+void frTopK(const float *scores, int n, int topK,
+            std::vector<std::pair<int, float>> *best);
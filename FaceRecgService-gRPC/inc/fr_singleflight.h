@@ -0,0 +1,132 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Coalescing of identical concurrent computations.
+ * @details	A camera group fanning one frame out to several consumers makes
+ *          the server receive the same image a few milliseconds apart.
+ *          Callers with the same key while a computation is running wait
+ *          for it and share its result instead of starting their own.
+ *          Nothing is kept once the computation is done, caching is left
+ *          to FrFeatureCache.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "fr_hash.h"
+
+/**
+ * @brief Runs at most one computation per key at a time.
+ * @code
+ * FrSingleFlight<Reply> flights;
+ * bool coalesced;
+ * std::shared_ptr<const Reply> reply = flights.run(key, []() {
+ *     return compute();
+ * }, context->deadline(), &coalesced);
+ * @endcode
+ */
+template <class Value>
+class FrSingleFlight {
+    public:
+        typedef std::shared_ptr<const Value> Result;
+
+        FrSingleFlight() : coalesced_(0) {}
+        FrSingleFlight(const FrSingleFlight&) = delete;
+        FrSingleFlight& operator=(const FrSingleFlight&) = delete;
+
+        /**
+         * @brief			    Compute a value, or wait for the one being
+         *                      computed under the same key.
+         * @param[in] key 	    Identity of the computation.
+         * @param[in] compute   Computation, run on the calling thread.
+         * @param[in] deadline  Deadline of the caller, only bounds the wait
+         *                      for the computation of another one.
+         * @param[out] coalesced True if the value was computed by another
+         *                      caller.
+         * @return			    The value, shared by all the callers, null if
+         *                      the deadline passed while waiting;
+         *                      rethrows what compute threw.
+         */
+        Result run(const FrContentHash &key, std::function<Value()> compute,
+                    std::chrono::system_clock::time_point deadline,
+                    bool *coalesced) {
+            std::promise<Result> promise;
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto found = flights_.find(key);
+            if (flights_.end() != found) {
+                std::shared_future<Result> flight = found->second;
+                lock.unlock();
+                coalesced_.fetch_add(1, std::memory_order_relaxed);
+                *coalesced = true;
+                // Far deadlines, e.g. none, are waited for without timeout.
+                auto left = deadline - std::chrono::system_clock::now();
+                if (left > std::chrono::hours(24)) {
+                    flight.wait();
+                } else if (std::future_status::ready
+                            != flight.wait_for(left)) {
+                    return Result();
+                }
+                return flight.get();
+            }
+            flights_[key] = promise.get_future().share();
+            lock.unlock();
+            *coalesced = false;
+
+            Result result;
+            try {
+                result = std::make_shared<const Value>(compute());
+                promise.set_value(result);
+            } catch (...) {
+                promise.set_exception(std::current_exception());
+                forget(key);
+                throw;
+            }
+            forget(key);
+            return result;
+        }
+        /// Callers served by the computation of another one.
+        uint64_t coalesced() const {
+            return coalesced_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct KeyHash {
+            size_t operator()(const FrContentHash &key) const {
+                return static_cast<size_t>(key.lo);
+            }
+        };
+
+        void forget(const FrContentHash &key) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            flights_.erase(key);
+        }
+
+        std::mutex mutex_;
+        std::unordered_map<FrContentHash, std::shared_future<Result>,
+                            KeyHash> flights_;
+        std::atomic<uint64_t> coalesced_;
+};
@@ -0,0 +1,106 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Per-stage latency of one request, on the monotonic clock.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Accumulates the time of named stages since its creation.
+ */
+class FrStageTimer {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        FrStageTimer() : start_(Clock::now()) {}
+
+        /**
+         * @brief			Add time to a stage, a stage seen again
+         *                  accumulates.
+         * @param[in] stage Name of the stage, a string literal.
+         * @param[in] ms 	Milliseconds.
+         * @return			Void.
+         */
+        void add(const char *stage, double ms) {
+            for (auto &entry : stages_) {
+                if (entry.first == stage) {
+                    entry.second += ms;
+                    return;
+                }
+            }
+            stages_.push_back(std::make_pair(stage, ms));
+        }
+        /// Milliseconds since creation.
+        double totalMs() const {
+            return std::chrono::duration<double, std::milli>(
+                                        Clock::now() - start_).count();
+        }
+        /// Stages in order of first appearance.
+        const std::vector<std::pair<const char*, double>>& stages() const {
+            return stages_;
+        }
+        /**
+         * @brief			    Set costInMs and the stages of a reply.
+         * @param[out] reply    FeatureReply or QualityReply.
+         * @return			    Void.
+         */
+        template <class Reply>
+        void fill(Reply *reply) const {
+            for (const auto &entry : stages_) {
+                auto timing = reply->add_stages();
+                timing->set_stage(entry.first);
+                timing->set_ms(static_cast<float>(entry.second));
+            }
+            reply->set_costinms(static_cast<float>(totalMs()));
+        }
+
+    private:
+        Clock::time_point start_;
+        std::vector<std::pair<const char*, double>> stages_;
+};
+
+/**
+ * @brief Adds the time of the current scope to a stage, if any timer.
+ */
+class FrStageScope {
+    public:
+        FrStageScope(FrStageTimer *timer, const char *stage)
+                : timer_(timer), stage_(stage),
+                begin_(FrStageTimer::Clock::now()) {
+        }
+        ~FrStageScope() {
+            if (nullptr != timer_) {
+                timer_->add(stage_, std::chrono::duration<double, std::milli>(
+                            FrStageTimer::Clock::now() - begin_).count());
+            }
+        }
+        FrStageScope(const FrStageScope&) = delete;
+        FrStageScope& operator=(const FrStageScope&) = delete;
+
+    private:
+        FrStageTimer *timer_;
+        const char *stage_;
+        FrStageTimer::Clock::time_point begin_;
+};
@@ -0,0 +1,85 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Fixed-size pool of worker threads.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Runs submitted tasks on a fixed number of threads.
+ * @code
+ * FrThreadPool pool(4);
+ * std::future<void> done = pool.submit([]() { work(); });
+ * done.get();
+ * @endcode
+ */
+class FrThreadPool {
+    public:
+        /// No default constructor.
+        FrThreadPool() = delete;
+        /**
+         * @brief			    Constructor, launches the threads.
+         * @param[in] threads 	Number of threads, 0 means one per core.
+         */
+        explicit FrThreadPool(int threads);
+        /**
+         * @brief			    Constructor of pinned threads.
+         * @param[in] threads 	Number of threads, 0 means one per CPU.
+         * @param[in] cpus 	    CPU of each thread in turn, see
+         *                      frResolveCpus; none leaves them unpinned.
+         */
+        FrThreadPool(int threads, const std::vector<int> &cpus);
+        /// Runs the tasks already submitted, then joins the threads.
+        ~FrThreadPool();
+        FrThreadPool(const FrThreadPool&) = delete;
+        FrThreadPool& operator=(const FrThreadPool&) = delete;
+
+        /**
+         * @brief			Queue a task.
+         * @param[in] task 	Task to run on one of the threads.
+         * @return			Future ready once the task ran, rethrowing
+         *                  whatever the task threw.
+         */
+        std::future<void> submit(std::function<void()> task);
+        /// Number of threads.
+        int size() const { return static_cast<int>(threads_.size()); }
+        /// Threads the system refused to pin.
+        int unpinned() const { return unpinned_; }
+
+    private:
+        /// Thread loop, pinned to cpu first unless negative.
+        void run(int cpu);
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<std::packaged_task<void()>> tasks_;
+        bool stopping_ = false;
+        std::atomic<int> unpinned_{0};
+        std::vector<std::thread> threads_;
+};
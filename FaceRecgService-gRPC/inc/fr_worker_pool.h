@@ -0,0 +1,180 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Recognizer worker processes fed through shared memory.
+ * @details	The SDK is a process-wide singleton, one model per process. A
+ *          pool forks a supervisor that forks the workers, each loading
+ *          its own recognizer, and restarts the ones that die. The server
+ *          process keeps its port and only loses the calls the dead worker
+ *          was running, they fail instead of crashing the next worker too.
+ *          Calls go through a ring of slots in memory shared by all the
+ *          processes: the caller copies the image in a free slot, queues
+ *          its index and waits; a worker takes the index, runs the SDK on
+ *          the slot and writes the results back into it. Images are
+ *          copied once, with no socket or serialization. A context handed
+ *          to several SDK calls is the decoded BMP, others stay encoded and
+ *          are decoded by the worker, on its own core.
+ *          The pool must be started before any thread is created, the
+ *          processes are forked from the caller as it is then.
+ *          HiarFace_compareFaceFeature needs no model and stays in the
+ *          server process.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# pragma once
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Settings of FrWorkerPool.
+ */
+struct FrWorkerPoolOptions {
+    /// Worker processes, each with its own recognizer.
+    int workers = 2;
+    /// Calls in flight at once, 0 means two per worker.
+    int slots = 0;
+    /// Bytes of one slot: image, boxes and results of a call.
+    size_t slotBytes = 32u << 20;
+    /// Given to HiarFace_initRecognizer.
+    std::string modelPath;
+    /// Log file of the workers, suffixed with their index.
+    std::string loggerPath;
+};
+
+/**
+ * @brief Recognizer calls run by worker processes.
+ *        Methods have the contracts of interface_face_recognizer.h, a
+ *        call fails with -1 if its worker dies, its data does not fit in
+ *        a slot, its deadline passes or the supervisor is gone. Outputs
+ *        are allocated with new[] in the calling process.
+ */
+class FrWorkerPool {
+    public:
+        /// Deadline of a call, as given by grpc::ServerContext::deadline().
+        typedef std::chrono::system_clock::time_point Deadline;
+
+        /// No default constructor.
+        FrWorkerPool() = delete;
+        explicit FrWorkerPool(const FrWorkerPoolOptions &options);
+        /// Stops the processes.
+        ~FrWorkerPool();
+        FrWorkerPool(const FrWorkerPool&) = delete;
+        FrWorkerPool& operator=(const FrWorkerPool&) = delete;
+
+        /**
+         * @brief			    Fork the supervisor, the workers load
+         *                      their recognizers in parallel.
+         * @param[out] error    Reason of a failure.
+         * @return			    False if the memory cannot be mapped or
+         *                      the supervisor cannot be forked.
+         */
+        bool start(std::string *error);
+        /**
+         * @brief			    Wait for every worker to load its
+         *                      recognizer, calls wait for them anyway.
+         * @param[out] error    Reason of a failure.
+         * @return			    False if a worker cannot load the models.
+         */
+        bool waitReady(std::string *error);
+        /// Stop the supervisor and the workers, calls in flight fail.
+        void stop();
+        /**
+         * @brief			    Whether calls can still run. The supervisor
+         *                      dying takes the workers with it: the pool
+         *                      stops, calls in flight fail.
+         * @return			    False once stopped or the supervisor gone.
+         */
+        bool alive();
+
+        /// The calls wait for their worker until the deadline at most.
+        int extractFeature(const unsigned char *imgData, const int lenImg,
+                            const int *faceBboxes, const int numBbox,
+                            float **feature, int *lenFeatures,
+                            Deadline deadline = Deadline::max());
+        int detectAndExtractFeature(const unsigned char *imgData,
+                                    const int lenImg, int **faceBboxes,
+                                    int *numBbox, float **feature,
+                                    int *lenFeatures,
+                                    Deadline deadline = Deadline::max());
+        int getQualityFaceCrops(const unsigned char *imgData,
+                                const int lenImg, const int *faceBboxes,
+                                const int numBbox, int *faceQuality,
+                                float *faceDirection,
+                                Deadline deadline = Deadline::max());
+
+        /// Workers of the pool.
+        int workers() const { return options_.workers; }
+        /// Print calls served, failed and workers restarted.
+        void dump(std::ostream &os) const;
+        /// Same counters in Prometheus text format.
+        void exposition(std::ostream &os) const;
+
+    private:
+        struct Shared;
+        struct Slot;
+
+        /**
+         * @brief			    Run a call on a worker and wait for it.
+         * @return			    Slot holding the results, to be released
+         *                      once read, or -1 if the call was not run.
+         */
+        int submit(int op, const unsigned char *imgData, int lenImg,
+                    const int *faceBboxes, int numBbox, Deadline deadline);
+        /// Slot reserved for the caller, waits for a free one.
+        int acquireSlot();
+        void releaseSlot(int index);
+        /// Give up the call of a slot, reused once a worker posts done.
+        void abandon(int index);
+        /// Free the abandoned slots done meanwhile, mutex_ held.
+        void reclaim();
+        Slot* slot(int index) const;
+
+        /// Loop of the supervisor process, never returns.
+        void supervise();
+        /// Fork worker number index, its pid or -1.
+        pid_t spawn(int index);
+        /// Loop of a worker process, never returns.
+        void work(int index);
+        /// Fail the calls of a dead worker.
+        void recover(pid_t worker);
+
+        FrWorkerPoolOptions options_;
+        int slots_;
+        size_t slotBytes_;
+        /// Mapping shared by the processes, header then slots.
+        void *memory_ = nullptr;
+        size_t memoryBytes_ = 0;
+        Shared *shared_ = nullptr;
+        pid_t supervisor_ = -1;
+
+        /// Free slots, taken by the threads of the server process only.
+        /// Also guards supervisor_.
+        std::mutex mutex_;
+        std::condition_variable slotFreed_;
+        std::vector<int> freeSlots_;
+        /// Slots whose caller left before the worker was done.
+        std::vector<int> abandoned_;
+};
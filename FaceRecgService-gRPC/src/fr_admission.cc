@@ -0,0 +1,168 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Admission control of rpcs, ahead of their work.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_admission.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+/// Weight of the last request in the mean service time.
+const double kServiceAlpha = 0.2;
+
+/// Deadlines further away are waited for without a timeout, so that the
+/// infinite one does not overflow the steady clock.
+const std::chrono::hours kFarDeadline(24);
+
+} // namespace
+
+FrAdmission::FrAdmission(const FrAdmissionOptions &options)
+        : maxConcurrent_(0 < options.maxConcurrent ? options.maxConcurrent
+                : std::max(1u, std::thread::hardware_concurrency())),
+        maxQueue_(options.maxQueue) {
+}
+
+FrAdmission::Verdict FrAdmission::enter(FrMetrics::Rpc rpc,
+                                        Deadline deadline) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Lane &lane = lanes_[rpc];
+    Deadline now = std::chrono::system_clock::now();
+    if (deadline <= now) {
+        lane.late++;
+        return kLate;
+    }
+    if (lane.running < maxConcurrent_ && lane.waiters.empty()) {
+        lane.running++;
+        lane.admitted++;
+        lane.waitUs.record(0);
+        return kAdmitted;
+    }
+    if (waiting_ >= maxQueue_) {
+        lane.queueFull++;
+        return kQueueFull;
+    }
+    double expectedUs = (lane.waiters.size() + 1) * lane.serviceUs
+                        / maxConcurrent_ + lane.serviceUs;
+    if (deadline - now < std::chrono::microseconds(
+                                static_cast<int64_t>(expectedUs))) {
+        lane.late++;
+        return kLate;
+    }
+
+    Waiter waiter;
+    lane.waiters.push_back(&waiter);
+    waiting_++;
+    std::chrono::steady_clock::time_point begin
+                                    = std::chrono::steady_clock::now();
+    auto handedOver = [&waiter]() { return waiter.admitted; };
+    if (deadline - now > kFarDeadline) {
+        waiter.ready.wait(lock, handedOver);
+    } else if (!waiter.ready.wait_until(lock, begin + (deadline - now),
+                                        handedOver)) {
+        // Expired in the queue, nobody took it out.
+        lane.waiters.remove(&waiter);
+        waiting_--;
+        lane.late++;
+        return kLate;
+    }
+    lane.admitted++;
+    lane.waitUs.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - begin).count());
+    return kAdmitted;
+}
+
+void FrAdmission::leave(FrMetrics::Rpc rpc, uint64_t us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Lane &lane = lanes_[rpc];
+    lane.serviceUs = 0 == lane.serviceUs ? us
+                    : lane.serviceUs + kServiceAlpha * (us - lane.serviceUs);
+    if (lane.waiters.empty()) {
+        lane.running--;
+        return;
+    }
+    // The slot goes to the oldest waiter, running stays the same.
+    Waiter *next = lane.waiters.front();
+    lane.waiters.pop_front();
+    waiting_--;
+    next->admitted = true;
+    next->ready.notify_one();
+}
+
+void FrAdmission::dump(std::ostream &os) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    os << "Admission: " << maxConcurrent_ << " per rpc, queue of "
+        << maxQueue_ << std::endl;
+    for (int r = 0; r < FrMetrics::kRpcCount; r++) {
+        const Lane &lane = lanes_[r];
+        if (0 == lane.admitted + lane.queueFull + lane.late) {
+            continue;
+        }
+        os << "  " << FrMetrics::rpcName(static_cast<FrMetrics::Rpc>(r))
+            << ": " << lane.admitted << " admitted, " << lane.queueFull
+            << " queue full, " << lane.late << " late" << std::endl;
+        lane.waitUs.dump(os, "  queue wait", "us");
+    }
+}
+
+void FrAdmission::exposition(std::ostream &os) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    os << "# HELP fr_admission_admitted_total Requests given a slot.\n"
+        << "# TYPE fr_admission_admitted_total counter\n";
+    for (int r = 0; r < FrMetrics::kRpcCount; r++) {
+        if (0 != lanes_[r].admitted) {
+            os << "fr_admission_admitted_total{rpc=\""
+                << FrMetrics::rpcName(static_cast<FrMetrics::Rpc>(r))
+                << "\"} " << lanes_[r].admitted << '\n';
+        }
+    }
+    os << "# HELP fr_admission_rejected_total Requests turned away, with"
+        << " RESOURCE_EXHAUSTED when the queue is full and"
+        << " DEADLINE_EXCEEDED when late.\n"
+        << "# TYPE fr_admission_rejected_total counter\n";
+    for (int r = 0; r < FrMetrics::kRpcCount; r++) {
+        const char *name = FrMetrics::rpcName(static_cast<FrMetrics::Rpc>(r));
+        if (0 != lanes_[r].queueFull) {
+            os << "fr_admission_rejected_total{rpc=\"" << name
+                << "\",reason=\"queue_full\"} " << lanes_[r].queueFull
+                << '\n';
+        }
+        if (0 != lanes_[r].late) {
+            os << "fr_admission_rejected_total{rpc=\"" << name
+                << "\",reason=\"late\"} " << lanes_[r].late << '\n';
+        }
+    }
+    os << "# HELP fr_admission_queued Requests waiting for a slot.\n"
+        << "# TYPE fr_admission_queued gauge\n"
+        << "fr_admission_queued " << waiting_ << '\n';
+    os << "# HELP fr_admission_wait_seconds Time admitted requests waited"
+        << " for a slot.\n"
+        << "# TYPE fr_admission_wait_seconds histogram\n";
+    for (int r = 0; r < FrMetrics::kRpcCount; r++) {
+        const FrHistogram &wait = lanes_[r].waitUs;
+        if (0 == wait.count()) {
+            continue;
+        }
+        const char *name = FrMetrics::rpcName(static_cast<FrMetrics::Rpc>(r));
+        wait.prometheus(os, "fr_admission_wait_seconds",
+                        std::string("rpc=\"") + name + '"');
+    }
+}
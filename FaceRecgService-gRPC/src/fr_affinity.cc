@@ -0,0 +1,152 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	CPU sets of the worker threads, NUMA nodes included.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_affinity.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+/// Nodes probed in sysfs, numbered from 0 on.
+const int kMaxNodes = 64;
+
+/// Non-negative integer of the whole text.
+bool parseIndex(const std::string &text, int *value) {
+    if (text.empty() || std::string::npos
+                            != text.find_first_not_of("0123456789")) {
+        return false;
+    }
+    *value = std::atoi(text.c_str());
+    return true;
+}
+
+} // namespace
+
+bool frParseCpuList(const std::string &text, std::vector<int> *cpus) {
+    std::istringstream ranges(text);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        size_t dash = range.find('-');
+        int first = 0;
+        int last = 0;
+        if (std::string::npos == dash) {
+            if (!parseIndex(range, &first)) {
+                return false;
+            }
+            last = first;
+        } else if (!parseIndex(range.substr(0, dash), &first)
+                    || !parseIndex(range.substr(dash + 1), &last)
+                    || last < first) {
+            return false;
+        }
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus->push_back(cpu);
+        }
+    }
+    return !cpus->empty();
+}
+
+std::vector<std::vector<int>> frNumaNodes() {
+    std::vector<std::vector<int>> nodes;
+    for (int node = 0; node < kMaxNodes; node++) {
+        std::ifstream in("/sys/devices/system/node/node"
+                        + std::to_string(node) + "/cpulist");
+        std::string line;
+        std::vector<int> cpus;
+        if (!std::getline(in, line)) {
+            break;
+        }
+        // A node without CPUs, memory only, keeps its number.
+        frParseCpuList(line, &cpus);
+        nodes.push_back(cpus);
+    }
+    if (nodes.empty()) {
+        int count = static_cast<int>(std::thread::hardware_concurrency());
+        nodes.emplace_back();
+        for (int cpu = 0; cpu < (0 < count ? count : 1); cpu++) {
+            nodes.back().push_back(cpu);
+        }
+    }
+    return nodes;
+}
+
+bool frResolveCpus(const std::string &spec, std::vector<int> *cpus) {
+    cpus->clear();
+    if (spec.empty()) {
+        return true;
+    }
+    if ("all" == spec) {
+        // Round robin over the nodes.
+        std::vector<std::vector<int>> nodes = frNumaNodes();
+        for (size_t i = 0; ; i++) {
+            bool any = false;
+            for (const auto &node : nodes) {
+                if (i < node.size()) {
+                    cpus->push_back(node[i]);
+                    any = true;
+                }
+            }
+            if (!any) {
+                break;
+            }
+        }
+        return true;
+    }
+    if (0 == spec.compare(0, 5, "node:")) {
+        int node = 0;
+        std::ifstream in;
+        if (parseIndex(spec.substr(5), &node)) {
+            in.open("/sys/devices/system/node/node" + std::to_string(node)
+                    + "/cpulist");
+        }
+        std::string line;
+        return std::getline(in, line) && frParseCpuList(line, cpus);
+    }
+    return frParseCpuList(spec, cpus);
+}
+
+int frNodeOfCpu(int cpu) {
+    std::vector<std::vector<int>> nodes = frNumaNodes();
+    for (size_t node = 0; node < nodes.size(); node++) {
+        for (int known : nodes[node]) {
+            if (known == cpu) {
+                return static_cast<int>(node);
+            }
+        }
+    }
+    return 0;
+}
+
+bool frPinThread(int cpu) {
+    if (0 > cpu || CPU_SETSIZE <= cpu) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return 0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
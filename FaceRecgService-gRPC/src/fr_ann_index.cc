@@ -0,0 +1,891 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Approximate nearest-neighbour indexes for the face gallery.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_ann_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+#include "fr_feature_math.h"
+
+namespace {
+
+/**
+ * @brief Marks of the nodes visited by one search, reused by the thread.
+ *        Bumping the epoch forgets every mark at once.
+ */
+struct VisitedList {
+    std::vector<uint32_t> marks;
+    uint32_t epoch = 0;
+
+    void reset(size_t nodes) {
+        if (marks.size() < nodes) {
+            marks.resize(nodes, 0);
+        }
+        if (0 == ++epoch) {
+            std::fill(marks.begin(), marks.end(), 0);
+            epoch = 1;
+        }
+    }
+    bool visit(uint32_t node) {
+        if (epoch == marks[node]) {
+            return false;
+        }
+        marks[node] = epoch;
+        return true;
+    }
+};
+
+/**
+ * @brief			    Lloyd's k-means with squared L2 distance.
+ * @param[in] data 	    n x dim, row-major.
+ * @param[in] n 	    Number of points.
+ * @param[in] dim 	    Dimension of points.
+ * @param[in] k 	    Number of centroids.
+ * @param[in] iters     Iterations.
+ * @param[in] rng       Random source of the seeding.
+ * @param[out] centroids k x dim, row-major.
+ * @param[out] assign   Centroid of each point, may be null.
+ * @return			    Void.
+ */
+void kmeans(const float *data, size_t n, int dim, int k, int iters,
+            std::mt19937 &rng, std::vector<float> *centroids,
+            std::vector<int> *assign) {
+    centroids->assign(static_cast<size_t>(k) * dim, 0.0f);
+    if (0 == n) {
+        return;
+    }
+    // Seed with distinct points when there are enough.
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+    for (int c = 0; c < k; c++) {
+        size_t pick = order[c % n];
+        std::copy(data + pick * dim, data + (pick + 1) * dim,
+                    centroids->begin() + static_cast<size_t>(c) * dim);
+    }
+
+    std::vector<int> nearest(n, 0);
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    threads = std::max(1, std::min(threads, static_cast<int>(n / 1024) + 1));
+    for (int it = 0; it < iters; it++) {
+        // Assignment, the expensive step, split across threads.
+        std::vector<std::thread> workers;
+        size_t chunk = (n + threads - 1) / threads;
+        for (int t = 0; t < threads; t++) {
+            size_t begin = t * chunk;
+            size_t end = std::min(n, begin + chunk);
+            workers.emplace_back([=, &nearest]() {
+                for (size_t i = begin; i < end; i++) {
+                    float best = frSquaredL2(data + i * dim,
+                                            centroids->data(), dim);
+                    int bestC = 0;
+                    for (int c = 1; c < k; c++) {
+                        float d = frSquaredL2(data + i * dim,
+                                    centroids->data()
+                                    + static_cast<size_t>(c) * dim, dim);
+                        if (d < best) {
+                            best = d;
+                            bestC = c;
+                        }
+                    }
+                    nearest[i] = bestC;
+                }
+            });
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+
+        // Update, empty clusters are reseeded on a random point.
+        std::vector<double> sums(static_cast<size_t>(k) * dim, 0.0);
+        std::vector<size_t> counts(k, 0);
+        for (size_t i = 0; i < n; i++) {
+            double *sum = &sums[static_cast<size_t>(nearest[i]) * dim];
+            const float *point = data + i * dim;
+            for (int d = 0; d < dim; d++) {
+                sum[d] += point[d];
+            }
+            counts[nearest[i]]++;
+        }
+        std::uniform_int_distribution<size_t> anyPoint(0, n - 1);
+        for (int c = 0; c < k; c++) {
+            float *centroid = centroids->data() + static_cast<size_t>(c) * dim;
+            if (0 == counts[c]) {
+                size_t pick = anyPoint(rng);
+                std::copy(data + pick * dim, data + (pick + 1) * dim, centroid);
+                continue;
+            }
+            for (int d = 0; d < dim; d++) {
+                centroid[d] = static_cast<float>(
+                                sums[static_cast<size_t>(c) * dim + d]
+                                / counts[c]);
+            }
+        }
+    }
+    if (nullptr != assign) {
+        assign->swap(nearest);
+    }
+}
+
+/// Row of rows, count x dim, closest to vec.
+int nearestRow(const float *vec, const float *rows, int count, int dim) {
+    int best = 0;
+    float bestDist = frSquaredL2(vec, rows, dim);
+    for (int r = 1; r < count; r++) {
+        float d = frSquaredL2(vec, rows + static_cast<size_t>(r) * dim, dim);
+        if (d < bestDist) {
+            bestDist = d;
+            best = r;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief			        Product-quantize the residual of a feature.
+ * @param[in] vec 	        HIAR_FACE_FEATURE_LEN floats.
+ * @param[in] centroid 	    Coarse centroid of vec.
+ * @param[in] codebooks     subvectors x kCodebook x subDim.
+ * @param[out] code         subvectors bytes.
+ * @return			        Void.
+ */
+void pqEncode(const float *vec, const float *centroid,
+                const float *codebooks, int subvectors, int subDim,
+                uint8_t *code) {
+    std::vector<float> residual(subDim);
+    for (int j = 0; j < subvectors; j++) {
+        for (int d = 0; d < subDim; d++) {
+            residual[d] = vec[j * subDim + d] - centroid[j * subDim + d];
+        }
+        code[j] = static_cast<uint8_t>(nearestRow(residual.data(),
+                        codebooks + static_cast<size_t>(j)
+                                    * FrIvfPqIndex::kCodebook * subDim,
+                        FrIvfPqIndex::kCodebook, subDim));
+    }
+}
+
+/// Sub-quantizer count dividing the feature length, 64 if invalid.
+int validSubvectors(int subvectors) {
+    if (0 >= subvectors || 0 != HIAR_FACE_FEATURE_LEN % subvectors) {
+        return 64;
+    }
+    return subvectors;
+}
+
+FrIvfPqParams sanitize(FrIvfPqParams params) {
+    params.nlist = std::max(1, params.nlist);
+    params.nprobe = std::max(1, std::min(params.nprobe, params.nlist));
+    params.subvectors = validSubvectors(params.subvectors);
+    params.refine = std::max(0, params.refine);
+    params.trainPerList = std::max(1, params.trainPerList);
+    params.trainIters = std::max(1, params.trainIters);
+    params.retrain = std::max(0.0f, params.retrain);
+    return params;
+}
+
+} // namespace
+
+/**************************************************************************
+ * FrHnswIndex
+ **************************************************************************/
+
+FrHnswIndex::FrHnswIndex(const FrVectorStore *store,
+                        const FrHnswParams &params)
+        : store_(store),
+        M_(std::max(2, params.M)),
+        efConstruction_(std::max(std::max(2, params.M),
+                                params.efConstruction)),
+        efSearch_(std::max(1, params.efSearch)),
+        levelMult_(1.0 / std::log(static_cast<double>(std::max(2, params.M)))),
+        rng_(params.seed) {
+}
+
+float FrHnswIndex::distance(const float *probe, uint32_t node) const {
+    return 1.0f - frDotProduct(probe, vectorOfNode(node),
+                                HIAR_FACE_FEATURE_LEN);
+}
+
+uint32_t* FrHnswIndex::linksOf(uint32_t node, int level) {
+    if (0 == level) {
+        return &links0_[static_cast<size_t>(node) * (2 * M_ + 1)];
+    }
+    return &upperLinks_[node][static_cast<size_t>(level - 1) * (M_ + 1)];
+}
+
+const uint32_t* FrHnswIndex::linksOf(uint32_t node, int level) const {
+    return const_cast<FrHnswIndex*>(this)->linksOf(node, level);
+}
+
+uint32_t FrHnswIndex::greedy(const float *probe, uint32_t entry,
+                            int level) const {
+    uint32_t current = entry;
+    float currentDist = distance(probe, current);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        const uint32_t *links = linksOf(current, level);
+        for (uint32_t i = 1; i <= links[0]; i++) {
+            uint32_t next = links[i];
+            if (deleted_[next]) {
+                continue;
+            }
+            float d = distance(probe, next);
+            if (d < currentDist) {
+                currentDist = d;
+                current = next;
+                changed = true;
+            }
+        }
+    }
+    return current;
+}
+
+std::vector<FrHnswIndex::Candidate> FrHnswIndex::searchLayer(
+                            const float *probe, uint32_t entry,
+                            int ef, int level) const {
+    static thread_local VisitedList visited;
+    visited.reset(labels_.size());
+
+    // Closest candidate on top.
+    std::priority_queue<Candidate, std::vector<Candidate>,
+                        std::greater<Candidate>> candidates;
+    // Farthest result on top.
+    std::priority_queue<Candidate> results;
+    Candidate first(distance(probe, entry), entry);
+    candidates.push(first);
+    results.push(first);
+    visited.visit(entry);
+
+    while (!candidates.empty()) {
+        Candidate closest = candidates.top();
+        if (closest.first > results.top().first
+            && static_cast<int>(results.size()) >= ef) {
+            break;
+        }
+        candidates.pop();
+        const uint32_t *links = linksOf(closest.second, level);
+        for (uint32_t i = 1; i <= links[0]; i++) {
+            uint32_t next = links[i];
+            if (deleted_[next] || !visited.visit(next)) {
+                continue;
+            }
+            float d = distance(probe, next);
+            if (static_cast<int>(results.size()) < ef
+                || d < results.top().first) {
+                candidates.push(Candidate(d, next));
+                results.push(Candidate(d, next));
+                if (static_cast<int>(results.size()) > ef) {
+                    results.pop();
+                }
+            }
+        }
+    }
+
+    std::vector<Candidate> found(results.size());
+    for (size_t i = found.size(); i > 0; i--) {
+        found[i - 1] = results.top();
+        results.pop();
+    }
+    return found;
+}
+
+std::vector<FrHnswIndex::Candidate> FrHnswIndex::selectNeighbours(
+                            const std::vector<Candidate> &candidates,
+                            int maxCount) const {
+    // A candidate closer to a kept neighbour than to the base is
+    // reachable through that neighbour, skip it to spread the links.
+    std::vector<Candidate> kept;
+    for (const Candidate &candidate : candidates) {
+        if (static_cast<int>(kept.size()) >= maxCount) {
+            break;
+        }
+        const float *vec = vectorOfNode(candidate.second);
+        bool diverse = true;
+        for (const Candidate &other : kept) {
+            if (distance(vec, other.second) < candidate.first) {
+                diverse = false;
+                break;
+            }
+        }
+        if (diverse) {
+            kept.push_back(candidate);
+        }
+    }
+    return kept;
+}
+
+void FrHnswIndex::setLinks(uint32_t node, int level,
+                            const std::vector<uint32_t> &targets) {
+    uint32_t *links = linksOf(node, level);
+    for (uint32_t i = 1; i <= links[0]; i++) {
+        std::vector<uint32_t> &from = linkedFrom_[links[i]][level];
+        auto found = std::find(from.begin(), from.end(), node);
+        if (from.end() != found) {
+            *found = from.back();
+            from.pop_back();
+        }
+    }
+    links[0] = static_cast<uint32_t>(targets.size());
+    for (size_t i = 0; i < targets.size(); i++) {
+        links[i + 1] = targets[i];
+        linkedFrom_[targets[i]][level].push_back(node);
+    }
+}
+
+void FrHnswIndex::connect(uint32_t node, uint32_t neighbour, int level) {
+    const uint32_t *links = linksOf(neighbour, level);
+    std::vector<uint32_t> targets(links + 1, links + 1 + links[0]);
+    if (static_cast<int>(targets.size()) < maxLinks(level)) {
+        targets.push_back(node);
+        setLinks(neighbour, level, targets);
+        return;
+    }
+    const float *base = vectorOfNode(neighbour);
+    std::vector<Candidate> candidates;
+    candidates.push_back(Candidate(distance(base, node), node));
+    for (uint32_t target : targets) {
+        candidates.push_back(Candidate(distance(base, target), target));
+    }
+    std::sort(candidates.begin(), candidates.end());
+    std::vector<Candidate> kept = selectNeighbours(candidates,
+                                                    maxLinks(level));
+    targets.clear();
+    for (const Candidate &candidate : kept) {
+        targets.push_back(candidate.second);
+    }
+    setLinks(neighbour, level, targets);
+}
+
+void FrHnswIndex::add(uint32_t label) {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    int level = static_cast<int>(-std::log(1.0 - uniform(rng_)) * levelMult_);
+
+    // Slots of removed nodes are reused, nothing links to them anymore.
+    uint32_t node;
+    if (freeNodes_.empty()) {
+        node = static_cast<uint32_t>(labels_.size());
+        labels_.push_back(label);
+        deleted_.push_back(0);
+        levels_.push_back(level);
+        links0_.resize(links0_.size() + 2 * M_ + 1, 0);
+        upperLinks_.push_back(std::vector<uint32_t>());
+        linkedFrom_.push_back(std::vector<std::vector<uint32_t>>());
+    } else {
+        node = freeNodes_.back();
+        freeNodes_.pop_back();
+        labels_[node] = label;
+        deleted_[node] = 0;
+        levels_[node] = level;
+        linksOf(node, 0)[0] = 0;
+    }
+    upperLinks_[node].assign(static_cast<size_t>(level) * (M_ + 1), 0);
+    linkedFrom_[node].resize(level + 1);
+    nodeOf_[label] = node;
+    alive_++;
+
+    if (0 > maxLevel_) {
+        entry_ = node;
+        maxLevel_ = level;
+        return;
+    }
+
+    const float *vec = vectorOfNode(node);
+    uint32_t entry = entry_;
+    for (int l = maxLevel_; l > level; l--) {
+        entry = greedy(vec, entry, l);
+    }
+    for (int l = std::min(level, maxLevel_); l >= 0; l--) {
+        std::vector<Candidate> found = searchLayer(vec, entry,
+                                                    efConstruction_, l);
+        std::vector<Candidate> kept = selectNeighbours(found, M_);
+        std::vector<uint32_t> targets;
+        for (const Candidate &candidate : kept) {
+            targets.push_back(candidate.second);
+        }
+        setLinks(node, l, targets);
+        for (uint32_t target : targets) {
+            connect(node, target, l);
+        }
+        if (!found.empty()) {
+            entry = found[0].second;
+        }
+    }
+    if (level > maxLevel_) {
+        maxLevel_ = level;
+        entry_ = node;
+    }
+}
+
+void FrHnswIndex::remove(uint32_t label) {
+    auto found = nodeOf_.find(label);
+    if (nodeOf_.end() == found) {
+        return;
+    }
+    uint32_t node = found->second;
+    nodeOf_.erase(found);
+    deleted_[node] = 1;
+    alive_--;
+
+    /**
+     * Searches skip the node from now on, so the nodes linked with it
+     * would lose the paths going through it: relink each node linked with
+     * it among its own links and the links of the removed node. The nodes
+     * linking to it are in linkedFrom_; afterwards nothing links to the
+     * removed node and its slot is free for the next add.
+     */
+    for (int l = levels_[node]; l >= 0; l--) {
+        const uint32_t *removedLinks = linksOf(node, l);
+        std::vector<uint32_t> orphans(removedLinks + 1,
+                                    removedLinks + 1 + removedLinks[0]);
+        std::vector<uint32_t> affected(linkedFrom_[node][l]);
+        affected.insert(affected.end(), orphans.begin(), orphans.end());
+        std::sort(affected.begin(), affected.end());
+        affected.erase(std::unique(affected.begin(), affected.end()),
+                        affected.end());
+        for (uint32_t neighbour : affected) {
+            const uint32_t *links = linksOf(neighbour, l);
+            const float *base = vectorOfNode(neighbour);
+            std::vector<uint32_t> pool(links + 1, links + 1 + links[0]);
+            pool.insert(pool.end(), orphans.begin(), orphans.end());
+            std::sort(pool.begin(), pool.end());
+            pool.erase(std::unique(pool.begin(), pool.end()), pool.end());
+            std::vector<Candidate> candidates;
+            for (uint32_t other : pool) {
+                if (other != neighbour && !deleted_[other]) {
+                    candidates.push_back(Candidate(distance(base, other),
+                                                    other));
+                }
+            }
+            std::sort(candidates.begin(), candidates.end());
+            std::vector<Candidate> kept = selectNeighbours(candidates,
+                                                            maxLinks(l));
+            std::vector<uint32_t> targets;
+            for (const Candidate &candidate : kept) {
+                targets.push_back(candidate.second);
+            }
+            setLinks(neighbour, l, targets);
+        }
+        setLinks(node, l, std::vector<uint32_t>());
+    }
+    freeNodes_.push_back(node);
+
+    if (0 == alive_) {
+        maxLevel_ = -1;
+    } else if (node == entry_) {
+        // Promote any node of the highest remaining level.
+        maxLevel_ = -1;
+        for (uint32_t i = 0; i < labels_.size(); i++) {
+            if (!deleted_[i] && levels_[i] > maxLevel_) {
+                maxLevel_ = levels_[i];
+                entry_ = i;
+            }
+        }
+    }
+}
+
+std::vector<FrAnnResult> FrHnswIndex::search(const float *probe, int topK,
+                                            int effort) const {
+    std::vector<FrAnnResult> results;
+    if (0 > maxLevel_ || 0 >= topK) {
+        return results;
+    }
+    int ef = std::max(0 < effort ? effort : efSearch_, topK);
+    uint32_t entry = entry_;
+    for (int l = maxLevel_; l > 0; l--) {
+        entry = greedy(probe, entry, l);
+    }
+    std::vector<Candidate> found = searchLayer(probe, entry, ef, 0);
+    for (const Candidate &candidate : found) {
+        if (static_cast<int>(results.size()) >= topK) {
+            break;
+        }
+        results.push_back({labels_[candidate.second], 1.0f - candidate.first});
+    }
+    return results;
+}
+
+size_t FrHnswIndex::memoryBytes() const {
+    size_t bytes = links0_.capacity() * sizeof(uint32_t)
+                + labels_.capacity() * sizeof(uint32_t)
+                + levels_.capacity() * sizeof(int)
+                + deleted_.capacity()
+                + upperLinks_.capacity() * sizeof(std::vector<uint32_t>)
+                + linkedFrom_.capacity()
+                    * sizeof(std::vector<std::vector<uint32_t>>)
+                + freeNodes_.capacity() * sizeof(uint32_t)
+                + nodeOf_.size() * (sizeof(std::pair<uint32_t, uint32_t>)
+                                    + 2 * sizeof(void*));
+    for (const auto &links : upperLinks_) {
+        bytes += links.capacity() * sizeof(uint32_t);
+    }
+    for (const auto &levels : linkedFrom_) {
+        bytes += levels.capacity() * sizeof(std::vector<uint32_t>);
+        for (const auto &from : levels) {
+            bytes += from.capacity() * sizeof(uint32_t);
+        }
+    }
+    return bytes;
+}
+
+std::string FrHnswIndex::describe() const {
+    std::ostringstream os;
+    os << "hnsw M=" << M_ << " efConstruction=" << efConstruction_
+        << " efSearch=" << efSearch_;
+    return os.str();
+}
+
+/**************************************************************************
+ * FrIvfPqIndex
+ **************************************************************************/
+
+FrIvfPqIndex::FrIvfPqIndex(const FrVectorStore *store,
+                            const FrIvfPqParams &params)
+        : store_(store), params_(sanitize(params)),
+        subDim_(HIAR_FACE_FEATURE_LEN / validSubvectors(params.subvectors)) {
+}
+
+void FrIvfPqIndex::add(uint32_t label) {
+    changes_++;
+    if (trained_) {
+        encode(label);
+        return;
+    }
+    pending_.push_back(label);
+}
+
+void FrIvfPqIndex::remove(uint32_t label) {
+    changes_++;
+    if (!trained_) {
+        auto found = std::find(pending_.begin(), pending_.end(), label);
+        if (pending_.end() != found) {
+            *found = pending_.back();
+            pending_.pop_back();
+        }
+        return;
+    }
+    auto found = where_.find(label);
+    if (where_.end() == found) {
+        return;
+    }
+    InvertedList &list = lists_[found->second.first];
+    uint32_t pos = found->second.second;
+    uint32_t last = static_cast<uint32_t>(list.labels.size() - 1);
+    if (pos != last) {
+        list.labels[pos] = list.labels[last];
+        std::copy(list.codes.begin() + static_cast<size_t>(last)
+                                        * params_.subvectors,
+                list.codes.begin() + static_cast<size_t>(last + 1)
+                                        * params_.subvectors,
+                list.codes.begin() + static_cast<size_t>(pos)
+                                        * params_.subvectors);
+        where_[list.labels[pos]].second = pos;
+    }
+    list.labels.pop_back();
+    list.codes.resize(list.codes.size() - params_.subvectors);
+    where_.erase(found);
+}
+
+/**
+ * Quantizers trained on a copy of the faces, at most nlist * trainPerList
+ * of them, then the whole copy is encoded with them, all without the index.
+ */
+class FrIvfPqIndex::Trainer final : public FrAnnTrainer {
+    public:
+        Trainer(const FrIvfPqIndex *owner, const FrIvfPqParams &params,
+                int subDim)
+                : owner(owner), params(params), subDim(subDim) {}
+
+        void run() override {
+            std::mt19937 rng(params.seed);
+            size_t n = std::min(labels.size(),
+                                static_cast<size_t>(params.nlist)
+                                * params.trainPerList);
+            std::vector<int> assign;
+            kmeans(data.data(), n, HIAR_FACE_FEATURE_LEN, params.nlist,
+                    params.trainIters, rng, &centroids, &assign);
+
+            // Sub-quantizers are trained on the residuals, one subvector
+            // at a time.
+            std::vector<float> sub(n * subDim);
+            codebooks.assign(static_cast<size_t>(params.subvectors)
+                                * kCodebook * subDim, 0.0f);
+            for (int j = 0; j < params.subvectors; j++) {
+                for (size_t i = 0; i < n; i++) {
+                    const float *vec = &data[i * HIAR_FACE_FEATURE_LEN
+                                            + j * subDim];
+                    const float *centroid = &centroids[
+                                    static_cast<size_t>(assign[i])
+                                    * HIAR_FACE_FEATURE_LEN + j * subDim];
+                    for (int d = 0; d < subDim; d++) {
+                        sub[i * subDim + d] = vec[d] - centroid[d];
+                    }
+                }
+                std::vector<float> codebook;
+                kmeans(sub.data(), n, subDim, kCodebook, params.trainIters,
+                        rng, &codebook, nullptr);
+                std::copy(codebook.begin(), codebook.end(),
+                            codebooks.begin() + static_cast<size_t>(j)
+                                                * kCodebook * subDim);
+            }
+
+            n = labels.size();
+            lists.resize(n);
+            codes.resize(n * params.subvectors);
+            for (size_t i = 0; i < n; i++) {
+                const float *vec = &data[i * HIAR_FACE_FEATURE_LEN];
+                lists[i] = nearestRow(vec, centroids.data(), params.nlist,
+                                        HIAR_FACE_FEATURE_LEN);
+                pqEncode(vec, &centroids[static_cast<size_t>(lists[i])
+                                        * HIAR_FACE_FEATURE_LEN],
+                        codebooks.data(), params.subvectors, subDim,
+                        &codes[i * params.subvectors]);
+            }
+            std::vector<float>().swap(data);
+        }
+
+        const FrIvfPqIndex *owner;
+        const FrIvfPqParams params;
+        const int subDim;
+        /// Changes of the index counted when copied.
+        size_t changes = 0;
+        /// Faces of the copy, and their HIAR_FACE_FEATURE_LEN floats each.
+        std::vector<uint32_t> labels;
+        std::vector<float> data;
+        /// Results of run().
+        std::vector<float> centroids;
+        std::vector<float> codebooks;
+        std::vector<int> lists;
+        std::vector<uint8_t> codes;
+};
+
+std::unique_ptr<FrAnnTrainer> FrIvfPqIndex::startTraining() const {
+    bool due = trained_
+        ? 0 < params_.retrain
+            && changes_ >= params_.retrain * trainedFaces_
+            && where_.size() >= static_cast<size_t>(params_.nlist)
+                                * params_.trainPerList
+        : pending_.size() >= static_cast<size_t>(params_.nlist)
+                                * params_.trainPerList;
+    if (!due || training_.exchange(true)) {
+        return nullptr;
+    }
+    std::unique_ptr<Trainer> trainer(new Trainer(this, params_, subDim_));
+    trainer->changes = changes_;
+    if (trained_) {
+        for (const auto &entry : where_) {
+            trainer->labels.push_back(entry.first);
+        }
+    } else {
+        trainer->labels = pending_;
+    }
+    trainer->data.resize(trainer->labels.size() * HIAR_FACE_FEATURE_LEN);
+    for (size_t i = 0; i < trainer->labels.size(); i++) {
+        const float *vec = store_->vectorOf(trainer->labels[i]);
+        std::copy(vec, vec + HIAR_FACE_FEATURE_LEN,
+                    trainer->data.begin() + i * HIAR_FACE_FEATURE_LEN);
+    }
+    return std::unique_ptr<FrAnnTrainer>(trainer.release());
+}
+
+void FrIvfPqIndex::finishTraining(std::unique_ptr<FrAnnTrainer> trainer) {
+    Trainer *done = static_cast<Trainer*>(trainer.get());
+    if (this != done->owner) {
+        return;
+    }
+    std::vector<uint32_t> current;
+    if (trained_) {
+        for (const auto &entry : where_) {
+            current.push_back(entry.first);
+        }
+    } else {
+        current.swap(pending_);
+    }
+    centroids_.swap(done->centroids);
+    codebooks_.swap(done->codebooks);
+    lists_.assign(params_.nlist, InvertedList());
+    where_.clear();
+    trained_ = true;
+    training_ = false;
+    trainedFaces_ = done->labels.size();
+    changes_ -= done->changes;
+
+    // Faces removed since the copy are no longer indexed, faces added
+    // since were not copied and get encoded now.
+    std::unordered_set<uint32_t> waiting(current.begin(), current.end());
+    for (size_t i = 0; i < done->labels.size(); i++) {
+        if (0 != waiting.erase(done->labels[i])) {
+            append(done->labels[i], done->lists[i],
+                    &done->codes[i * params_.subvectors]);
+        }
+    }
+    for (uint32_t label : current) {
+        if (0 != waiting.count(label)) {
+            encode(label);
+        }
+    }
+    std::vector<uint32_t>().swap(pending_);
+}
+
+int FrIvfPqIndex::nearestCentroid(const float *feature) const {
+    return nearestRow(feature, centroids_.data(), params_.nlist,
+                        HIAR_FACE_FEATURE_LEN);
+}
+
+void FrIvfPqIndex::encode(uint32_t label) {
+    const float *vec = store_->vectorOf(label);
+    int c = nearestCentroid(vec);
+    std::vector<uint8_t> code(params_.subvectors);
+    pqEncode(vec, &centroids_[static_cast<size_t>(c) * HIAR_FACE_FEATURE_LEN],
+            codebooks_.data(), params_.subvectors, subDim_, code.data());
+    append(label, c, code.data());
+}
+
+void FrIvfPqIndex::append(uint32_t label, int list, const uint8_t *code) {
+    InvertedList &inverted = lists_[list];
+    where_[label] = std::make_pair(static_cast<uint32_t>(list),
+                        static_cast<uint32_t>(inverted.labels.size()));
+    inverted.labels.push_back(label);
+    inverted.codes.insert(inverted.codes.end(), code,
+                            code + params_.subvectors);
+}
+
+std::vector<FrAnnResult> FrIvfPqIndex::search(const float *probe, int topK,
+                                            int effort) const {
+    std::vector<FrAnnResult> results;
+    if (!trained_ || 0 >= topK) {
+        return results;
+    }
+    int nprobe = std::min(0 < effort ? effort : params_.nprobe, params_.nlist);
+
+    // Lists whose centroid is the closest to the probe.
+    std::vector<std::pair<float, int>> coarse(params_.nlist);
+    for (int c = 0; c < params_.nlist; c++) {
+        coarse[c] = std::make_pair(frSquaredL2(probe,
+                                &centroids_[static_cast<size_t>(c)
+                                            * HIAR_FACE_FEATURE_LEN],
+                                HIAR_FACE_FEATURE_LEN), c);
+    }
+    std::partial_sort(coarse.begin(), coarse.begin() + nprobe, coarse.end());
+
+    // probe . residual ~ sum over subvectors of probe_j . codebook_j[code_j],
+    // the table is shared by all lists since residuals share the codebooks.
+    std::vector<float> table(static_cast<size_t>(params_.subvectors)
+                                * kCodebook);
+    for (int j = 0; j < params_.subvectors; j++) {
+        const float *codebook = &codebooks_[static_cast<size_t>(j)
+                                            * kCodebook * subDim_];
+        for (int k = 0; k < kCodebook; k++) {
+            table[j * kCodebook + k] = frDotProduct(probe + j * subDim_,
+                                        codebook + k * subDim_, subDim_);
+        }
+    }
+
+    size_t keep = static_cast<size_t>(topK)
+                    * (0 < params_.refine ? params_.refine : 1);
+    typedef std::pair<float, uint32_t> Scored;
+    // Worst kept candidate on top.
+    std::priority_queue<Scored, std::vector<Scored>,
+                        std::greater<Scored>> best;
+    for (int p = 0; p < nprobe; p++) {
+        int c = coarse[p].second;
+        const InvertedList &list = lists_[c];
+        float base = frDotProduct(probe, &centroids_[static_cast<size_t>(c)
+                                    * HIAR_FACE_FEATURE_LEN],
+                                HIAR_FACE_FEATURE_LEN);
+        const uint8_t *code = list.codes.data();
+        for (size_t i = 0; i < list.labels.size(); i++) {
+            float score = base;
+            for (int j = 0; j < params_.subvectors; j++) {
+                score += table[j * kCodebook + code[j]];
+            }
+            code += params_.subvectors;
+            if (best.size() < keep) {
+                best.push(Scored(score, list.labels[i]));
+            } else if (score > best.top().first) {
+                best.pop();
+                best.push(Scored(score, list.labels[i]));
+            }
+        }
+    }
+
+    std::vector<Scored> found;
+    while (!best.empty()) {
+        Scored scored = best.top();
+        if (0 < params_.refine) {
+            // Exact score from the floats of the store.
+            scored.first = frDotProduct(probe, store_->vectorOf(scored.second),
+                                        HIAR_FACE_FEATURE_LEN);
+        }
+        found.push_back(scored);
+        best.pop();
+    }
+    std::sort(found.begin(), found.end(), std::greater<Scored>());
+    for (size_t i = 0; i < found.size()
+                        && static_cast<int>(i) < topK; i++) {
+        results.push_back({found[i].second, found[i].first});
+    }
+    return results;
+}
+
+size_t FrIvfPqIndex::memoryBytes() const {
+    size_t bytes = centroids_.capacity() * sizeof(float)
+                + codebooks_.capacity() * sizeof(float)
+                + pending_.capacity() * sizeof(uint32_t)
+                + where_.size() * (sizeof(std::pair<uint32_t,
+                                    std::pair<uint32_t, uint32_t>>)
+                                    + 2 * sizeof(void*));
+    for (const InvertedList &list : lists_) {
+        bytes += list.labels.capacity() * sizeof(uint32_t)
+                + list.codes.capacity();
+    }
+    return bytes;
+}
+
+std::string FrIvfPqIndex::describe() const {
+    std::ostringstream os;
+    os << "ivfpq nlist=" << params_.nlist << " nprobe=" << params_.nprobe
+        << " subvectors=" << params_.subvectors
+        << " refine=" << params_.refine
+        << (training_ ? trained_ ? " (retraining)" : " (training)"
+                    : trained_ ? "" : " (untrained)");
+    return os.str();
+}
+
+std::unique_ptr<FrAnnIndex> frCreateAnnIndex(const std::string &type,
+                                        const FrVectorStore *store,
+                                        const FrHnswParams &hnsw,
+                                        const FrIvfPqParams &ivfpq) {
+    std::unique_ptr<FrAnnIndex> index;
+    if ("hnsw" == type) {
+        index.reset(new FrHnswIndex(store, hnsw));
+    } else if ("ivfpq" == type) {
+        index.reset(new FrIvfPqIndex(store, ivfpq));
+    }
+    return index;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Protobuf arenas of one rpc, on blocks reused by each thread.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_arena.h"
+
+#include <vector>
+
+namespace {
+
+/// Blocks kept by a thread, enough for the rpcs it has in flight.
+const size_t kCachedBlocks = 16;
+
+/// Blocks free for the arenas of this thread.
+struct BlockCache {
+    std::vector<std::unique_ptr<char[]>> blocks;
+};
+
+thread_local BlockCache blockCache;
+
+std::unique_ptr<char[]> takeBlock() {
+    std::vector<std::unique_ptr<char[]>> &blocks = blockCache.blocks;
+    if (blocks.empty()) {
+        return std::unique_ptr<char[]>(new char[FrCallArena::kBlockBytes]);
+    }
+    std::unique_ptr<char[]> block = std::move(blocks.back());
+    blocks.pop_back();
+    return block;
+}
+
+google::protobuf::ArenaOptions optionsOf(char *block) {
+    google::protobuf::ArenaOptions options;
+    options.initial_block = block;
+    options.initial_block_size = FrCallArena::kBlockBytes;
+    // Past the block, a large reply grows in large steps.
+    options.start_block_size = FrCallArena::kBlockBytes;
+    options.max_block_size = FrCallArena::kBlockBytes * 4;
+    return options;
+}
+
+} // namespace
+
+FrCallArena::FrCallArena()
+        : block_(takeBlock()), arena_(optionsOf(block_.get())) {
+}
+
+FrCallArena::~FrCallArena() {
+    // Cached before the arena is destroyed, which is fine: no other arena
+    // of this thread can take it in between.
+    if (blockCache.blocks.size() < kCachedBlocks) {
+        blockCache.blocks.push_back(std::move(block_));
+    }
+}
@@ -0,0 +1,193 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Pipelined client keeping many unary rpcs in flight.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_async_client.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "fr_arena.h"
+
+using grpc::ClientContext;
+using grpc::Status;
+
+using facerecg::Frecg;
+
+namespace {
+/// Client whose callback runs on this thread, if any.
+thread_local const FrAsyncClient *tCallbackOf = nullptr;
+/// Whether that callback may still take the slot of its finished rpc.
+thread_local bool tSlotHanded = false;
+} // namespace
+
+/// Rpc in flight, the tag of its completion.
+struct FrAsyncClient::Call {
+    virtual ~Call() {}
+    /// Run the callback of the finished rpc.
+    virtual void complete() = 0;
+
+    ClientContext context;
+    Status status;
+};
+
+template <class Request, class Reply>
+struct FrAsyncClient::UnaryCall : public FrAsyncClient::Call {
+    void complete() override {
+        done(status, *reply);
+    }
+
+    FrCallArena arena;
+    Reply *reply = arena.create<Reply>();
+    Callback<Reply> done;
+    std::unique_ptr<grpc::ClientAsyncResponseReader<Reply>> reader;
+};
+
+FrAsyncClient::FrAsyncClient(const std::string &target, int channels,
+                            int window)
+        : window_(window) {
+    if (0 >= window) {
+        throw std::invalid_argument("FrAsyncClient: window must be positive");
+    }
+    channels = std::max(1, channels);
+    for (int i = 0; i < channels; i++) {
+        // Distinct arguments keep gRPC from sharing one connection.
+        grpc::ChannelArguments args;
+        args.SetInt("fr_async_channel", i);
+        stubs_.push_back(Frecg::NewStub(grpc::CreateCustomChannel(
+                            target, grpc::InsecureChannelCredentials(),
+                            args)));
+        pollers_.emplace_back(&FrAsyncClient::poll, this);
+    }
+}
+
+FrAsyncClient::~FrAsyncClient() {
+    drain();
+    cq_.Shutdown();
+    for (auto &poller : pollers_) {
+        poller.join();
+    }
+}
+
+template <class Request, class Reply>
+void FrAsyncClient::start(Prepare<Request, Reply> prepare,
+                        const Request &request, Callback<Reply> done) {
+    Frecg::Stub *stub;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (this == tCallbackOf) {
+            // Waiting on a poller could wait forever: take the slot of the
+            // finished rpc, further rpcs go past the window for a while.
+            if (tSlotHanded) {
+                tSlotHanded = false;
+            } else {
+                inFlight_++;
+            }
+        } else {
+            cv_.wait(lock, [this]() { return inFlight_ < window_; });
+            inFlight_++;
+        }
+        pending_++;
+        stub = stubs_[nextStub_++ % stubs_.size()].get();
+    }
+    UnaryCall<Request, Reply> *call = new UnaryCall<Request, Reply>;
+    call->done = std::move(done);
+    // The request is serialized here, the caller may reuse it right away.
+    call->reader = (stub->*prepare)(&call->context, request, &cq_);
+    call->reader->StartCall();
+    call->reader->Finish(call->reply, &call->status, call);
+}
+
+template <class Request, class Reply>
+std::future<Reply> FrAsyncClient::startFuture(Prepare<Request, Reply> prepare,
+                                            const Request &request) {
+    std::shared_ptr<std::promise<Reply>> promise(new std::promise<Reply>);
+    start<Request, Reply>(prepare, request,
+                        [promise](const Status &status, Reply &reply) {
+        if (status.ok()) {
+            promise->set_value(std::move(reply));
+        } else {
+            promise->set_exception(std::make_exception_ptr(
+                std::runtime_error(std::to_string(status.error_code())
+                                    + ": " + status.error_message())));
+        }
+    });
+    return promise->get_future();
+}
+
+void FrAsyncClient::poll() {
+    void *tag;
+    bool ok;
+    while (cq_.Next(&tag, &ok)) {
+        // Finish always completes, ok or not, with the status set.
+        Call *call = static_cast<Call*>(tag);
+        // The callback keeps the slot, for an rpc it starts, before any
+        // waiter may take it.
+        tCallbackOf = this;
+        tSlotHanded = true;
+        call->complete();
+        tCallbackOf = nullptr;
+        delete call;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (tSlotHanded) {
+                inFlight_--;
+            }
+            pending_--;
+        }
+        tSlotHanded = false;
+        cv_.notify_all();
+    }
+}
+
+void FrAsyncClient::drain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return 0 == pending_; });
+}
+
+void FrAsyncClient::featureDetect(const facerecg::DetectRequest &request,
+                                Callback<facerecg::FeatureReply> done) {
+    start(&Frecg::Stub::PrepareAsyncfeatureDetect, request, std::move(done));
+}
+
+void FrAsyncClient::featureExtract(const facerecg::FeatureRequest &request,
+                                Callback<facerecg::FeatureReply> done) {
+    start(&Frecg::Stub::PrepareAsyncfeatureExtract, request, std::move(done));
+}
+
+void FrAsyncClient::getFaceQuality(const facerecg::QualityRequest &request,
+                                Callback<facerecg::QualityReply> done) {
+    start(&Frecg::Stub::PrepareAsyncgetFaceQuality, request, std::move(done));
+}
+
+std::future<facerecg::FeatureReply> FrAsyncClient::featureDetect(
+                                const facerecg::DetectRequest &request) {
+    return startFuture(&Frecg::Stub::PrepareAsyncfeatureDetect, request);
+}
+
+std::future<facerecg::FeatureReply> FrAsyncClient::featureExtract(
+                                const facerecg::FeatureRequest &request) {
+    return startFuture(&Frecg::Stub::PrepareAsyncfeatureExtract, request);
+}
+
+std::future<facerecg::QualityReply> FrAsyncClient::getFaceQuality(
+                                const facerecg::QualityRequest &request) {
+    return startFuture(&Frecg::Stub::PrepareAsyncgetFaceQuality, request);
+}
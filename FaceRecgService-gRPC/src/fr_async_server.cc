@@ -0,0 +1,282 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Completion-queue based asynchronous mode of the Frecg service.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_async_server.h"
+
+#include <iostream>
+
+#include "fr_arena.h"
+
+using grpc::CompletionQueue;
+using grpc::ServerAsyncResponseWriter;
+using grpc::ServerCompletionQueue;
+using grpc::ServerContext;
+using grpc::Status;
+
+using facerecg::Frecg;
+
+namespace {
+
+/**
+ * @brief Tag put on the completion queue, one per rpc in flight.
+ */
+class FrCallBase {
+    public:
+        virtual ~FrCallBase() {}
+        /**
+         * @brief			Advance the state machine of the call.
+         * @param[in] ok 	Result of the completed operation.
+         * @return			Void.
+         */
+        virtual void proceed(bool ok) = 0;
+};
+
+/**
+ * @brief State machine of one unary rpc.
+ *        Created -> Processing (handled by the sync logic) -> Finished.
+ */
+template <class Request, class Reply>
+class FrUnaryCall final : public FrCallBase {
+    public:
+        /// FrAsyncService::Request##method of the generated code.
+        typedef void (FrAsyncService::*RequestMethod)(ServerContext*,
+                            Request*, ServerAsyncResponseWriter<Reply>*,
+                            CompletionQueue*, ServerCompletionQueue*, void*);
+        /// Frecg::Service::method of the generated code.
+        typedef Status (Frecg::Service::*HandleMethod)(ServerContext*,
+                            const Request*, Reply*);
+
+        /**
+         * @brief                   Arm a new call waiting for a client.
+         * @param[in] server        Server running the handler.
+         * @param[in] service       Registered async service.
+         * @param[in] cq            Completion queue owning the call.
+         * @param[in] logic         Implementation to delegate to.
+         * @param[in] requestFn     Method used to accept the rpc.
+         * @param[in] handleFn      Method used to serve the rpc.
+         * @return                  Void, the call deletes itself.
+         */
+        static void spawn(FrAsyncServer *server, FrAsyncService *service,
+                        ServerCompletionQueue *cq, Frecg::Service *logic,
+                        RequestMethod requestFn, HandleMethod handleFn) {
+            new FrUnaryCall(server, service, cq, logic, requestFn, handleFn);
+        }
+
+        void proceed(bool ok) override {
+            if (PROCESS == status_) {
+                if (!ok) {
+                    // Server is shutting down, nothing was received.
+                    delete this;
+                    return;
+                }
+                // Arm the next call before serving this one,
+                // so that another poller can accept in the meantime.
+                spawn(server_, service_, cq_, logic_, requestFn_, handleFn_);
+                status_ = FINISH;
+                server_->dispatch([this]() {
+                    Status status = (logic_->*handleFn_)(&ctx_, request_,
+                                                        reply_);
+                    responder_.Finish(*reply_, status, this);
+                });
+            } else {
+                delete this;
+            }
+        }
+
+    private:
+        enum CallStatus { PROCESS, FINISH };
+
+        FrUnaryCall(FrAsyncServer *server, FrAsyncService *service,
+                    ServerCompletionQueue *cq, Frecg::Service *logic,
+                    RequestMethod requestFn, HandleMethod handleFn)
+                : server_(server), service_(service), cq_(cq), logic_(logic),
+                requestFn_(requestFn), handleFn_(handleFn),
+                request_(arena_.create<Request>()),
+                reply_(arena_.create<Reply>()),
+                responder_(&ctx_), status_(PROCESS) {
+            (service_->*requestFn_)(&ctx_, request_, &responder_,
+                                    cq_, cq_, this);
+        }
+
+        FrAsyncServer *server_;
+        FrAsyncService *service_;
+        ServerCompletionQueue *cq_;
+        Frecg::Service *logic_;
+        RequestMethod requestFn_;
+        HandleMethod handleFn_;
+
+        ServerContext ctx_;
+        /// Owns the request and reply, freed with the call.
+        FrCallArena arena_;
+        Request *request_;
+        Reply *reply_;
+        ServerAsyncResponseWriter<Reply> responder_;
+        CallStatus status_;
+};
+
+/**
+ * @brief			    Arm every rpc of the service once on a queue.
+ * @param[in] server    Server running the handlers.
+ * @param[in] service   Registered async service.
+ * @param[in] cq        Completion queue.
+ * @param[in] logic     Implementation to delegate to.
+ * @return			    Void.
+ */
+void spawnAll(FrAsyncServer *server, FrAsyncService *service,
+                ServerCompletionQueue *cq, Frecg::Service *logic) {
+    FrUnaryCall<facerecg::LogRequest, facerecg::LogReply>::spawn(
+                server, service, cq, logic,
+                &FrAsyncService::RequestlogIn, &Frecg::Service::logIn);
+    FrUnaryCall<facerecg::FeatureRequest, facerecg::FeatureReply>::spawn(
+                server, service, cq, logic,
+                &FrAsyncService::RequestfeatureExtract,
+                &Frecg::Service::featureExtract);
+    FrUnaryCall<facerecg::DetectRequest, facerecg::FeatureReply>::spawn(
+                server, service, cq, logic,
+                &FrAsyncService::RequestfeatureDetect,
+                &Frecg::Service::featureDetect);
+    FrUnaryCall<facerecg::CmpFeatureRequest, facerecg::CmpFeatureReply>::spawn(
+                server, service, cq, logic,
+                &FrAsyncService::RequestcompareFeature,
+                &Frecg::Service::compareFeature);
+    FrUnaryCall<facerecg::CmpImageRequest, facerecg::CmpImageReply>::spawn(
+                server, service, cq, logic,
+                &FrAsyncService::RequestcompareImage,
+                &Frecg::Service::compareImage);
+    FrUnaryCall<facerecg::QualityRequest, facerecg::QualityReply>::spawn(
+                server, service, cq, logic,
+                &FrAsyncService::RequestgetFaceQuality,
+                &Frecg::Service::getFaceQuality);
+    FrUnaryCall<facerecg::EnrollRequest, facerecg::EnrollReply>::spawn(
+                server, service, cq, logic,
+                &FrAsyncService::Requestenroll, &Frecg::Service::enroll);
+    FrUnaryCall<facerecg::RemoveRequest, facerecg::RemoveReply>::spawn(
+                server, service, cq, logic,
+                &FrAsyncService::Requestremove, &Frecg::Service::remove);
+    FrUnaryCall<facerecg::IdentifyRequest, facerecg::IdentifyReply>::spawn(
+                server, service, cq, logic,
+                &FrAsyncService::Requestidentify, &Frecg::Service::identify);
+    FrUnaryCall<facerecg::StatsRequest, facerecg::StatsReply>::spawn(
+                server, service, cq, logic,
+                &FrAsyncService::RequestgetStats, &Frecg::Service::getStats);
+    FrUnaryCall<facerecg::CmpBatchRequest, facerecg::CmpBatchReply>::spawn(
+                server, service, cq, logic,
+                &FrAsyncService::RequestcompareBatch,
+                &Frecg::Service::compareBatch);
+}
+
+} // namespace
+
+FrAsyncServer::FrAsyncServer(Frecg::Service *logic,
+                            int numCqs, int pollersPerCq, int handlers)
+        : logic_(logic), service_(logic),
+        numCqs_(numCqs), pollersPerCq_(pollersPerCq) {
+    if (0 >= numCqs_) {
+        numCqs_ = static_cast<int>(std::thread::hardware_concurrency());
+        numCqs_ = 0 < numCqs_ ? numCqs_ : 1;
+    }
+    if (0 >= pollersPerCq_) {
+        pollersPerCq_ = 1;
+    }
+    if (0 <= handlers) {
+        handlers_.reset(new FrThreadPool(handlers));
+    }
+}
+
+FrAsyncServer::~FrAsyncServer() {
+    stop();
+}
+
+void FrAsyncServer::attach(grpc::ServerBuilder &builder) {
+    builder.RegisterService(&service_);
+    for (int i = 0; i < numCqs_; i++) {
+        cqs_.emplace_back(builder.AddCompletionQueue());
+    }
+}
+
+void FrAsyncServer::start() {
+    for (auto &cq : cqs_) {
+        // One armed call per poller, so that every poller may accept.
+        for (int i = 0; i < pollersPerCq_; i++) {
+            spawnAll(this, &service_, cq.get(), logic_);
+        }
+        for (int i = 0; i < pollersPerCq_; i++) {
+            pollers_.emplace_back(&FrAsyncServer::poll, this, cq.get());
+        }
+    }
+    started_ = true;
+    std::cout << "Async mode: " << numCqs_ << " completion queues x "
+                << pollersPerCq_ << " pollers, ";
+    if (handlers_) {
+        std::cout << handlers_->size() << " handler threads" << std::endl;
+    } else {
+        std::cout << "handlers on the pollers" << std::endl;
+    }
+}
+
+void FrAsyncServer::dispatch(std::function<void()> handler) {
+    {
+        std::lock_guard<std::mutex> lock(handlersMutex_);
+        if (handlers_) {
+            handlers_->submit(handler);
+            return;
+        }
+    }
+    handler();
+}
+
+void FrAsyncServer::stop() {
+    if (cqs_.empty()) {
+        return;
+    }
+    // Handlers finish their rpcs on the queues, which must still be up.
+    std::unique_ptr<FrThreadPool> handlers;
+    {
+        std::lock_guard<std::mutex> lock(handlersMutex_);
+        handlers.swap(handlers_);
+    }
+    handlers.reset();
+    for (auto &cq : cqs_) {
+        cq->Shutdown();
+    }
+    if (started_) {
+        for (auto &poller : pollers_) {
+            poller.join();
+        }
+    } else {
+        // Never started: drain here, the queues must be empty when destroyed.
+        for (auto &cq : cqs_) {
+            poll(cq.get());
+        }
+    }
+    started_ = false;
+    pollers_.clear();
+    cqs_.clear();
+}
+
+void FrAsyncServer::poll(ServerCompletionQueue *cq) {
+    void *tag = nullptr;
+    bool ok = false;
+    // Next() returns false once the queue is shut down and drained.
+    while (cq->Next(&tag, &ok)) {
+        static_cast<FrCallBase*>(tag)->proceed(ok);
+    }
+}
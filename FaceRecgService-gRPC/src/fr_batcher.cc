@@ -0,0 +1,237 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Dynamic batching of feature extraction across concurrent rpcs.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_batcher.h"
+
+#include <cstring>
+
+#include "interface_face_recognizer.h"
+
+FrExtractBatcher::FrExtractBatcher(int maxBatch, int maxWaitUs, int workers,
+                                    Executor executor)
+        : maxBatch_(0 < maxBatch ? maxBatch : 1),
+        maxWait_(0 < maxWaitUs ? maxWaitUs : 0),
+        executor_(executor) {
+    workers = 0 < workers ? workers : 1;
+    for (int i = 0; i < workers; i++) {
+        workers_.emplace_back(&FrExtractBatcher::run, this);
+    }
+}
+
+FrExtractBatcher::~FrExtractBatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    pending_.notify_all();
+    for (auto &worker : workers_) {
+        worker.join();
+    }
+}
+
+int FrExtractBatcher::extract(const unsigned char *imgData, const int lenImg,
+                            const int *faceBboxes, const int numBbox,
+                            float **feature, int *lenFeatures) {
+    FrExtractJob job;
+    job.imgData = imgData;
+    job.lenImg = lenImg;
+    job.faceBboxes = faceBboxes;
+    job.numBbox = numBbox;
+    job.enqueued = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopping_) {
+        lock.unlock();
+        std::vector<FrExtractJob*> alone(1, &job);
+        executor_(alone);
+        *feature = job.feature;
+        *lenFeatures = job.lenFeatures;
+        return job.ret;
+    }
+    queue_.push_back(&job);
+    queuedFaces_ += numBbox;
+    if (queuedFaces_ >= maxBatch_) {
+        pending_.notify_all();
+    } else {
+        pending_.notify_one();
+    }
+    finished_.wait(lock, [&job]() { return job.done; });
+    lock.unlock();
+
+    *feature = job.feature;
+    *lenFeatures = job.lenFeatures;
+    return job.ret;
+}
+
+void FrExtractBatcher::dump(std::ostream &os) const {
+    batchSizes_.dump(os, "Extract batch size", "");
+    queueDelays_.dump(os, "Extract queueing delay", "us");
+}
+
+void FrExtractBatcher::exposition(std::ostream &os) const {
+    // Faces are counted, not timed: powers of two up to maxBatch as
+    // bounds, a bound splitting a bucket counts it in the next one.
+    os << "# HELP fr_batch_faces Faces per extraction batch.\n"
+        << "# TYPE fr_batch_faces histogram\n";
+    uint64_t cumulative = 0;
+    int idx = 0;
+    for (uint64_t bound = 1; ; bound *= 2) {
+        for (; idx < FrHistogram::kBuckets
+                && FrHistogram::bucketUpper(idx) <= bound; idx++) {
+            cumulative += batchSizes_.bucketCount(idx);
+        }
+        os << "fr_batch_faces_bucket{le=\"" << bound << "\"} " << cumulative
+            << '\n';
+        if (bound >= static_cast<uint64_t>(maxBatch_)) {
+            break;
+        }
+    }
+    for (; idx < FrHistogram::kBuckets; idx++) {
+        cumulative += batchSizes_.bucketCount(idx);
+    }
+    os << "fr_batch_faces_bucket{le=\"+Inf\"} " << cumulative << '\n'
+        << "fr_batch_faces_sum " << batchSizes_.sum() << '\n'
+        << "fr_batch_faces_count " << cumulative << '\n';
+    os << "# HELP fr_batch_queue_seconds Time extraction jobs waited for"
+        << " their batch to run.\n"
+        << "# TYPE fr_batch_queue_seconds histogram\n";
+    queueDelays_.prometheus(os, "fr_batch_queue_seconds",
+                            "stage=\"extract\"");
+}
+
+void FrExtractBatcher::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (queue_.empty()) {
+            if (stopping_) {
+                return;
+            }
+            pending_.wait(lock);
+            continue;
+        }
+        // Let the batch fill up to the deadline of its oldest job.
+        auto now = std::chrono::steady_clock::now();
+        auto deadline = queue_.front()->enqueued + maxWait_;
+        if (!stopping_ && queuedFaces_ < maxBatch_ && now < deadline) {
+            pending_.wait_until(lock, deadline);
+            continue;
+        }
+
+        std::vector<FrExtractJob*> batch;
+        int faces = 0;
+        while (!queue_.empty() && (batch.empty()
+                    || faces + queue_.front()->numBbox <= maxBatch_)) {
+            faces += queue_.front()->numBbox;
+            batch.push_back(queue_.front());
+            queue_.pop_front();
+        }
+        queuedFaces_ -= faces;
+        lock.unlock();
+
+        batchSizes_.record(faces);
+        for (auto job : batch) {
+            queueDelays_.record(std::chrono::duration_cast<
+                                std::chrono::microseconds>(
+                                now - job->enqueued).count());
+        }
+        executor_(batch);
+
+        lock.lock();
+        for (auto job : batch) {
+            job->done = true;
+        }
+        finished_.notify_all();
+    }
+}
+
+void FrExtractBatcher::defaultExecutor(std::vector<FrExtractJob*> &batch) {
+    runGrouped(batch, HiarFace_extractFeature);
+}
+
+FrExtractBatcher::Executor FrExtractBatcher::groupingExecutor(
+                                                    Extractor extractor) {
+    return [extractor](std::vector<FrExtractJob*> &batch) {
+        runGrouped(batch, extractor);
+    };
+}
+
+void FrExtractBatcher::runGrouped(std::vector<FrExtractJob*> &batch,
+                                    const Extractor &extractor) {
+    std::vector<bool> taken(batch.size(), false);
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (taken[i]) {
+            continue;
+        }
+        FrExtractJob *first = batch[i];
+        /**
+         * Gather the jobs sent with the very same image,
+         * e.g. one frame fanned out with different rois.
+         */
+        std::vector<FrExtractJob*> group(1, first);
+        for (size_t j = i + 1; j < batch.size(); j++) {
+            FrExtractJob *other = batch[j];
+            if (!taken[j] && other->lenImg == first->lenImg
+                && (other->imgData == first->imgData
+                    || 0 == memcmp(other->imgData, first->imgData,
+                                    first->lenImg))) {
+                taken[j] = true;
+                group.push_back(other);
+            }
+        }
+
+        if (1 == group.size()) {
+            first->ret = extractor(first->imgData, first->lenImg,
+                                first->faceBboxes, first->numBbox,
+                                &first->feature, &first->lenFeatures);
+            continue;
+        }
+
+        std::vector<int> bboxes;
+        for (auto job : group) {
+            bboxes.insert(bboxes.end(), job->faceBboxes,
+                            job->faceBboxes + 4 * job->numBbox);
+        }
+        float *feature = nullptr;
+        int lenFeatures = 0;
+        int ret = extractor(first->imgData, first->lenImg,
+                            bboxes.data(), static_cast<int>(bboxes.size() / 4),
+                            &feature, &lenFeatures);
+        bool valid = (1 == ret && nullptr != feature && lenFeatures
+                    == static_cast<int>(bboxes.size() / 4) * HIAR_FACE_FEATURE_LEN);
+        int offset = 0;
+        for (auto job : group) {
+            job->ret = valid ? ret : (1 == ret ? 0 : ret);
+            job->lenFeatures = 0;
+            job->feature = nullptr;
+            int len = job->numBbox * HIAR_FACE_FEATURE_LEN;
+            if (valid && 0 < len) {
+                job->feature = new float[len];
+                memcpy(job->feature, feature + offset, len * sizeof(float));
+                job->lenFeatures = len;
+            }
+            offset += len;
+        }
+        if (nullptr != feature) {
+            delete[] feature;
+            feature = nullptr;
+        }
+    }
+}
@@ -0,0 +1,791 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Offline benchmarks of the server's building blocks.
+ * @details	--mode=ann measures recall@k, latency and memory of the
+ *          approximate gallery indexes against the exact ranking given by
+ *          HiarFace_compareFaceFeature.
+ *          --mode=load measures the time from a gallery file on disk to the
+ *          first search served from it.
+ *          --mode=decode measures the image decoding of a request running
+ *          two SDK calls, with and without FrImageContext.
+ *          --mode=raw compares frames sent JPEG encoded or as raw pixels:
+ *          bytes, encoding and decoding time, total over several links.
+ *          --mode=similarity compares compareFeature, one pair per call
+ *          to HiarFace_compareFaceFeature, with the batch kernels of
+ *          compareBatch on each instruction set the CPU runs.
+ *          --mode=encoding measures the packed encodings of features:
+ *          reply bytes, serialize and parse time, and the error they add
+ *          to HiarFace_compareFaceFeature scores.
+ *          --mode=arena measures the messages of a featureExtract rpc,
+ *          parse, reply and serialize, on the heap or on an FrCallArena:
+ *          allocations per rpc, p50 and p99.
+ *          Features are read from --features (raw float32,
+ *          HIAR_FACE_FEATURE_LEN per face) or synthesized as clusters of
+ *          noisy faces, which is closer to real galleries than uniform noise.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/imgcodecs/legacy/constants_c.h>
+
+#include "FaceRecg.pb.h"
+
+#include "interface_face_recognizer.h"
+#include "fr_ann_index.h"
+#include "fr_arena.h"
+#include "fr_feature_codec.h"
+#include "fr_feature_math.h"
+#include "fr_gallery.h"
+#include "fr_gallery_file.h"
+#include "fr_histogram.h"
+#include "fr_image_context.h"
+#include "fr_similarity.h"
+#include "fr_thread_pool.h"
+
+/// Calls of operator new, counted by --mode=arena.
+std::atomic<uint64_t> newCalls(0);
+
+void* operator new(size_t size) {
+    newCalls.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = std::malloc(0 == size ? 1 : size);
+    if (nullptr == ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+/**
+ * Find the value of "--key=value" in arguments, or the default one.
+ */
+std::string getArg(int argc, char** argv, const std::string &key,
+                    const std::string &defVal) {
+    std::string prefix = "--" + key + "=";
+    for (int i = 1; i < argc; i++) {
+        std::string arg_val = argv[i];
+        if (0 == arg_val.compare(0, prefix.size(), prefix)) {
+            return arg_val.substr(prefix.size());
+        }
+    }
+    return defVal;
+}
+
+/// Split "a,b,c" into integers.
+std::vector<int> parseList(const std::string &list) {
+    std::vector<int> values;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            values.push_back(std::stoi(item));
+        }
+    }
+    return values;
+}
+
+/**
+ * @brief			    Load raw features, or synthesize them.
+ * @param[in] path 	    File of float32 features, empty to synthesize.
+ * @param[in] count     Max faces.
+ * @param[in] clusters  Identities of the synthetic faces.
+ * @return			    count x HIAR_FACE_FEATURE_LEN floats.
+ */
+std::vector<float> loadFeatures(const std::string &path, size_t count,
+                                int clusters, uint32_t seed) {
+    std::vector<float> features;
+    if (!path.empty()) {
+        std::ifstream in(path, std::ios::binary);
+        std::vector<float> face(HIAR_FACE_FEATURE_LEN);
+        while (features.size() < count * HIAR_FACE_FEATURE_LEN
+                && in.read(reinterpret_cast<char*>(face.data()),
+                            face.size() * sizeof(float))) {
+            features.insert(features.end(), face.begin(), face.end());
+        }
+        return features;
+    }
+
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> gauss(0, 1);
+    std::vector<float> centers(clusters * HIAR_FACE_FEATURE_LEN);
+    for (auto &value : centers) {
+        value = gauss(rng);
+    }
+    std::uniform_int_distribution<int> pick(0, clusters - 1);
+    features.resize(count * HIAR_FACE_FEATURE_LEN);
+    for (size_t i = 0; i < count; i++) {
+        const float *center = &centers[pick(rng) * HIAR_FACE_FEATURE_LEN];
+        for (int j = 0; j < HIAR_FACE_FEATURE_LEN; j++) {
+            features[i * HIAR_FACE_FEATURE_LEN + j] =
+                                                center[j] + 0.7f * gauss(rng);
+        }
+    }
+    return features;
+}
+
+/// Exact topK ids of probe, scored by the SDK.
+std::vector<std::string> exactTopK(const std::vector<float> &gallery,
+                                    const float *probe, int topK) {
+    size_t count = gallery.size() / HIAR_FACE_FEATURE_LEN;
+    std::vector<std::pair<float, size_t>> scores(count);
+    for (size_t i = 0; i < count; i++) {
+        scores[i].first = HiarFace_compareFaceFeature(
+                            &gallery[i * HIAR_FACE_FEATURE_LEN],
+                            HIAR_FACE_FEATURE_LEN,
+                            probe, HIAR_FACE_FEATURE_LEN);
+        scores[i].second = i;
+    }
+    size_t keep = std::min(count, static_cast<size_t>(topK));
+    std::partial_sort(scores.begin(), scores.begin() + keep, scores.end(),
+                        [](const std::pair<float, size_t> &a,
+                            const std::pair<float, size_t> &b) {
+                            return a.first > b.first;
+                        });
+    std::vector<std::string> ids;
+    for (size_t i = 0; i < keep; i++) {
+        ids.push_back(std::to_string(scores[i].second));
+    }
+    return ids;
+}
+
+/**
+ * @brief			    Search all probes at one effort and print a line.
+ * @param[in] effort    Effort of the index, 0 for exhaustive search.
+ */
+void runSweep(const FrGallery &gallery, const std::vector<float> &probes,
+                const std::vector<std::vector<std::string>> &truth,
+                int topK, int effort) {
+    FrHistogram latency;
+    size_t hits = 0;
+    size_t expected = 0;
+    for (size_t q = 0; q < truth.size(); q++) {
+        const float *probe = &probes[q * HIAR_FACE_FEATURE_LEN];
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<FrMatch> matches = 0 < effort
+                            ? gallery.identify(probe, topK, -1.0f, effort)
+                            : gallery.identifyExact(probe, topK, -1.0f);
+        latency.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - begin).count());
+
+        for (const std::string &id : truth[q]) {
+            for (const FrMatch &match : matches) {
+                if (match.id == id) {
+                    hits++;
+                    break;
+                }
+            }
+        }
+        expected += truth[q].size();
+    }
+    std::cout << "  effort " << effort
+                << "  recall@" << topK << " "
+                << (0 < expected ? static_cast<double>(hits) / expected : 0)
+                << "  p50 " << latency.percentile(0.5) << " us"
+                << "  p99 " << latency.percentile(0.99) << " us" << std::endl;
+}
+
+/**
+ * Recall and latency of the indexes against exhaustive search.
+ */
+int benchAnn(int argc, char** argv) {
+    size_t count = std::stoul(getArg(argc, argv, "count", "100000"));
+    size_t queries = std::stoul(getArg(argc, argv, "queries", "200"));
+    int topK = std::stoi(getArg(argc, argv, "topk", "10"));
+    int clusters = std::stoi(getArg(argc, argv, "clusters", "10000"));
+    std::string path = getArg(argc, argv, "features", "");
+    std::vector<std::string> types;
+    std::stringstream ss(getArg(argc, argv, "index", "hnsw,ivfpq"));
+    std::string type;
+    while (std::getline(ss, type, ',')) {
+        types.push_back(type);
+    }
+
+    FrHnswParams hnsw;
+    hnsw.M = std::stoi(getArg(argc, argv, "hnsw_m", std::to_string(hnsw.M)));
+    hnsw.efConstruction = std::stoi(getArg(argc, argv, "hnsw_ef_construction",
+                                        std::to_string(hnsw.efConstruction)));
+    FrIvfPqParams ivfpq;
+    ivfpq.nlist = std::stoi(getArg(argc, argv, "ivf_nlist",
+                                    std::to_string(ivfpq.nlist)));
+    ivfpq.subvectors = std::stoi(getArg(argc, argv, "pq_m",
+                                    std::to_string(ivfpq.subvectors)));
+    ivfpq.refine = std::stoi(getArg(argc, argv, "ivf_refine",
+                                    std::to_string(ivfpq.refine)));
+
+    std::vector<float> features = loadFeatures(path, count + queries,
+                                                clusters, 100);
+    count = features.size() / HIAR_FACE_FEATURE_LEN;
+    if (count <= queries) {
+        std::cout << "Not enough features!!!" << std::endl;
+        return 1;
+    }
+    count -= queries;
+    // The last faces are the probes, unseen by the gallery.
+    std::vector<float> probes(features.begin()
+                                + count * HIAR_FACE_FEATURE_LEN,
+                            features.end());
+    features.resize(count * HIAR_FACE_FEATURE_LEN);
+    std::cout << count << " faces, " << queries << " probes, top "
+                << topK << std::endl;
+
+    std::vector<std::vector<std::string>> truth(queries);
+    for (size_t q = 0; q < queries; q++) {
+        truth[q] = exactTopK(features, &probes[q * HIAR_FACE_FEATURE_LEN],
+                                topK);
+    }
+
+    FrThreadPool pool(std::stoi(getArg(argc, argv, "gallery_threads", "0")));
+    for (const std::string &name : types) {
+        FrGallery gallery(&pool);
+        // Index while enrolling, as the server does.
+        gallery.setIndex([&](const FrVectorStore *store) {
+            return frCreateAnnIndex(name, store, hnsw, ivfpq);
+        });
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; i++) {
+            gallery.enroll(std::to_string(i),
+                            &features[i * HIAR_FACE_FEATURE_LEN]);
+        }
+        double buildSec = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - begin).count();
+        std::cout << name << ": " << gallery.describeIndex()
+                    << ", built in " << buildSec << " s, features "
+                    << count * HIAR_FACE_FEATURE_LEN * sizeof(float)
+                        / (1024 * 1024) << " MB" << std::endl;
+
+        std::vector<int> efforts = {0};
+        if ("hnsw" == name) {
+            efforts = parseList(getArg(argc, argv, "ef_search",
+                                        "16,32,64,128,256"));
+        } else if ("ivfpq" == name) {
+            efforts = parseList(getArg(argc, argv, "nprobe",
+                                        "1,4,16,64"));
+        }
+        for (int effort : efforts) {
+            runSweep(gallery, probes, truth, topK, effort);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Startup time of a server restarted on a gallery file.
+ */
+int benchLoad(int argc, char** argv) {
+    size_t count = std::stoul(getArg(argc, argv, "count", "100000"));
+    std::string path = getArg(argc, argv, "gallery", "bench_gallery.bin");
+    bool verify = "1" == getArg(argc, argv, "gallery_verify", "0");
+    std::vector<float> features = loadFeatures(
+                                    getArg(argc, argv, "features", ""),
+                                    count, 1000, 100);
+    count = features.size() / HIAR_FACE_FEATURE_LEN;
+
+    auto begin = std::chrono::steady_clock::now();
+    FrGalleryFileWriter writer(path);
+    for (size_t i = 0; i < count; i++) {
+        float *feature = &features[i * HIAR_FACE_FEATURE_LEN];
+        frNormalize(feature, feature, HIAR_FACE_FEATURE_LEN);
+        writer.add(std::to_string(i), feature);
+    }
+    std::string error;
+    if (!writer.finish(0, &error)) {
+        std::cout << error << std::endl;
+        return 1;
+    }
+    auto written = std::chrono::steady_clock::now();
+
+    FrThreadPool pool(std::stoi(getArg(argc, argv, "gallery_threads", "0")));
+    FrGallery gallery(&pool);
+    std::shared_ptr<const FrGalleryFile> file = FrGalleryFile::open(
+                                                    path, verify, &error);
+    if (!file) {
+        std::cout << error << std::endl;
+        return 1;
+    }
+    gallery.commit(gallery.prepare(file, false),
+                    std::vector<FrGalleryOp>());
+    auto loaded = std::chrono::steady_clock::now();
+    std::vector<FrMatch> matches = gallery.identify(&features[0], 1, -1.0f);
+    auto searched = std::chrono::steady_clock::now();
+
+    typedef std::chrono::duration<double, std::milli> Ms;
+    std::cout << count << " faces, written in "
+                << Ms(written - begin).count() << " ms, loaded in "
+                << Ms(loaded - written).count() << " ms, first search in "
+                << Ms(searched - loaded).count() << " ms ("
+                << (!matches.empty() && "0" == matches[0].id ? "ok" : "wrong")
+                << ")" << std::endl;
+    return 0;
+}
+
+/**
+ * Decoding cost of a request calling the SDK twice on one image.
+ * The SDK decodes its input at each call, which is replayed with
+ * cv::imdecode; --models also times the real SDK calls.
+ */
+int benchDecode(int argc, char** argv) {
+    std::string path = getArg(argc, argv, "image", "");
+    int iterations = std::stoi(getArg(argc, argv, "iterations", "50"));
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uchar> bytes((std::istreambuf_iterator<char>(in)),
+                            std::istreambuf_iterator<char>());
+    if (bytes.empty()) {
+        std::cout << "Usage: fr_bench --mode=decode --image=face.jpg"
+                    << " [--models=../models]" << std::endl;
+        return 1;
+    }
+
+    FrHistogram before;
+    FrHistogram after;
+    for (int i = 0; i < iterations; i++) {
+        auto begin = std::chrono::steady_clock::now();
+        for (int call = 0; call < 2; call++) {
+            cv::imdecode(bytes, CV_LOAD_IMAGE_COLOR);
+        }
+        auto middle = std::chrono::steady_clock::now();
+        FrImageContext image(bytes.data(), bytes.size(), 2, true);
+        std::vector<uchar> sdkBytes(image.sdkData(),
+                                    image.sdkData() + image.sdkLen());
+        for (int call = 0; call < 2; call++) {
+            cv::imdecode(sdkBytes, CV_LOAD_IMAGE_COLOR);
+        }
+        auto end = std::chrono::steady_clock::now();
+        before.record(static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::microseconds>(
+                            middle - begin).count()));
+        after.record(static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::microseconds>(
+                            end - middle).count()));
+    }
+    std::cout << "Decoding of 2 calls, " << bytes.size() << " bytes:"
+                << std::endl;
+    before.dump(std::cout, "  encoded twice", "us");
+    after.dump(std::cout, "  decode once  ", "us");
+
+    std::string models = getArg(argc, argv, "models", "");
+    if (models.empty()
+        || 1 != HiarFace_initRecognizer(models.c_str(), nullptr)) {
+        return 0;
+    }
+    // detect+extract then quality, as featureDetect does.
+    for (int once = 0; once < 2; once++) {
+        FrHistogram sdk;
+        for (int i = 0; i < iterations; i++) {
+            auto begin = std::chrono::steady_clock::now();
+            FrImageContext image(bytes.data(), bytes.size(), 2, 1 == once);
+            int *boxes = nullptr;
+            int faces = 0;
+            float *feature = nullptr;
+            int len = 0;
+            if (1 == FrFace_detectAndExtractFeature(image, &boxes, &faces,
+                                                    &feature, &len)
+                && 0 < faces) {
+                std::vector<int> quality(faces);
+                std::vector<float> direction(faces);
+                FrFace_getQualityFaceCrops(image, boxes, faces,
+                                    quality.data(), direction.data());
+            }
+            delete[] boxes;
+            delete[] feature;
+            sdk.record(static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - begin).count()));
+        }
+        sdk.dump(std::cout,
+                once ? "  sdk, decode once  " : "  sdk, encoded twice", "us");
+    }
+    HiarFace_releaseRecognizer();
+    return 0;
+}
+
+/**
+ * Sending a frame JPEG encoded versus raw: bytes on the wire, encoding on
+ * the device, then decoding or conversion on the server until the pixels
+ * are ready for the SDK, and the total over links of --mbps.
+ */
+int benchRaw(int argc, char** argv) {
+    std::string path = getArg(argc, argv, "image", "");
+    int iterations = std::stoi(getArg(argc, argv, "iterations", "50"));
+    int quality = std::stoi(getArg(argc, argv, "jpeg_quality", "90"));
+    std::string links = getArg(argc, argv, "mbps", "10,100,1000");
+    cv::Mat bgr = cv::imread(path, CV_LOAD_IMAGE_COLOR);
+    if (bgr.empty()) {
+        std::cout << "Usage: fr_bench --mode=raw --image=face.jpg"
+                    << " [--jpeg_quality=90] [--mbps=10,100,1000]"
+                    << std::endl;
+        return 1;
+    }
+    // NV12 needs even sizes.
+    bgr = bgr(cv::Rect(0, 0, bgr.cols & ~1, bgr.rows & ~1)).clone();
+    int width = bgr.cols;
+    int height = bgr.rows;
+
+    // What a camera would hand over: NV12, Y then interleaved UV.
+    cv::Mat i420;
+    cv::cvtColor(bgr, i420, cv::COLOR_BGR2YUV_I420);
+    std::vector<uchar> nv12(i420.data, i420.data + width * height);
+    const uchar *u = i420.data + width * height;
+    const uchar *v = u + width * height / 4;
+    for (int i = 0; i < width * height / 4; i++) {
+        nv12.push_back(u[i]);
+        nv12.push_back(v[i]);
+    }
+
+    struct Result {
+        const char *name;
+        size_t bytes;
+        FrHistogram device;
+        FrHistogram server;
+    };
+    Result results[3] = {{"jpeg", 0, {}, {}}, {"raw bgr", 0, {}, {}},
+                        {"raw nv12", 0, {}, {}}};
+    auto us = [](std::chrono::steady_clock::time_point since) {
+        return static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - since).count());
+    };
+    for (int i = 0; i < iterations; i++) {
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<uchar> jpeg;
+        cv::imencode(".jpg", bgr, jpeg, {cv::IMWRITE_JPEG_QUALITY, quality});
+        results[0].device.record(us(begin));
+        results[0].bytes = jpeg.size();
+        begin = std::chrono::steady_clock::now();
+        {
+            FrImageContext image(jpeg.data(), jpeg.size(), 2, true);
+            image.sdkData();
+        }
+        results[0].server.record(us(begin));
+
+        const FrPixelFormat formats[2] = {kFrPixelBgr, kFrPixelNv12};
+        const uchar *data[2] = {bgr.data, nv12.data()};
+        const size_t len[2] = {bgr.total() * bgr.elemSize(), nv12.size()};
+        for (int f = 0; f < 2; f++) {
+            results[1 + f].bytes = len[f];
+            begin = std::chrono::steady_clock::now();
+            cv::Mat pixels;
+            frWrapPixels(data[f], len[f], width, height, 0, formats[f],
+                        &pixels);
+            FrImageContext image(pixels, 0);
+            image.sdkData();
+            results[1 + f].server.record(us(begin));
+        }
+    }
+
+    std::cout << width << 'x' << height << ", " << iterations
+                << " iterations, jpeg quality " << quality << std::endl;
+    for (auto &result : results) {
+        std::cout << result.name << ": " << result.bytes << " bytes"
+                    << std::endl;
+        if (0 < result.device.count()) {
+            result.device.dump(std::cout, "  device encode", "us");
+        }
+        result.server.dump(std::cout, "  server ready ", "us");
+    }
+    std::stringstream list(links);
+    std::string link;
+    while (std::getline(list, link, ',')) {
+        double mbps = std::stod(link);
+        std::cout << mbps << " Mbps, ms per frame:";
+        for (auto &result : results) {
+            double transferMs = result.bytes * 8 / (mbps * 1e3);
+            std::cout << ' ' << result.name << ' '
+                        << (result.device.mean() + result.server.mean())
+                            / 1000 + transferMs;
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
+
+/**
+ * Time per pair of scoring --probes against --candidates, per pair as
+ * compareFeature does, copies included, then batched by each kernel.
+ */
+int benchSimilarity(int argc, char** argv) {
+    int m = std::stoi(getArg(argc, argv, "probes", "8"));
+    int n = std::stoi(getArg(argc, argv, "candidates", "10000"));
+    int iterations = std::stoi(getArg(argc, argv, "iterations", "20"));
+    const int len = HIAR_FACE_FEATURE_LEN;
+    std::vector<float> probes = loadFeatures("", m, m, 1);
+    std::vector<float> candidates = loadFeatures("", n, 1000, 2);
+    std::vector<float> scores(static_cast<size_t>(m) * n);
+    double pairs = static_cast<double>(m) * n;
+    auto nsPerPair = [pairs, iterations](
+                        std::chrono::steady_clock::time_point since) {
+        return std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - since).count()
+                / iterations / pairs;
+    };
+    std::cout << m << " probes x " << n << " candidates of " << len
+                << " floats" << std::endl;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; it++) {
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < n; j++) {
+                float *faceA = new float[len];
+                float *faceB = new float[len];
+                std::copy(&probes[static_cast<size_t>(i) * len],
+                        &probes[static_cast<size_t>(i + 1) * len], faceA);
+                std::copy(&candidates[static_cast<size_t>(j) * len],
+                        &candidates[static_cast<size_t>(j + 1) * len], faceB);
+                scores[static_cast<size_t>(i) * n + j] =
+                    HiarFace_compareFaceFeature(faceA, len, faceB, len);
+                delete[] faceA;
+                delete[] faceB;
+            }
+        }
+    }
+    double perPair = nsPerPair(begin);
+    std::cout << "  per pair: " << perPair << " ns/pair" << std::endl;
+
+    std::string selected = frSimilarityKernel();
+    for (const std::string &kernel : frSimilarityKernels()) {
+        frSelectSimilarityKernel(kernel);
+        for (int s = 0; s < 2; s++) {
+            FrSimilarity similarity = 0 == s ? kFrCosine : kFrDot;
+            begin = std::chrono::steady_clock::now();
+            for (int it = 0; it < iterations; it++) {
+                frScoreMatrix(probes.data(), m, candidates.data(), n, len,
+                            similarity, scores.data());
+            }
+            double batched = nsPerPair(begin);
+            std::cout << "  " << kernel << (0 == s ? " cosine: " : " dot: ")
+                        << batched << " ns/pair, x" << perPair / batched
+                        << std::endl;
+        }
+    }
+    frSelectSimilarityKernel(selected);
+    return 0;
+}
+
+/**
+ * Size and cost of a reply of --faces features in each encoding, and the
+ * error each one adds to the scores of --pairs pairs of faces, many of
+ * them of the same identity.
+ */
+int benchEncoding(int argc, char** argv) {
+    int faces = std::stoi(getArg(argc, argv, "faces", "10"));
+    int pairs = std::stoi(getArg(argc, argv, "pairs", "10000"));
+    int iterations = std::stoi(getArg(argc, argv, "iterations", "1000"));
+    std::string path = getArg(argc, argv, "features", "");
+    const int len = HIAR_FACE_FEATURE_LEN;
+    // Few identities, so that many pairs are of the same one.
+    std::vector<float> features = loadFeatures(path, 2 * pairs,
+                                                std::max(1, pairs / 50), 3);
+    int count = static_cast<int>(features.size() / len);
+    if (2 > count || faces > count) {
+        std::cout << "Not enough features" << std::endl;
+        return 1;
+    }
+    std::vector<float> exact(count / 2);
+    for (size_t p = 0; p < exact.size(); p++) {
+        exact[p] = HiarFace_compareFaceFeature(&features[2 * p * len], len,
+                                            &features[(2 * p + 1) * len], len);
+    }
+    std::cout << faces << " faces per reply, " << exact.size() << " pairs"
+                << std::endl;
+
+    const FrFeatureEncoding encodings[] = {kFrFloats, kFrPackedF32,
+                                            kFrPackedF16, kFrPackedI8};
+    for (FrFeatureEncoding encoding : encodings) {
+        facerecg::FeatureReply reply;
+        reply.set_encoding(static_cast<facerecg::FeatureEncoding>(encoding));
+        std::string wire;
+        auto begin = std::chrono::steady_clock::now();
+        for (int it = 0; it < iterations; it++) {
+            reply.clear_features();
+            reply.clear_packedfeatures();
+            for (int f = 0; f < faces; f++) {
+                const float *feature = &features[f * len];
+                if (kFrFloats == encoding) {
+                    reply.mutable_features()->Add(feature, feature + len);
+                } else {
+                    frPackFeature(encoding, feature, len,
+                                    reply.mutable_packedfeatures());
+                }
+            }
+            reply.SerializeToString(&wire);
+        }
+        double encodeUs = std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - begin).count() / iterations;
+        facerecg::FeatureReply parsed;
+        std::vector<float> decoded;
+        begin = std::chrono::steady_clock::now();
+        for (int it = 0; it < iterations; it++) {
+            parsed.ParseFromString(wire);
+            if (kFrFloats != encoding) {
+                frUnpackFeatures(encoding, parsed.packedfeatures(), len,
+                                &decoded);
+            }
+        }
+        double decodeUs = std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - begin).count() / iterations;
+
+        // Error of the scores once both faces went through the encoding.
+        double sumError = 0;
+        double maxError = 0;
+        std::string packed;
+        std::vector<float> pair;
+        for (size_t p = 0; p < exact.size(); p++) {
+            float score = exact[p];
+            if (kFrFloats != encoding) {
+                packed.clear();
+                frPackFeature(encoding, &features[2 * p * len], len, &packed);
+                frPackFeature(encoding, &features[(2 * p + 1) * len], len,
+                                &packed);
+                frUnpackFeatures(encoding, packed, len, &pair);
+                score = HiarFace_compareFaceFeature(pair.data(), len,
+                                                    pair.data() + len, len);
+            }
+            double error = std::fabs(score - exact[p]);
+            sumError += error;
+            maxError = std::max(maxError, error);
+        }
+        std::cout << frEncodingName(encoding) << ": " << wire.size()
+                    << " bytes, encode " << encodeUs << " us, decode "
+                    << decodeUs << " us, score error mean "
+                    << sumError / exact.size() << " max " << maxError
+                    << std::endl;
+    }
+    return 0;
+}
+
+/**
+ * Messages of a featureExtract rpc of --faces faces: parse the request,
+ * fill the reply and serialize it, as the server did with its messages on
+ * the heap and features added one by one, then on an FrCallArena with the
+ * faces reserved up front. The image is left out, it is the same bytes
+ * either way.
+ */
+int benchArena(int argc, char** argv) {
+    int faces = std::stoi(getArg(argc, argv, "faces", "10"));
+    int iterations = std::stoi(getArg(argc, argv, "iterations", "20000"));
+    const int len = HIAR_FACE_FEATURE_LEN;
+    std::vector<float> features = loadFeatures(
+                            getArg(argc, argv, "features", ""), faces, 1, 1);
+    if (static_cast<int>(features.size()) < faces * len) {
+        std::cout << "Not enough features" << std::endl;
+        return 1;
+    }
+    facerecg::FeatureRequest sent;
+    for (int f = 0; f < faces; f++) {
+        facerecg::AbsRect *rect = sent.add_rects();
+        rect->set_left(40 * f);
+        rect->set_top(20);
+        rect->set_width(112);
+        rect->set_height(112);
+    }
+    std::string request = sent.SerializeAsString();
+    std::cout << faces << " faces per reply" << std::endl;
+
+    for (int onArena = 0; onArena < 2; onArena++) {
+        FrHistogram latencyNs;
+        std::string wire;
+        uint64_t calls = newCalls.load();
+        for (int it = 0; it < iterations; it++) {
+            auto begin = std::chrono::steady_clock::now();
+            if (onArena) {
+                FrCallArena arena;
+                facerecg::FeatureRequest *in =
+                                arena.create<facerecg::FeatureRequest>();
+                facerecg::FeatureReply *out =
+                                arena.create<facerecg::FeatureReply>();
+                in->ParseFromString(request);
+                out->mutable_rects()->Reserve(in->rects().size());
+                out->mutable_features()->Reserve(in->rects().size() * len);
+                for (int f = 0; f < in->rects().size(); f++) {
+                    *out->add_rects() = in->rects(f);
+                    out->mutable_features()->Add(&features[f * len],
+                                                &features[(f + 1) * len]);
+                }
+                out->SerializeToString(&wire);
+            } else {
+                facerecg::FeatureRequest in;
+                facerecg::FeatureReply out;
+                in.ParseFromString(request);
+                for (int f = 0; f < in.rects().size(); f++) {
+                    *out.add_rects() = in.rects(f);
+                    for (int i = 0; i < len; i++) {
+                        out.add_features(features[f * len + i]);
+                    }
+                }
+                out.SerializeToString(&wire);
+            }
+            latencyNs.record(std::chrono::duration_cast<
+                    std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - begin).count());
+        }
+        std::cout << (onArena ? "arena" : "heap") << ": "
+                    << static_cast<double>(newCalls.load() - calls)
+                        / iterations << " allocations per rpc, p50 "
+                    << latencyNs.percentile(0.5) / 1000.0 << " us, p99 "
+                    << latencyNs.percentile(0.99) / 1000.0 << " us"
+                    << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string mode = getArg(argc, argv, "mode", "ann");
+    if ("ann" == mode) {
+        return benchAnn(argc, argv);
+    }
+    if ("load" == mode) {
+        return benchLoad(argc, argv);
+    }
+    if ("decode" == mode) {
+        return benchDecode(argc, argv);
+    }
+    if ("raw" == mode) {
+        return benchRaw(argc, argv);
+    }
+    if ("similarity" == mode) {
+        return benchSimilarity(argc, argv);
+    }
+    if ("encoding" == mode) {
+        return benchEncoding(argc, argv);
+    }
+    if ("arena" == mode) {
+        return benchArena(argc, argv);
+    }
+    std::cout << "Unknown mode: " << mode << std::endl;
+    return 1;
+}
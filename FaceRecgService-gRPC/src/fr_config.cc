@@ -0,0 +1,62 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Configuration file of the server.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_config.h"
+
+#include <fstream>
+
+namespace {
+
+std::string trim(const std::string &text) {
+    const char *blanks = " \t\r";
+    size_t first = text.find_first_not_of(blanks);
+    if (std::string::npos == first) {
+        return "";
+    }
+    return text.substr(first, text.find_last_not_of(blanks) - first + 1);
+}
+
+} // namespace
+
+bool frReadConfig(const std::string &path, std::vector<std::string> *args,
+                    std::string *error) {
+    std::ifstream in(path);
+    if (!in) {
+        *error = "cannot read " + path;
+        return false;
+    }
+    std::string line;
+    for (int number = 1; std::getline(in, line); number++) {
+        line = trim(line);
+        if (line.empty() || '#' == line[0]) {
+            continue;
+        }
+        size_t equal = line.find('=');
+        std::string key = trim(line.substr(0, equal));
+        if (std::string::npos == equal || key.empty()) {
+            *error = path + ":" + std::to_string(number)
+                    + ": expected key = value";
+            return false;
+        }
+        args->push_back("--" + key + "=" + trim(line.substr(equal + 1)));
+    }
+    return true;
+}
@@ -0,0 +1,149 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Cache of extracted features, keyed by image content and face box.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_feature_cache.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+/// Nodes of the list and of the map, with their allocation headers.
+const size_t kEntryOverhead = 128;
+
+} // namespace
+
+FrFeatureCache::FrFeatureCache(size_t budgetBytes, double ttlSeconds,
+                                int featureLen)
+        : featureLen_(featureLen),
+        entryBytes_(featureLen * sizeof(float) + sizeof(Entry)
+                    + kEntryOverhead),
+        shardCapacity_(std::max<size_t>(1, budgetBytes / kShards
+                                            / entryBytes_)),
+        ttl_(0 < ttlSeconds
+            ? std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(ttlSeconds))
+            : Clock::duration::max()) {
+}
+
+FrContentHash FrFeatureCache::keyOf(const FrContentHash &image,
+                                    const int *box) {
+    int32_t rect[4] = {box[0], box[1], box[2], box[3]};
+    return frHash128(rect, sizeof(rect), image);
+}
+
+bool FrFeatureCache::lookup(const FrContentHash &key, float *feature) {
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(key);
+    if (shard.index.end() == found) {
+        shard.misses++;
+        return false;
+    }
+    std::list<Entry>::iterator entry = found->second;
+    if (entry->expires <= Clock::now()) {
+        shard.index.erase(found);
+        shard.lru.erase(entry);
+        shard.expired++;
+        shard.misses++;
+        return false;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+    std::copy(entry->feature.begin(), entry->feature.end(), feature);
+    shard.hits++;
+    return true;
+}
+
+void FrFeatureCache::insert(const FrContentHash &key, const float *feature) {
+    Clock::time_point now = Clock::now();
+    Clock::time_point expires = Clock::time_point::max() - now > ttl_
+                                ? now + ttl_ : Clock::time_point::max();
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(key);
+    if (shard.index.end() != found) {
+        // Extracted twice by concurrent misses, same feature.
+        found->second->expires = expires;
+        shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+        return;
+    }
+    if (shard.lru.size() >= shardCapacity_) {
+        // Reuse the evicted node and its feature buffer.
+        std::list<Entry>::iterator last = std::prev(shard.lru.end());
+        shard.index.erase(last->key);
+        shard.lru.splice(shard.lru.begin(), shard.lru, last);
+        shard.evictions++;
+    } else {
+        shard.lru.emplace_front();
+        shard.lru.front().feature.resize(featureLen_);
+    }
+    Entry &entry = shard.lru.front();
+    entry.key = key;
+    entry.expires = expires;
+    std::copy(feature, feature + featureLen_, entry.feature.begin());
+    shard.index[key] = shard.lru.begin();
+}
+
+FrFeatureCache::Totals FrFeatureCache::totals() const {
+    Totals totals;
+    for (const Shard &shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        totals.hits += shard.hits;
+        totals.misses += shard.misses;
+        totals.evictions += shard.evictions;
+        totals.expired += shard.expired;
+        totals.entries += shard.lru.size();
+    }
+    return totals;
+}
+
+void FrFeatureCache::dump(std::ostream &os) const {
+    Totals totals = this->totals();
+    uint64_t lookups = totals.hits + totals.misses;
+    os << "Feature cache: " << totals.hits << " hits, " << totals.misses
+        << " misses (" << (0 < lookups ? 100.0 * totals.hits / lookups : 0)
+        << "% hit), " << totals.evictions << " evicted, " << totals.expired
+        << " expired, " << totals.entries << " entries, "
+        << (totals.entries * entryBytes_ >> 20) << " MB" << std::endl;
+}
+
+void FrFeatureCache::exposition(std::ostream &os) const {
+    Totals totals = this->totals();
+    os << "# HELP fr_feature_cache_hits_total Features served from the"
+        << " cache.\n"
+        << "# TYPE fr_feature_cache_hits_total counter\n"
+        << "fr_feature_cache_hits_total " << totals.hits << '\n'
+        << "# HELP fr_feature_cache_misses_total Features extracted, expired"
+        << " entries included.\n"
+        << "# TYPE fr_feature_cache_misses_total counter\n"
+        << "fr_feature_cache_misses_total " << totals.misses << '\n'
+        << "# HELP fr_feature_cache_evictions_total Entries evicted by the"
+        << " memory budget.\n"
+        << "# TYPE fr_feature_cache_evictions_total counter\n"
+        << "fr_feature_cache_evictions_total " << totals.evictions << '\n'
+        << "# HELP fr_feature_cache_expired_total Entries dropped past their"
+        << " TTL.\n"
+        << "# TYPE fr_feature_cache_expired_total counter\n"
+        << "fr_feature_cache_expired_total " << totals.expired << '\n'
+        << "# HELP fr_feature_cache_bytes Estimated memory of the entries.\n"
+        << "# TYPE fr_feature_cache_bytes gauge\n"
+        << "fr_feature_cache_bytes " << totals.entries * entryBytes_ << '\n';
+}
@@ -0,0 +1,173 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Packed encodings of features in bytes fields.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_feature_codec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__BYTE_ORDER__)
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+                "packed features are copied in host order");
+#endif
+
+namespace {
+
+const char *kEncodingNames[] = {"floats", "f32", "f16", "i8"};
+
+inline uint32_t bitsOf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline float floatOf(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/// float32 to float16, rounded to nearest even, overflow to infinity.
+uint16_t toHalf(float value) {
+    uint32_t bits = bitsOf(value);
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    bits &= 0x7fffffff;
+    if (bits >= 0x47800000) {
+        // Past the float16 range, infinity or NaN.
+        return sign | (bits > 0x7f800000 ? 0x7e00 : 0x7c00);
+    }
+    if (bits < 0x38800000) {
+        // Subnormal float16: adding 0.5 leaves the rounded mantissa in
+        // the low bits.
+        float shifted = floatOf(bits) + 0.5f;
+        return sign | static_cast<uint16_t>(bitsOf(shifted) - 0x3f000000);
+    }
+    uint32_t odd = (bits >> 13) & 1;
+    // Rebias the exponent from 127 to 15, then round.
+    bits += 0xc8000fff + odd;
+    return sign | static_cast<uint16_t>(bits >> 13);
+}
+
+/// float16 to float32, exact.
+float fromHalf(uint16_t half) {
+    uint32_t bits = static_cast<uint32_t>(half & 0x7fff) << 13;
+    uint32_t exponent = bits & 0x0f800000;
+    bits += (127 - 15) << 23;
+    if (0x0f800000 == exponent) {
+        // Infinity or NaN.
+        bits += (128 - 16) << 23;
+    } else if (0 == exponent) {
+        // Subnormal, renormalized by the FPU.
+        bits = bitsOf(floatOf(bits + (1 << 23)) - floatOf(113 << 23));
+    }
+    return floatOf(bits | static_cast<uint32_t>(half & 0x8000) << 16);
+}
+
+} // namespace
+
+const char* frEncodingName(FrFeatureEncoding encoding) {
+    return kEncodingNames[encoding];
+}
+
+bool frParseEncoding(const std::string &name, FrFeatureEncoding *encoding) {
+    for (int i = kFrFloats; i <= kFrPackedI8; i++) {
+        if (name == kEncodingNames[i]) {
+            *encoding = static_cast<FrFeatureEncoding>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t frPackedBytes(FrFeatureEncoding encoding, int len) {
+    switch (encoding) {
+        case kFrPackedF16:
+            return len * sizeof(uint16_t);
+        case kFrPackedI8:
+            return sizeof(float) + len;
+        default:
+            return len * sizeof(float);
+    }
+}
+
+void frPackFeature(FrFeatureEncoding encoding, const float *feature,
+                    int len, std::string *packed) {
+    size_t offset = packed->size();
+    packed->resize(offset + frPackedBytes(encoding, len));
+    char *out = &(*packed)[offset];
+    if (kFrPackedF16 == encoding) {
+        for (int i = 0; i < len; i++) {
+            uint16_t half = toHalf(feature[i]);
+            std::memcpy(out + i * sizeof(half), &half, sizeof(half));
+        }
+    } else if (kFrPackedI8 == encoding) {
+        float maxAbs = 0;
+        for (int i = 0; i < len; i++) {
+            maxAbs = std::max(maxAbs, std::fabs(feature[i]));
+        }
+        float scale = maxAbs / 127;
+        float inverse = 0 < scale ? 1 / scale : 0;
+        std::memcpy(out, &scale, sizeof(scale));
+        int8_t *values = reinterpret_cast<int8_t*>(out + sizeof(scale));
+        for (int i = 0; i < len; i++) {
+            // Rounded half away from zero, inline unlike lrint.
+            float q = feature[i] * inverse;
+            q = std::min(127.0f, std::max(-127.0f, q));
+            values[i] = static_cast<int8_t>(q + (0 > q ? -0.5f : 0.5f));
+        }
+    } else {
+        std::memcpy(out, feature, len * sizeof(float));
+    }
+}
+
+bool frUnpackFeatures(FrFeatureEncoding encoding, const std::string &packed,
+                        int len, std::vector<float> *features) {
+    size_t bytes = frPackedBytes(encoding, len);
+    if (0 >= len || 0 != packed.size() % bytes) {
+        return false;
+    }
+    size_t count = packed.size() / bytes;
+    features->resize(count * len);
+    float *out = features->data();
+    for (size_t face = 0; face < count; face++, out += len) {
+        const char *in = packed.data() + face * bytes;
+        if (kFrPackedF16 == encoding) {
+            for (int i = 0; i < len; i++) {
+                uint16_t half;
+                std::memcpy(&half, in + i * sizeof(half), sizeof(half));
+                out[i] = fromHalf(half);
+            }
+        } else if (kFrPackedI8 == encoding) {
+            float scale;
+            std::memcpy(&scale, in, sizeof(scale));
+            const int8_t *values = reinterpret_cast<const int8_t*>(
+                                                        in + sizeof(scale));
+            for (int i = 0; i < len; i++) {
+                out[i] = values[i] * scale;
+            }
+        } else {
+            std::memcpy(out, in, len * sizeof(float));
+        }
+    }
+    return true;
+}
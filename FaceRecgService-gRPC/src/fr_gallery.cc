@@ -0,0 +1,506 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	In-memory gallery of enrolled faces for 1:N identification.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_gallery.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <new>
+#include <sstream>
+
+#include "fr_feature_math.h"
+
+namespace {
+
+/// Candidate of a partial scan, a row of the matrix.
+struct RowScore {
+    size_t row;
+    float score;
+};
+
+/// Orders a std heap with the worst candidate on top.
+bool betterScore(const RowScore &a, const RowScore &b) {
+    return a.score > b.score;
+}
+
+/// Dot product of two aligned features.
+inline float dotFeature(const float *a, const float *b) {
+    return frDotProduct(
+            static_cast<const float*>(__builtin_assume_aligned(
+                                        a, FrGallery::kAlignment)),
+            static_cast<const float*>(__builtin_assume_aligned(
+                                        b, FrGallery::kAlignment)),
+            HIAR_FACE_FEATURE_LEN);
+}
+
+/**
+ * @brief			    Keep the topK best rows of [begin, end).
+ * @param[in] removed   Mask of the rows to skip, may be null.
+ * @param[in] offset    Added to the rows given to the heap.
+ * @param[out] heap     Candidates, a std heap with the worst on top.
+ */
+void scanRows(const float *features, const uint8_t *removed,
+                size_t begin, size_t end, size_t offset,
+                const float *probe, size_t topK, float minScore,
+                std::vector<RowScore> *heap) {
+    for (size_t row = begin; row < end; row++) {
+        if (nullptr != removed && removed[row]) {
+            continue;
+        }
+        float score = dotFeature(features + row * HIAR_FACE_FEATURE_LEN, probe);
+        if (score < minScore) {
+            continue;
+        }
+        if (heap->size() < topK) {
+            heap->push_back({offset + row, score});
+            std::push_heap(heap->begin(), heap->end(), betterScore);
+        } else if (score > heap->front().score) {
+            std::pop_heap(heap->begin(), heap->end(), betterScore);
+            heap->back() = {offset + row, score};
+            std::push_heap(heap->begin(), heap->end(), betterScore);
+        }
+    }
+}
+
+} // namespace
+
+/**
+ * Rows [0, baseRows) are the rows of the file, the rows after are the delta.
+ * Labels of the file are its rows, labels of the delta start at baseRows.
+ */
+class FrGallery::State final : public FrVectorStore {
+    public:
+        explicit State(std::shared_ptr<const FrGalleryFile> file)
+                : base(file), baseRows(file ? file->rows() : 0),
+                removedBase(baseRows, 0) {
+        }
+        ~State() override {
+            free(features);
+        }
+        State(const State&) = delete;
+        State& operator=(const State&) = delete;
+
+        const float* vectorOf(uint32_t label) const override {
+            return label < baseRows ? base->feature(label)
+                    : features + rowOfLabel[label - baseRows]
+                                    * HIAR_FACE_FEATURE_LEN;
+        }
+        size_t size() const {
+            return baseRows - removedCount + ids.size();
+        }
+        size_t rows() const {
+            return baseRows + ids.size();
+        }
+        bool alive(size_t row) const {
+            return row >= baseRows || !removedBase[row];
+        }
+        const float* feature(size_t row) const {
+            return row < baseRows ? base->feature(row)
+                    : features + (row - baseRows) * HIAR_FACE_FEATURE_LEN;
+        }
+        std::string idOf(size_t row) const {
+            return row < baseRows ? base->idOf(row) : ids[row - baseRows];
+        }
+        std::string idOfLabel(uint32_t label) const {
+            return label < baseRows ? base->idOf(label)
+                                    : ids[rowOfLabel[label - baseRows]];
+        }
+        /// Labels of the faces, in no particular order.
+        std::vector<uint32_t> liveLabels() const {
+            std::vector<uint32_t> live;
+            for (size_t row = 0; row < baseRows; row++) {
+                if (!removedBase[row]) {
+                    live.push_back(static_cast<uint32_t>(row));
+                }
+            }
+            live.insert(live.end(), labels.begin(), labels.end());
+            return live;
+        }
+
+        void enroll(const std::string &id, const float *normed);
+        bool remove(const std::string &id);
+        /// Copy without the index.
+        std::shared_ptr<State> clone() const;
+
+        std::shared_ptr<const FrGalleryFile> base;
+        const size_t baseRows;
+        /// One flag per row of the file.
+        std::vector<uint8_t> removedBase;
+        size_t removedCount = 0;
+
+        /// Delta, row-major, HIAR_FACE_FEATURE_LEN floats per row.
+        float *features = nullptr;
+        size_t capacity = 0;
+        std::vector<std::string> ids;
+        /// Label of the feature held by each delta row.
+        std::vector<uint32_t> labels;
+        /// Delta row of each delta label ever given, kNoRow once removed.
+        std::vector<size_t> rowOfLabel;
+        std::unordered_map<std::string, size_t> rowOf;
+
+        std::unique_ptr<FrAnnIndex> index;
+
+    private:
+        /// rowOfLabel of removed labels.
+        static const size_t kNoRow = static_cast<size_t>(-1);
+
+        /// Grow the delta to hold at least rows rows.
+        void reserve(size_t rows);
+        /// Mask the row of the file holding id, if any.
+        bool removeFromBase(const std::string &id);
+};
+
+void FrGallery::State::enroll(const std::string &id, const float *normed) {
+    size_t row;
+    uint32_t label = static_cast<uint32_t>(baseRows + rowOfLabel.size());
+    auto found = rowOf.find(id);
+    if (rowOf.end() != found) {
+        // A new label, so that the index never sees a label change.
+        row = found->second;
+        if (index) {
+            index->remove(labels[row]);
+        }
+        rowOfLabel[labels[row] - baseRows] = kNoRow;
+        labels[row] = label;
+    } else {
+        removeFromBase(id);
+        row = ids.size();
+        reserve(row + 1);
+        ids.push_back(id);
+        labels.push_back(label);
+        rowOf[id] = row;
+    }
+    rowOfLabel.push_back(row);
+    memcpy(features + row * HIAR_FACE_FEATURE_LEN, normed,
+            HIAR_FACE_FEATURE_LEN * sizeof(float));
+    if (index) {
+        index->add(label);
+    }
+}
+
+bool FrGallery::State::remove(const std::string &id) {
+    auto found = rowOf.find(id);
+    if (rowOf.end() == found) {
+        return removeFromBase(id);
+    }
+    size_t row = found->second;
+    // The index may still read the removed feature while unlinking it.
+    if (index) {
+        index->remove(labels[row]);
+    }
+    rowOfLabel[labels[row] - baseRows] = kNoRow;
+
+    // Move the last row into the hole to keep the matrix dense.
+    size_t last = ids.size() - 1;
+    if (row != last) {
+        memcpy(features + row * HIAR_FACE_FEATURE_LEN,
+                features + last * HIAR_FACE_FEATURE_LEN,
+                HIAR_FACE_FEATURE_LEN * sizeof(float));
+        ids[row] = ids[last];
+        labels[row] = labels[last];
+        rowOf[ids[row]] = row;
+        rowOfLabel[labels[row] - baseRows] = row;
+    }
+    ids.pop_back();
+    labels.pop_back();
+    rowOf.erase(found);
+    return true;
+}
+
+bool FrGallery::State::removeFromBase(const std::string &id) {
+    size_t row;
+    if (!base || !base->find(id, &row) || removedBase[row]) {
+        return false;
+    }
+    if (index) {
+        index->remove(static_cast<uint32_t>(row));
+    }
+    removedBase[row] = 1;
+    removedCount++;
+    return true;
+}
+
+std::shared_ptr<FrGallery::State> FrGallery::State::clone() const {
+    std::shared_ptr<State> copy(new State(base));
+    copy->removedBase = removedBase;
+    copy->removedCount = removedCount;
+    copy->reserve(ids.size());
+    if (!ids.empty()) {
+        memcpy(copy->features, features,
+                ids.size() * HIAR_FACE_FEATURE_LEN * sizeof(float));
+    }
+    copy->ids = ids;
+    copy->labels = labels;
+    copy->rowOfLabel = rowOfLabel;
+    copy->rowOf = rowOf;
+    return copy;
+}
+
+void FrGallery::State::reserve(size_t rows) {
+    if (rows <= capacity) {
+        return;
+    }
+    size_t grown = std::max(rows, 0 < capacity ? 2 * capacity : 1024);
+    void *matrix = nullptr;
+    if (0 != posix_memalign(&matrix, kAlignment,
+                            grown * HIAR_FACE_FEATURE_LEN * sizeof(float))) {
+        throw std::bad_alloc();
+    }
+    if (nullptr != features) {
+        memcpy(matrix, features,
+                ids.size() * HIAR_FACE_FEATURE_LEN * sizeof(float));
+        free(features);
+    }
+    features = static_cast<float*>(matrix);
+    capacity = grown;
+}
+
+FrGallery::FrGallery(FrThreadPool *pool, size_t rowsPerTask)
+        : pool_(pool), rowsPerTask_(0 < rowsPerTask ? rowsPerTask : 1),
+        state_(new State(nullptr)) {
+}
+
+FrGallery::~FrGallery() {
+}
+
+bool FrGallery::enroll(const std::string &id, const float *feature,
+                        bool train) {
+    alignas(kAlignment) float normed[HIAR_FACE_FEATURE_LEN];
+    if (!frNormalize(feature, normed, HIAR_FACE_FEATURE_LEN)) {
+        return false;
+    }
+    {
+        FrWriteGuard guard(lock_);
+        state_->enroll(id, normed);
+    }
+    if (train) {
+        this->train();
+    }
+    return true;
+}
+
+bool FrGallery::remove(const std::string &id) {
+    FrWriteGuard guard(lock_);
+    return state_->remove(id);
+}
+
+std::vector<FrMatch> FrGallery::identify(const float *probe, int topK,
+                                        float minScore, int effort) const {
+    std::vector<FrMatch> matches;
+    alignas(kAlignment) float normed[HIAR_FACE_FEATURE_LEN];
+    if (0 >= topK || !frNormalize(probe, normed, HIAR_FACE_FEATURE_LEN)) {
+        return matches;
+    }
+
+    FrReadGuard guard(lock_);
+    const State &state = *state_;
+    if (!state.index || !state.index->ready()) {
+        return scan(state, normed, topK, minScore);
+    }
+    std::vector<FrAnnResult> results = state.index->search(normed, topK,
+                                                            effort);
+    for (const FrAnnResult &result : results) {
+        if (result.score >= minScore) {
+            matches.push_back({state.idOfLabel(result.label), result.score});
+        }
+    }
+    return matches;
+}
+
+std::vector<FrMatch> FrGallery::identifyExact(const float *probe, int topK,
+                                            float minScore) const {
+    alignas(kAlignment) float normed[HIAR_FACE_FEATURE_LEN];
+    if (0 >= topK || !frNormalize(probe, normed, HIAR_FACE_FEATURE_LEN)) {
+        return std::vector<FrMatch>();
+    }
+    FrReadGuard guard(lock_);
+    return scan(*state_, normed, topK, minScore);
+}
+
+std::vector<FrMatch> FrGallery::scan(const State &state, const float *normed,
+                                    int topK, float minScore) const {
+    std::vector<FrMatch> matches;
+    size_t rows = state.rows();
+    size_t maxTasks = nullptr == pool_ ? 1 : pool_->size() + 1;
+    size_t tasks = std::min(maxTasks, (rows + rowsPerTask_ - 1) / rowsPerTask_);
+    tasks = 0 < tasks ? tasks : 1;
+    size_t chunk = (rows + tasks - 1) / tasks;
+
+    // A chunk may cover the end of the file and the start of the delta.
+    const State *shared = &state;
+    auto scanChunk = [=](size_t begin, size_t end,
+                        std::vector<RowScore> *heap) {
+        size_t baseEnd = std::min(end, shared->baseRows);
+        if (begin < baseEnd) {
+            scanRows(shared->base->feature(0), shared->removedBase.data(),
+                    begin, baseEnd, 0, normed, topK, minScore, heap);
+        }
+        size_t deltaBegin = std::max(begin, shared->baseRows);
+        if (deltaBegin < end) {
+            scanRows(shared->features, nullptr,
+                    deltaBegin - shared->baseRows, end - shared->baseRows,
+                    shared->baseRows, normed, topK, minScore, heap);
+        }
+    };
+    std::vector<std::vector<RowScore>> heaps(tasks);
+    std::vector<std::future<void>> done;
+    for (size_t t = 1; t < tasks; t++) {
+        size_t begin = t * chunk;
+        size_t end = std::min(rows, begin + chunk);
+        std::vector<RowScore> *heap = &heaps[t];
+        done.push_back(pool_->submit([=]() {
+            scanChunk(begin, end, heap);
+        }));
+    }
+    // The caller scans the first chunk itself.
+    scanChunk(0, std::min(rows, chunk), &heaps[0]);
+    for (auto &task : done) {
+        task.get();
+    }
+
+    std::vector<RowScore> merged;
+    for (auto &heap : heaps) {
+        merged.insert(merged.end(), heap.begin(), heap.end());
+    }
+    size_t keep = std::min(merged.size(), static_cast<size_t>(topK));
+    std::partial_sort(merged.begin(), merged.begin() + keep, merged.end(),
+                        betterScore);
+    for (size_t i = 0; i < keep; i++) {
+        matches.push_back({state.idOf(merged[i].row), merged[i].score});
+    }
+    return matches;
+}
+
+void FrGallery::setIndex(IndexFactory factory) {
+    {
+        FrWriteGuard guard(lock_);
+        factory_ = factory;
+        state_->index = factory_ ? factory_(state_.get()) : nullptr;
+        if (state_->index) {
+            for (uint32_t label : state_->liveLabels()) {
+                state_->index->add(label);
+            }
+        }
+    }
+    train();
+}
+
+void FrGallery::train() {
+    std::shared_ptr<State> state;
+    std::unique_ptr<FrAnnTrainer> trainer;
+    {
+        FrReadGuard guard(lock_);
+        if (state_->index) {
+            trainer = state_->index->startTraining();
+            state = state_;
+        }
+    }
+    if (!trainer) {
+        return;
+    }
+    trainer->run();
+    FrWriteGuard guard(lock_);
+    // The index ignores the trainer of another one, should it be replaced.
+    if (state == state_ && state_->index) {
+        state_->index->finishTraining(std::move(trainer));
+    }
+}
+
+std::string FrGallery::describeIndex() const {
+    FrReadGuard guard(lock_);
+    if (!state_->index) {
+        return "flat";
+    }
+    std::ostringstream os;
+    os << state_->index->describe() << ", "
+        << state_->index->memoryBytes() / (1024 * 1024) << " MB";
+    return os.str();
+}
+
+size_t FrGallery::size() const {
+    FrReadGuard guard(lock_);
+    return state_->size();
+}
+
+std::shared_ptr<FrGallery::State> FrGallery::prepare(
+                                    std::shared_ptr<const FrGalleryFile> file,
+                                    bool withIndex) const {
+    std::shared_ptr<State> state(new State(file));
+    IndexFactory factory;
+    {
+        FrReadGuard guard(lock_);
+        factory = factory_;
+    }
+    if (withIndex && factory) {
+        // Nobody else sees the state yet, no lock needed.
+        state->index = factory(state.get());
+        for (size_t row = 0; state->index && row < state->baseRows; row++) {
+            state->index->add(static_cast<uint32_t>(row));
+        }
+        std::unique_ptr<FrAnnTrainer> trainer = state->index
+                        ? state->index->startTraining() : nullptr;
+        if (trainer) {
+            trainer->run();
+            state->index->finishTraining(std::move(trainer));
+        }
+    }
+    return state;
+}
+
+void FrGallery::commit(std::shared_ptr<State> state,
+                        const std::vector<FrGalleryOp> &ops, bool train) {
+    {
+        FrWriteGuard guard(lock_);
+        alignas(kAlignment) float normed[HIAR_FACE_FEATURE_LEN];
+        for (const FrGalleryOp &op : ops) {
+            if (op.remove) {
+                state->remove(op.id);
+            } else if (frNormalize(op.feature.data(), normed,
+                                    HIAR_FACE_FEATURE_LEN)) {
+                state->enroll(op.id, normed);
+            }
+        }
+        state_ = state;
+    }
+    if (train) {
+        this->train();
+    }
+}
+
+std::shared_ptr<const FrGallery::State> FrGallery::snapshot() const {
+    FrReadGuard guard(lock_);
+    return state_->clone();
+}
+
+bool FrGallery::save(const State &state, const std::string &path,
+                    uint64_t walSeq, std::string *error) {
+    FrGalleryFileWriter writer(path);
+    for (size_t row = 0; row < state.rows(); row++) {
+        if (state.alive(row) && !writer.add(state.idOf(row),
+                                            state.feature(row))) {
+            break;
+        }
+    }
+    return writer.finish(walSeq, error);
+}
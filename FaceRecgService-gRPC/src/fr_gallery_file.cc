@@ -0,0 +1,311 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	On-disk gallery snapshot, mapped read-only at startup.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_gallery_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#include "fr_hash.h"
+
+namespace {
+
+const char kMagic[8] = {'F', 'R', 'G', 'A', 'L', 'L', 'R', 'Y'};
+/// Header size and alignment of the feature matrix.
+const size_t kPage = 4096;
+
+/// First page of a gallery file.
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t featureLen;
+    uint64_t rows;
+    uint64_t walSeq;
+    uint64_t featuresOffset;
+    uint64_t idOffsetsOffset;
+    uint64_t idBlobOffset;
+    uint64_t idBlobBytes;
+    uint64_t idIndexOffset;
+    uint64_t fileBytes;
+    /// Chained hash of the feature rows.
+    uint64_t featuresChecksum;
+    /// Hash of the id offsets, blob and index.
+    uint64_t tablesChecksum;
+    /// Hash of the fields above.
+    uint64_t headerChecksum;
+};
+
+uint64_t headerChecksum(const FileHeader &header) {
+    return frHash64(&header, offsetof(FileHeader, headerChecksum));
+}
+
+uint64_t featureChecksum(const float *feature, uint64_t chained) {
+    return frHash64(feature, HIAR_FACE_FEATURE_LEN * sizeof(float), chained);
+}
+
+uint64_t idHash(const char *id, size_t len) {
+    return frHash64(id, len);
+}
+
+/// Write all bytes or fail.
+bool writeAll(FILE *file, const void *data, size_t len) {
+    return len == fwrite(data, 1, len, file);
+}
+
+/// Make a rename in the directory of path durable.
+void syncDirOf(const std::string &path) {
+    size_t slash = path.rfind('/');
+    std::string dir = std::string::npos == slash
+                        ? "." : path.substr(0, slash + 1);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (0 <= fd) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+} // namespace
+
+std::shared_ptr<const FrGalleryFile> FrGalleryFile::open(
+                                        const std::string &path,
+                                        bool verify, std::string *error) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (0 > fd) {
+        *error = "cannot open " + path + ": " + strerror(errno);
+        return nullptr;
+    }
+    struct stat st;
+    if (0 != fstat(fd, &st) || static_cast<size_t>(st.st_size) < kPage) {
+        close(fd);
+        *error = path + " is too short";
+        return nullptr;
+    }
+    size_t bytes = static_cast<size_t>(st.st_size);
+    void *map = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == map) {
+        *error = "cannot map " + path + ": " + strerror(errno);
+        return nullptr;
+    }
+    std::shared_ptr<FrGalleryFile> file(new FrGalleryFile());
+    file->map_ = map;
+    file->mapBytes_ = bytes;
+
+    FileHeader header;
+    memcpy(&header, map, sizeof(header));
+    if (0 != memcmp(header.magic, kMagic, sizeof(kMagic))
+        || headerChecksum(header) != header.headerChecksum) {
+        *error = path + " is not a gallery file";
+        return nullptr;
+    }
+    if (kVersion != header.version
+        || HIAR_FACE_FEATURE_LEN != header.featureLen) {
+        *error = path + " has version " + std::to_string(header.version)
+                    + " and features of "
+                    + std::to_string(header.featureLen) + " floats";
+        return nullptr;
+    }
+    uint64_t featureBytes = header.rows * HIAR_FACE_FEATURE_LEN * sizeof(float);
+    if (header.fileBytes != bytes
+        || header.featuresOffset + featureBytes > header.idOffsetsOffset
+        || header.idOffsetsOffset + (header.rows + 1) * sizeof(uint64_t)
+            > header.idBlobOffset
+        || header.idBlobOffset + header.idBlobBytes > header.idIndexOffset
+        || header.idIndexOffset + 2 * header.rows * sizeof(uint64_t) > bytes) {
+        *error = path + " is truncated";
+        return nullptr;
+    }
+
+    const char *base = static_cast<const char*>(map);
+    uint64_t tablesChecksum = frHash64(base + header.idOffsetsOffset,
+                                        bytes - header.idOffsetsOffset);
+    if (tablesChecksum != header.tablesChecksum) {
+        *error = path + " has corrupted id tables";
+        return nullptr;
+    }
+    file->rows_ = header.rows;
+    file->walSeq_ = header.walSeq;
+    file->features_ = reinterpret_cast<const float*>(
+                                            base + header.featuresOffset);
+    file->idOffsets_ = reinterpret_cast<const uint64_t*>(
+                                            base + header.idOffsetsOffset);
+    file->idBlob_ = base + header.idBlobOffset;
+    file->idIndex_ = reinterpret_cast<const uint64_t*>(
+                                            base + header.idIndexOffset);
+    if (file->idOffsets_[header.rows] != header.idBlobBytes) {
+        *error = path + " has corrupted id tables";
+        return nullptr;
+    }
+
+    if (verify) {
+        uint64_t checksum = 0;
+        for (size_t row = 0; row < file->rows_; row++) {
+            checksum = featureChecksum(file->feature(row), checksum);
+        }
+        if (checksum != header.featuresChecksum) {
+            *error = path + " has corrupted features";
+            return nullptr;
+        }
+    } else {
+        // Start reading the matrix ahead of the first searches.
+        madvise(const_cast<char*>(base) + header.featuresOffset,
+                featureBytes, MADV_WILLNEED);
+    }
+    return file;
+}
+
+FrGalleryFile::~FrGalleryFile() {
+    if (nullptr != map_) {
+        munmap(map_, mapBytes_);
+    }
+}
+
+std::string FrGalleryFile::idOf(size_t row) const {
+    return std::string(idBlob_ + idOffsets_[row],
+                        idOffsets_[row + 1] - idOffsets_[row]);
+}
+
+bool FrGalleryFile::find(const std::string &id, size_t *row) const {
+    uint64_t hash = idHash(id.data(), id.size());
+    // Binary search of the first pair with this hash.
+    size_t lo = 0;
+    size_t hi = rows_;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idIndex_[2 * mid] < hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (; lo < rows_ && idIndex_[2 * lo] == hash; lo++) {
+        size_t candidate = idIndex_[2 * lo + 1];
+        size_t len = idOffsets_[candidate + 1] - idOffsets_[candidate];
+        if (len == id.size()
+            && 0 == memcmp(idBlob_ + idOffsets_[candidate], id.data(), len)) {
+            *row = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+FrGalleryFileWriter::FrGalleryFileWriter(const std::string &path)
+        : path_(path), tmpPath_(path + ".tmp") {
+    file_ = fopen(tmpPath_.c_str(), "wb");
+    failed_ = nullptr == file_;
+    // The header is written last, features start on the second page.
+    if (!failed_) {
+        failed_ = 0 != fseek(file_, kPage, SEEK_SET);
+    }
+    idOffsets_.push_back(0);
+}
+
+FrGalleryFileWriter::~FrGalleryFileWriter() {
+    if (nullptr != file_) {
+        fclose(file_);
+        unlink(tmpPath_.c_str());
+    }
+}
+
+bool FrGalleryFileWriter::add(const std::string &id, const float *feature) {
+    if (failed_) {
+        return false;
+    }
+    failed_ = !writeAll(file_, feature, HIAR_FACE_FEATURE_LEN * sizeof(float));
+    featuresChecksum_ = featureChecksum(feature, featuresChecksum_);
+    idBlob_ += id;
+    idOffsets_.push_back(idBlob_.size());
+    return !failed_;
+}
+
+bool FrGalleryFileWriter::finish(uint64_t walSeq, std::string *error) {
+    if (failed_) {
+        *error = "cannot write " + tmpPath_ + ": " + strerror(errno);
+        return false;
+    }
+    size_t rows = idOffsets_.size() - 1;
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = FrGalleryFile::kVersion;
+    header.featureLen = HIAR_FACE_FEATURE_LEN;
+    header.rows = rows;
+    header.walSeq = walSeq;
+    header.featuresOffset = kPage;
+    header.idOffsetsOffset = kPage
+                            + rows * HIAR_FACE_FEATURE_LEN * sizeof(float);
+    header.idBlobOffset = header.idOffsetsOffset
+                            + idOffsets_.size() * sizeof(uint64_t);
+    header.idBlobBytes = idBlob_.size();
+    // Keep the index 8-byte aligned.
+    header.idIndexOffset = (header.idBlobOffset + idBlob_.size() + 7) & ~7ULL;
+    header.fileBytes = header.idIndexOffset + 2 * rows * sizeof(uint64_t);
+    header.featuresChecksum = featuresChecksum_;
+
+    std::vector<std::pair<uint64_t, uint64_t>> index(rows);
+    for (size_t row = 0; row < rows; row++) {
+        index[row].first = idHash(idBlob_.data() + idOffsets_[row],
+                                idOffsets_[row + 1] - idOffsets_[row]);
+        index[row].second = row;
+    }
+    std::sort(index.begin(), index.end());
+
+    // Tables are hashed as laid out in the file, padding included.
+    std::string tables(header.fileBytes - header.idOffsetsOffset, '\0');
+    char *cursor = &tables[0];
+    memcpy(cursor, idOffsets_.data(), idOffsets_.size() * sizeof(uint64_t));
+    memcpy(cursor + header.idBlobOffset - header.idOffsetsOffset,
+            idBlob_.data(), idBlob_.size());
+    uint64_t *pairs = reinterpret_cast<uint64_t*>(
+                    cursor + header.idIndexOffset - header.idOffsetsOffset);
+    for (size_t row = 0; row < rows; row++) {
+        pairs[2 * row] = index[row].first;
+        pairs[2 * row + 1] = index[row].second;
+    }
+    header.tablesChecksum = frHash64(tables.data(), tables.size());
+    header.headerChecksum = headerChecksum(header);
+
+    std::string page(kPage, '\0');
+    memcpy(&page[0], &header, sizeof(header));
+    bool ok = writeAll(file_, tables.data(), tables.size())
+                && 0 == fseek(file_, 0, SEEK_SET)
+                && writeAll(file_, page.data(), page.size())
+                && 0 == fflush(file_)
+                && 0 == fsync(fileno(file_));
+    ok = 0 == fclose(file_) && ok;
+    file_ = nullptr;
+    if (!ok || 0 != rename(tmpPath_.c_str(), path_.c_str())) {
+        *error = "cannot write " + path_ + ": " + strerror(errno);
+        unlink(tmpPath_.c_str());
+        return false;
+    }
+    syncDirOf(path_);
+    return true;
+}
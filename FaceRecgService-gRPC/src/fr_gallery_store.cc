@@ -0,0 +1,211 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Persistence of a gallery: file, write-ahead log and compaction.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_gallery_store.h"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "fr_feature_math.h"
+
+FrGalleryStore::FrGalleryStore(FrGallery *gallery, const std::string &path,
+                                const FrGalleryStoreOptions &options)
+        : gallery_(gallery), path_(path), options_(options),
+        wal_(path + ".wal", options.syncWal) {
+}
+
+FrGalleryStore::~FrGalleryStore() {
+    {
+        std::lock_guard<std::mutex> lock(workMutex_);
+        stopping_ = true;
+    }
+    workCv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+bool FrGalleryStore::open(std::string *error) {
+    std::shared_ptr<const FrGalleryFile> file;
+    if (0 == access(path_.c_str(), F_OK)) {
+        file = FrGalleryFile::open(path_, options_.verify, error);
+        if (!file) {
+            return false;
+        }
+    }
+    if (!wal_.open(error)) {
+        return false;
+    }
+    uint64_t fileSeq = file ? file->walSeq() : 0;
+    std::vector<FrGalleryOp> ops;
+    wal_.readAll(fileSeq, &ops);
+    lastSeq_ = ops.empty() ? fileSeq : ops.back().seq;
+
+    // Serve at once; without a file the log alone is quick to index.
+    auto begin = std::chrono::steady_clock::now();
+    gallery_->commit(gallery_->prepare(file, !file), ops);
+    std::cout << "Gallery " << path_ << ": "
+                << (file ? file->rows() : 0) << " faces in file, "
+                << ops.size() << " changes in log, loaded in "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - begin).count()
+                << " ms" << std::endl;
+
+    worker_ = std::thread(&FrGalleryStore::run, this, file);
+    return true;
+}
+
+bool FrGalleryStore::enroll(const std::string &id, const float *feature) {
+    float normed[HIAR_FACE_FEATURE_LEN];
+    if (!frNormalize(feature, normed, HIAR_FACE_FEATURE_LEN)) {
+        return false;
+    }
+    FrGalleryOp op;
+    op.id = id;
+    op.feature.assign(feature, feature + HIAR_FACE_FEATURE_LEN);
+
+    bool compact = false;
+    {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        op.seq = lastSeq_ + 1;
+        if (!wal_.append(op)) {
+            std::cout << "Gallery log write failed, " << id
+                        << " not enrolled!!!" << std::endl;
+            return false;
+        }
+        lastSeq_ = op.seq;
+        gallery_->enroll(id, feature, false);
+        compact = wal_.bytes() >= options_.compactBytes;
+    }
+    // An index due for training is trained by the worker, writers go on.
+    std::lock_guard<std::mutex> lock(workMutex_);
+    trainWanted_ = true;
+    compactWanted_ = compactWanted_ || compact;
+    workCv_.notify_one();
+    return true;
+}
+
+bool FrGalleryStore::remove(const std::string &id) {
+    FrGalleryOp op;
+    op.remove = true;
+    op.id = id;
+
+    bool removed;
+    {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        op.seq = lastSeq_ + 1;
+        if (!wal_.append(op)) {
+            std::cout << "Gallery log write failed, " << id
+                        << " not removed!!!" << std::endl;
+            return false;
+        }
+        lastSeq_ = op.seq;
+        removed = gallery_->remove(id);
+    }
+    // Removals count towards a retraining too.
+    std::lock_guard<std::mutex> lock(workMutex_);
+    trainWanted_ = true;
+    workCv_.notify_one();
+    return removed;
+}
+
+void FrGalleryStore::run(std::shared_ptr<const FrGalleryFile> file) {
+    if (file) {
+        reload(file);
+    }
+    file.reset();
+
+    while (true) {
+        bool compactNow;
+        {
+            std::unique_lock<std::mutex> lock(workMutex_);
+            workCv_.wait(lock, [this]() {
+                return stopping_ || compactWanted_ || trainWanted_;
+            });
+            if (stopping_) {
+                return;
+            }
+            compactNow = compactWanted_;
+            compactWanted_ = false;
+            trainWanted_ = false;
+        }
+        if (!compactNow) {
+            // Nothing to do unless the index is due, see startTraining().
+            gallery_->train();
+            continue;
+        }
+        // The reload trains the new index.
+        std::string error;
+        if (!compact(&error)) {
+            std::cout << "Gallery compaction failed: " << error << std::endl;
+            gallery_->train();
+        }
+    }
+}
+
+void FrGalleryStore::reload(std::shared_ptr<const FrGalleryFile> file) {
+    auto begin = std::chrono::steady_clock::now();
+    // The slow part, indexing the file, runs before taking any lock.
+    std::shared_ptr<FrGallery::State> state = gallery_->prepare(file, true);
+
+    std::unique_lock<std::mutex> lock(writeMutex_);
+    std::vector<FrGalleryOp> ops;
+    wal_.readAll(file->walSeq(), &ops);
+    gallery_->commit(state, ops, false);
+    lock.unlock();
+    gallery_->train();
+    std::cout << "Gallery " << path_ << " ready: "
+                << gallery_->describeIndex() << ", "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - begin).count()
+                << " ms" << std::endl;
+}
+
+bool FrGalleryStore::compact(std::string *error) {
+    std::shared_ptr<const FrGallery::State> snapshot;
+    uint64_t seq;
+    {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        if (!wal_.rotate()) {
+            *error = "cannot rotate the log";
+            return false;
+        }
+        seq = lastSeq_;
+        snapshot = gallery_->snapshot();
+    }
+    if (!FrGallery::save(*snapshot, path_, seq, error)) {
+        return false;
+    }
+    snapshot.reset();
+
+    std::shared_ptr<const FrGalleryFile> file = FrGalleryFile::open(
+                                                    path_, false, error);
+    if (!file) {
+        return false;
+    }
+    reload(file);
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    wal_.dropRotated();
+    return true;
+}
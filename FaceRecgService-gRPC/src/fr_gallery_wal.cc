@@ -0,0 +1,222 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Append-only write-ahead log of gallery changes.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_gallery_wal.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "interface_face_recognizer.h"
+#include "fr_hash.h"
+
+namespace {
+
+const uint32_t kRecordMagic = 0x4c575246;  // "FRWL"
+const uint8_t kEnroll = 1;
+const uint8_t kRemove = 2;
+
+/// Precedes each payload.
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t payloadBytes;
+    uint64_t checksum;
+};
+
+/// Write all bytes or fail.
+bool writeAll(int fd, const char *data, size_t len) {
+    while (0 < len) {
+        ssize_t written = write(fd, data, len);
+        if (0 > written) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        len -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+void appendBytes(std::string *out, const void *data, size_t len) {
+    out->append(static_cast<const char*>(data), len);
+}
+
+} // namespace
+
+FrGalleryWal::FrGalleryWal(const std::string &path, bool sync)
+        : path_(path), sync_(sync) {
+}
+
+FrGalleryWal::~FrGalleryWal() {
+    if (0 <= fd_) {
+        close(fd_);
+    }
+}
+
+bool FrGalleryWal::open(std::string *error) {
+    std::vector<FrGalleryOp> ignored;
+    size_t valid = readFile(path_, 0, &ignored);
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    // A torn record at the end would hide the records appended after it.
+    if (0 > fd_ || 0 != ftruncate(fd_, static_cast<off_t>(valid))
+        || 0 > lseek(fd_, 0, SEEK_END)) {
+        *error = "cannot open " + path_ + ": " + strerror(errno);
+        return false;
+    }
+    bytes_ = valid;
+    return true;
+}
+
+bool FrGalleryWal::append(const FrGalleryOp &op) {
+    std::string payload;
+    uint8_t type = op.remove ? kRemove : kEnroll;
+    uint32_t idBytes = static_cast<uint32_t>(op.id.size());
+    appendBytes(&payload, &op.seq, sizeof(op.seq));
+    appendBytes(&payload, &type, sizeof(type));
+    appendBytes(&payload, &idBytes, sizeof(idBytes));
+    payload += op.id;
+    if (!op.remove) {
+        appendBytes(&payload, op.feature.data(),
+                    HIAR_FACE_FEATURE_LEN * sizeof(float));
+    }
+
+    RecordHeader header;
+    header.magic = kRecordMagic;
+    header.payloadBytes = static_cast<uint32_t>(payload.size());
+    header.checksum = frHash64(payload.data(), payload.size());
+    std::string record(reinterpret_cast<const char*>(&header), sizeof(header));
+    record += payload;
+    if (!writeAll(fd_, record.data(), record.size())
+        || (sync_ && 0 != fdatasync(fd_))) {
+        return false;
+    }
+    bytes_ += record.size();
+    return true;
+}
+
+bool FrGalleryWal::rotate() {
+    std::string rotated = path_ + ".1";
+    struct stat st;
+    if (0 == stat(rotated.c_str(), &st)) {
+        // Not compacted yet, keep its records before the current ones.
+        std::ifstream in(path_, std::ios::binary);
+        std::string records((std::istreambuf_iterator<char>(in)),
+                            std::istreambuf_iterator<char>());
+        records.resize(std::min(records.size(), bytes_));
+        // As in open(), a torn record at its end would hide the records
+        // appended after it.
+        std::vector<FrGalleryOp> ignored;
+        size_t valid = readFile(rotated, 0, &ignored);
+        int out = ::open(rotated.c_str(), O_WRONLY | O_CLOEXEC);
+        if (0 > out) {
+            return false;
+        }
+        // The records must be on disk before they leave the live log.
+        bool copied = 0 == ftruncate(out, static_cast<off_t>(valid))
+                        && 0 <= lseek(out, 0, SEEK_END)
+                        && writeAll(out, records.data(), records.size())
+                        && 0 == fsync(out);
+        close(out);
+        if (!copied) {
+            return false;
+        }
+        // Without the seek the next record would land past a hole of
+        // zeros, where replay stops.
+        if (0 != ftruncate(fd_, 0) || 0 > lseek(fd_, 0, SEEK_SET)) {
+            return false;
+        }
+    } else {
+        if (0 != rename(path_.c_str(), rotated.c_str())) {
+            return false;
+        }
+        close(fd_);
+        fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    0644);
+        if (0 > fd_) {
+            return false;
+        }
+    }
+    bytes_ = 0;
+    return true;
+}
+
+void FrGalleryWal::dropRotated() {
+    unlink((path_ + ".1").c_str());
+}
+
+void FrGalleryWal::readAll(uint64_t afterSeq,
+                            std::vector<FrGalleryOp> *ops) const {
+    readFile(path_ + ".1", afterSeq, ops);
+    readFile(path_, afterSeq, ops);
+}
+
+size_t FrGalleryWal::readFile(const std::string &path, uint64_t afterSeq,
+                                std::vector<FrGalleryOp> *ops) {
+    std::ifstream in(path, std::ios::binary);
+    size_t valid = 0;
+    RecordHeader header;
+    std::string payload;
+    while (in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        const size_t fixedBytes = sizeof(uint64_t) + 1 + sizeof(uint32_t);
+        if (kRecordMagic != header.magic || fixedBytes > header.payloadBytes) {
+            break;
+        }
+        payload.resize(header.payloadBytes);
+        if (!in.read(&payload[0], payload.size())
+            || frHash64(payload.data(), payload.size()) != header.checksum) {
+            break;
+        }
+
+        FrGalleryOp op;
+        uint8_t type;
+        uint32_t idBytes;
+        const char *cursor = payload.data();
+        memcpy(&op.seq, cursor, sizeof(op.seq));
+        memcpy(&type, cursor + sizeof(op.seq), sizeof(type));
+        memcpy(&idBytes, cursor + sizeof(op.seq) + 1, sizeof(idBytes));
+        size_t featureBytes = kEnroll == type
+                            ? HIAR_FACE_FEATURE_LEN * sizeof(float) : 0;
+        if (fixedBytes + idBytes + featureBytes != payload.size()) {
+            break;
+        }
+        valid += sizeof(header) + payload.size();
+        if (op.seq <= afterSeq) {
+            continue;
+        }
+        op.remove = kRemove == type;
+        op.id.assign(cursor + fixedBytes, idBytes);
+        if (!op.remove) {
+            op.feature.resize(HIAR_FACE_FEATURE_LEN);
+            memcpy(op.feature.data(), cursor + fixedBytes + idBytes,
+                    featureBytes);
+        }
+        ops->push_back(std::move(op));
+    }
+    return valid;
+}
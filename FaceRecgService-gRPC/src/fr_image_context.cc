@@ -0,0 +1,210 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Image of one request, decoded once for all the SDK calls on it.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_image_context.h"
+
+#include <chrono>
+#include <climits>
+
+#include <opencv2/imgcodecs/legacy/constants_c.h>
+
+namespace {
+
+/// Transcoded images a thread keeps for its next ones.
+const size_t kCachedBuffers = 2;
+
+/**
+ * Buffers of the transcoded images freed by this thread. The BMP of a
+ * photo is megabytes, a new one is faulted in page by page; reused, its
+ * pages stay mapped on the node of the thread.
+ */
+thread_local std::vector<std::vector<uchar>> freeBuffers;
+
+/// Files starting with "BM" are already uncompressed.
+bool isBmp(const unsigned char *data, int len) {
+    return 2 <= len && 'B' == data[0] && 'M' == data[1];
+}
+
+} // namespace
+
+bool frWrapPixels(const unsigned char *data, size_t len, int width,
+                    int height, int stride, FrPixelFormat format,
+                    cv::Mat *bgr) {
+    if (0 >= width || 0 >= height) {
+        return false;
+    }
+    int channels = kFrPixelBgr == format || kFrPixelRgb == format ? 3 : 1;
+    size_t rows = static_cast<size_t>(height);
+    size_t rowBytes = static_cast<size_t>(width) * channels;
+    size_t step = 0 == stride ? rowBytes : static_cast<size_t>(stride);
+    if (0 > stride || step < rowBytes) {
+        return false;
+    }
+    if (kFrPixelNv12 == format) {
+        // Chroma is subsampled by 2 both ways: height rows of Y then
+        // height / 2 rows of UV.
+        if (0 != width % 2 || 0 != height % 2) {
+            return false;
+        }
+        rows += rows / 2;
+    }
+    // len >= step * (rows - 1) + rowBytes, without overflowing.
+    if (INT_MAX < rows || len < rowBytes
+        || (len - rowBytes) / step < rows - 1) {
+        return false;
+    }
+    // NV12 is exactly its planes, the last row maybe without its padding.
+    if (kFrPixelNv12 == format && len != step * rows
+        && len != step * (rows - 1) + rowBytes) {
+        return false;
+    }
+    try {
+        // Wraps the bytes, no copy.
+        cv::Mat raw(static_cast<int>(rows), width,
+                    3 == channels ? CV_8UC3 : CV_8UC1,
+                    const_cast<unsigned char*>(data), step);
+        switch (format) {
+            case kFrPixelBgr:
+                *bgr = raw;
+                break;
+            case kFrPixelRgb:
+                cv::cvtColor(raw, *bgr, cv::COLOR_RGB2BGR);
+                break;
+            case kFrPixelGray:
+                cv::cvtColor(raw, *bgr, cv::COLOR_GRAY2BGR);
+                break;
+            case kFrPixelNv12:
+                cv::cvtColor(raw, *bgr, cv::COLOR_YUV2BGR_NV12);
+                break;
+            default:
+                return false;
+        }
+    } catch (const cv::Exception&) {
+        // Geometry OpenCV still refuses, e.g. too large.
+        return false;
+    }
+    return true;
+}
+
+FrImageContext::FrImageContext(const unsigned char *data, int len,
+                                int sdkCalls, bool decodeOnce)
+        : data_(data), len_(len),
+        transcode_(decodeOnce && 1 < sdkCalls && !isBmp(data, len)) {
+}
+
+FrImageContext::FrImageContext(const cv::Mat &bgr, double wrapMs)
+        : data_(nullptr), len_(0), transcode_(true), decoded_(true),
+        pixels_(bgr), decodeMs_(wrapMs) {
+}
+
+FrImageContext::~FrImageContext() {
+    if (0 != sdkImage_.capacity() && freeBuffers.size() < kCachedBuffers) {
+        sdkImage_.clear();
+        freeBuffers.push_back(std::move(sdkImage_));
+    }
+}
+
+const cv::Mat& FrImageContext::pixels() {
+    if (!decoded_) {
+        decoded_ = true;
+        auto begin = std::chrono::steady_clock::now();
+        // Wraps the bytes, no copy.
+        cv::Mat encoded(1, len_, CV_8UC1,
+                        const_cast<unsigned char*>(data_));
+        pixels_ = cv::imdecode(encoded, CV_LOAD_IMAGE_COLOR);
+        decodeMs_ += std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - begin).count();
+    }
+    return pixels_;
+}
+
+const unsigned char* FrImageContext::sdkData() {
+    transcode();
+    return sdkImage_.empty() ? data_ : sdkImage_.data();
+}
+
+int FrImageContext::sdkLen() {
+    transcode();
+    return sdkImage_.empty() ? len_ : static_cast<int>(sdkImage_.size());
+}
+
+const FrContentHash& FrImageContext::contentHash() {
+    if (hashed_) {
+        return hash_;
+    }
+    hashed_ = true;
+    if (nullptr != data_) {
+        hash_ = frHash128(data_, len_);
+        return hash_;
+    }
+    // Rows one by one, they may be strided.
+    int32_t dims[3] = {pixels_.rows, pixels_.cols, pixels_.type()};
+    hash_ = frHash128(dims, sizeof(dims));
+    for (int r = 0; r < pixels_.rows; r++) {
+        hash_ = frHash128(pixels_.ptr(r), pixels_.cols * pixels_.elemSize(),
+                        hash_);
+    }
+    return hash_;
+}
+
+void FrImageContext::transcode() {
+    if (!transcode_ || transcoded_) {
+        return;
+    }
+    transcoded_ = true;
+    const cv::Mat &image = pixels();
+    if (image.empty()) {
+        // Let the SDK report the bad image as before.
+        return;
+    }
+    auto begin = std::chrono::steady_clock::now();
+    if (!freeBuffers.empty()) {
+        sdkImage_.swap(freeBuffers.back());
+        freeBuffers.pop_back();
+    }
+    if (!cv::imencode(".bmp", image, sdkImage_)) {
+        sdkImage_.clear();
+    }
+    decodeMs_ += std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - begin).count();
+}
+
+int FrFace_extractFeature(FrImageContext &image, const int *face_bboxes,
+                        const int num_bbox, float **feature,
+                        int *len_features) {
+    return HiarFace_extractFeature(image.sdkData(), image.sdkLen(),
+                                face_bboxes, num_bbox, feature, len_features);
+}
+
+int FrFace_detectAndExtractFeature(FrImageContext &image, int **face_bboxes,
+                                int *num_bbox, float **feature,
+                                int *len_features) {
+    return HiarFace_detectAndExtractFeature(image.sdkData(), image.sdkLen(),
+                                face_bboxes, num_bbox, feature, len_features);
+}
+
+int FrFace_getQualityFaceCrops(FrImageContext &image, const int *face_bboxes,
+                                const int num_bbox, int *face_quality,
+                                float *face_direction) {
+    return HiarFace_getQualityFaceCrops(image.sdkData(), image.sdkLen(),
+                                face_bboxes, num_bbox, face_quality,
+                                face_direction);
+}
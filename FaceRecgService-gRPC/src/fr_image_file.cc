@@ -0,0 +1,59 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Loading of image files into the bytes fields of requests.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_image_file.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+bool frLoadImage(const std::string &path, std::string *bytes) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (0 > fd) {
+        return false;
+    }
+    struct stat st;
+    if (0 != fstat(fd, &st) || 0 >= st.st_size) {
+        close(fd);
+        return false;
+    }
+    // Read straight into the field, sized once: a mapping would still be
+    // copied into it.
+    size_t size = static_cast<size_t>(st.st_size);
+    bytes->resize(size);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t got = read(fd, &(*bytes)[done], size - done);
+        if (0 > got && EINTR == errno) {
+            continue;
+        }
+        if (0 >= got) {
+            break;
+        }
+        done += static_cast<size_t>(got);
+    }
+    close(fd);
+    // Shrunk meanwhile, or unreadable.
+    bytes->resize(done);
+    return size == done;
+}
@@ -0,0 +1,465 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Load generator of the client, for capacity planning.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_loadgen.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <grpcpp/grpcpp.h>
+
+#include "FaceRecg.grpc.pb.h"
+#include "fr_arena.h"
+#include "fr_histogram.h"
+#include "fr_image_file.h"
+
+using grpc::ClientContext;
+using grpc::Status;
+
+using facerecg::Frecg;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+enum Kind {
+    kLogIn,
+    kFeatureDetect,
+    kFeatureExtract,
+    kGetFaceQuality,
+    kCompareImage,
+    kIdentify,
+    kKindCount
+};
+
+const char *kKindNames[kKindCount] = {
+    "logIn", "featureDetect", "featureExtract", "getFaceQuality",
+    "compareImage", "identify"
+};
+
+/// Requests of one image, built once and only read by the workers.
+struct Image {
+    std::string name;
+    facerecg::DetectRequest detect;
+    facerecg::FeatureRequest extract;
+    facerecg::QualityRequest quality;
+    facerecg::CmpImageRequest compare;
+    facerecg::IdentifyRequest identify;
+};
+
+struct KindStats {
+    FrHistogram latencyUs;
+    std::atomic<uint64_t> errors;
+    /// Turned away by a full queue of the server.
+    std::atomic<uint64_t> rejected;
+    /// Past their deadline, dropped by the server or timed out.
+    std::atomic<uint64_t> late;
+    KindStats() : errors(0), rejected(0), late(0) {}
+};
+
+std::string jsonString(const std::string &text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if ('"' == c || '\\' == c) {
+            out += '\\';
+        }
+        out += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+    }
+    return out + '"';
+}
+
+/// Latencies of a histogram in microseconds, as a JSON object in ms.
+void jsonLatency(std::ostream &os, const FrHistogram &histogram) {
+    os << "{\"mean\": " << histogram.mean() / 1000
+        << ", \"p50\": " << histogram.percentile(0.5) / 1000.0
+        << ", \"p90\": " << histogram.percentile(0.9) / 1000.0
+        << ", \"p99\": " << histogram.percentile(0.99) / 1000.0
+        << ", \"p999\": " << histogram.percentile(0.999) / 1000.0
+        << ", \"max\": " << histogram.max() / 1000.0 << '}';
+}
+
+class FrLoad {
+    public:
+        explicit FrLoad(const FrLoadOptions &options) : options_(options) {}
+
+        bool run(std::ostream &report) {
+            if (!parseMix() || !loadImages()) {
+                return false;
+            }
+            for (int i = 0; i < std::max(1, options_.channels); i++) {
+                // Distinct arguments keep gRPC from sharing one connection.
+                grpc::ChannelArguments args;
+                args.SetInt("fr_load_channel", i);
+                stubs_.push_back(Frecg::NewStub(grpc::CreateCustomChannel(
+                                    options_.target,
+                                    grpc::InsecureChannelCredentials(),
+                                    args)));
+            }
+            if (!warmUp()) {
+                return false;
+            }
+
+            auto begin = Clock::now();
+            end_ = begin + std::chrono::microseconds(
+                        static_cast<int64_t>(options_.duration * 1e6));
+            std::vector<std::thread> workers;
+            for (int i = 0; i < std::max(1, options_.concurrency); i++) {
+                if ("open" == options_.mode) {
+                    workers.emplace_back(&FrLoad::openWorker, this, i, begin);
+                } else {
+                    workers.emplace_back(&FrLoad::closedWorker, this, i);
+                }
+            }
+            for (auto &worker : workers) {
+                worker.join();
+            }
+            double elapsed = std::chrono::duration<double>(
+                                Clock::now() - begin).count();
+            writeReport(report, elapsed);
+            return true;
+        }
+
+    private:
+        bool parseMix() {
+            std::stringstream mix(options_.mix);
+            std::string item;
+            while (std::getline(mix, item, ',')) {
+                size_t colon = item.find(':');
+                std::string name = item.substr(0, colon);
+                int weight = std::string::npos == colon
+                                ? 1 : std::stoi(item.substr(colon + 1));
+                int kind = 0;
+                while (kind < kKindCount && name != kKindNames[kind]) {
+                    kind++;
+                }
+                if (kKindCount == kind) {
+                    std::cout << "Unknown rpc in mix: " << name << std::endl;
+                    return false;
+                }
+                if (0 < weight) {
+                    inMix_[kind] = true;
+                    totalWeight_ += weight;
+                    mix_.push_back(std::make_pair(static_cast<Kind>(kind),
+                                                    totalWeight_));
+                    needFaces_ |= kLogIn != kind && kFeatureDetect != kind;
+                }
+            }
+            if (mix_.empty()) {
+                std::cout << "Empty rpc mix!!!" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        bool loadImages() {
+            DIR *dir = opendir(options_.images.c_str());
+            if (nullptr == dir) {
+                std::cout << "Cannot open " << options_.images << std::endl;
+                return false;
+            }
+            std::vector<std::string> names;
+            while (dirent *entry = readdir(dir)) {
+                std::string path = options_.images + "/" + entry->d_name;
+                struct stat st;
+                if (0 == stat(path.c_str(), &st) && S_ISREG(st.st_mode)) {
+                    names.push_back(path);
+                }
+            }
+            closedir(dir);
+            std::sort(names.begin(), names.end());
+            for (const auto &name : names) {
+                std::unique_ptr<Image> image(new Image);
+                image->name = name;
+                if (!frLoadImage(name, image->detect.mutable_imagedata())) {
+                    continue;
+                }
+                image->detect.set_message(name);
+                images_.push_back(std::move(image));
+            }
+            if (images_.empty()) {
+                std::cout << "No image in " << options_.images << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        /// Detect the faces of every image and build the other requests.
+        bool warmUp() {
+            facerecg::LogRequest login;
+            login.set_message("fr_load");
+            facerecg::LogReply logReply;
+            ClientContext loginContext;
+            Status status = stubs_[0]->logIn(&loginContext, login, &logReply);
+            if (!status.ok()) {
+                std::cout << "Server unreachable: " << status.error_message()
+                            << std::endl;
+                return false;
+            }
+            serverVersion_ = logReply.algversion();
+
+            for (auto &image : images_) {
+                facerecg::FeatureReply reply;
+                ClientContext context;
+                if (!stubs_[0]->featureDetect(&context, image->detect,
+                                                &reply).ok()
+                    || reply.rects().empty()) {
+                    continue;
+                }
+                faced_.push_back(image.get());
+                if (!needFaces_) {
+                    // Spare the copies of the image.
+                    continue;
+                }
+                const std::string &data = image->detect.imagedata();
+                image->extract.set_imagedata(data);
+                image->quality.set_imagedata(data);
+                for (const auto &rect : reply.rects()) {
+                    *image->extract.add_rects() = rect;
+                    *image->quality.add_rects() = rect;
+                }
+                image->compare.set_imagedataa(data);
+                image->compare.set_imagedatab(data);
+                *image->compare.mutable_recta() = reply.rects(0);
+                *image->compare.mutable_rectb() = reply.rects(0);
+                int featureLen = reply.features().size()
+                                    / reply.rects().size();
+                for (int j = 0; j < featureLen; j++) {
+                    image->identify.add_feature(reply.features(j));
+                }
+                image->identify.set_topk(5);
+            }
+            std::cout << images_.size() << " images, " << faced_.size()
+                        << " with faces" << std::endl;
+            if (needFaces_ && faced_.empty()) {
+                std::cout << "The mix needs faces, none detected!!!"
+                            << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        Kind pick(std::mt19937 &rng) const {
+            int draw = std::uniform_int_distribution<int>(
+                                            0, totalWeight_ - 1)(rng);
+            for (const auto &entry : mix_) {
+                if (draw < entry.second) {
+                    return entry.first;
+                }
+            }
+            return mix_.back().first;
+        }
+
+        /// Send one request, its latency counting from "since".
+        void send(int worker, std::mt19937 &rng, Clock::time_point since) {
+            Kind kind = pick(rng);
+            bool faced = kLogIn != kind && kFeatureDetect != kind;
+            const Image &image = faced
+                ? *faced_[rng() % faced_.size()]
+                : *images_[rng() % images_.size()];
+            Frecg::Stub *stub = stubs_[worker % stubs_.size()].get();
+
+            ClientContext context;
+            if (0 < options_.deadlineMs) {
+                context.set_deadline(std::chrono::system_clock::now()
+                        + std::chrono::microseconds(static_cast<int64_t>(
+                            options_.deadlineMs * 1000)));
+            }
+            if (!options_.tenant.empty()) {
+                context.AddMetadata("fr-tenant", options_.tenant);
+            }
+            if (!options_.priority.empty()) {
+                context.AddMetadata("fr-priority", options_.priority);
+            }
+            Status status;
+            // Replies are parsed on an arena, its block reused by the thread.
+            FrCallArena arena;
+            switch (kind) {
+                case kLogIn: {
+                    facerecg::LogRequest request;
+                    facerecg::LogReply *reply =
+                            arena.create<facerecg::LogReply>();
+                    request.set_message("fr_load");
+                    status = stub->logIn(&context, request, reply);
+                    break;
+                }
+                case kFeatureDetect: {
+                    facerecg::FeatureReply *reply =
+                            arena.create<facerecg::FeatureReply>();
+                    status = stub->featureDetect(&context, image.detect,
+                                                reply);
+                    break;
+                }
+                case kFeatureExtract: {
+                    facerecg::FeatureReply *reply =
+                            arena.create<facerecg::FeatureReply>();
+                    status = stub->featureExtract(&context, image.extract,
+                                                reply);
+                    break;
+                }
+                case kGetFaceQuality: {
+                    facerecg::QualityReply *reply =
+                            arena.create<facerecg::QualityReply>();
+                    status = stub->getFaceQuality(&context, image.quality,
+                                                reply);
+                    break;
+                }
+                case kCompareImage: {
+                    facerecg::CmpImageReply *reply =
+                            arena.create<facerecg::CmpImageReply>();
+                    status = stub->compareImage(&context, image.compare,
+                                                reply);
+                    break;
+                }
+                default: {
+                    facerecg::IdentifyReply *reply =
+                            arena.create<facerecg::IdentifyReply>();
+                    status = stub->identify(&context, image.identify,
+                                            reply);
+                    break;
+                }
+            }
+            if (status.ok()) {
+                stats_[kind].latencyUs.record(
+                        std::chrono::duration_cast<std::chrono::microseconds>(
+                            Clock::now() - since).count());
+            } else if (grpc::StatusCode::RESOURCE_EXHAUSTED
+                        == status.error_code()) {
+                stats_[kind].rejected.fetch_add(1, std::memory_order_relaxed);
+            } else if (grpc::StatusCode::DEADLINE_EXCEEDED
+                        == status.error_code()) {
+                stats_[kind].late.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                stats_[kind].errors.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void closedWorker(int worker) {
+            std::mt19937 rng(worker);
+            while (Clock::now() < end_) {
+                send(worker, rng, Clock::now());
+            }
+        }
+
+        void openWorker(int worker, Clock::time_point begin) {
+            std::mt19937 rng(worker);
+            const double interval = 1e6 / std::max(options_.qps, 1e-3);
+            while (true) {
+                uint64_t slot = nextSlot_.fetch_add(1);
+                Clock::time_point scheduled = begin
+                        + std::chrono::microseconds(
+                            static_cast<int64_t>(slot * interval));
+                if (scheduled >= end_) {
+                    return;
+                }
+                std::this_thread::sleep_until(scheduled);
+                // Late starts, all workers being busy, count as latency.
+                send(worker, rng, scheduled);
+            }
+        }
+
+        void writeReport(std::ostream &os, double elapsed) const {
+            FrHistogram total;
+            uint64_t errors = 0;
+            uint64_t rejected = 0;
+            uint64_t late = 0;
+            for (int kind = 0; kind < kKindCount; kind++) {
+                total.merge(stats_[kind].latencyUs);
+                errors += stats_[kind].errors.load();
+                rejected += stats_[kind].rejected.load();
+                late += stats_[kind].late.load();
+            }
+            os << "{\"target\": " << jsonString(options_.target)
+                << ", \"server_version\": " << jsonString(serverVersion_)
+                << ", \"mode\": " << jsonString(options_.mode)
+                << ", \"concurrency\": " << options_.concurrency
+                << ", \"qps\": " << ("open" == options_.mode ? options_.qps
+                                                            : 0)
+                << ", \"channels\": " << stubs_.size()
+                << ", \"mix\": " << jsonString(options_.mix)
+                << ", \"deadline_ms\": " << options_.deadlineMs
+                << ", \"tenant\": " << jsonString(options_.tenant)
+                << ", \"priority\": " << jsonString(options_.priority)
+                << ", \"images\": " << images_.size()
+                << ", \"duration_s\": " << elapsed
+                << ", \"requests\": " << total.count()
+                << ", \"errors\": " << errors
+                << ", \"rejected\": " << rejected
+                << ", \"late\": " << late
+                << ", \"throughput_rps\": " << total.count() / elapsed
+                << ", \"latency_ms\": ";
+            jsonLatency(os, total);
+            os << ", \"rpcs\": {";
+            bool first = true;
+            for (int kind = 0; kind < kKindCount; kind++) {
+                if (!inMix_[kind]) {
+                    continue;
+                }
+                const KindStats &stats = stats_[kind];
+                if (!first) {
+                    os << ", ";
+                }
+                first = false;
+                os << jsonString(kKindNames[kind])
+                    << ": {\"requests\": " << stats.latencyUs.count()
+                    << ", \"errors\": " << stats.errors.load()
+                    << ", \"rejected\": " << stats.rejected.load()
+                    << ", \"late\": " << stats.late.load()
+                    << ", \"throughput_rps\": "
+                    << stats.latencyUs.count() / elapsed
+                    << ", \"latency_ms\": ";
+                jsonLatency(os, stats.latencyUs);
+                os << '}';
+            }
+            os << "}}" << std::endl;
+        }
+
+        const FrLoadOptions options_;
+        /// Rpcs with their cumulated weights.
+        std::vector<std::pair<Kind, int>> mix_;
+        int totalWeight_ = 0;
+        bool inMix_[kKindCount] = {};
+        bool needFaces_ = false;
+        std::vector<std::unique_ptr<Image>> images_;
+        /// Images with at least one face.
+        std::vector<const Image*> faced_;
+        std::vector<std::unique_ptr<Frecg::Stub>> stubs_;
+        std::string serverVersion_;
+        Clock::time_point end_;
+        std::atomic<uint64_t> nextSlot_{0};
+        KindStats stats_[kKindCount];
+};
+
+} // namespace
+
+bool frRunLoad(const FrLoadOptions &options, std::ostream &report) {
+    FrLoad load(options);
+    return load.run(report);
+}
@@ -0,0 +1,262 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Counters and latency histograms of the server, in Prometheus
+ *          text format.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_metrics.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+namespace {
+
+const char *kRpcNames[FrMetrics::kRpcCount] = {
+    "logIn", "featureExtract", "featureDetect", "featureStream",
+    "compareFeature", "compareImage", "getFaceQuality",
+    "enroll", "remove", "identify", "getStats",
+    "compareBatch"
+};
+
+const char *kStageNames[FrMetrics::kStageCount] = {
+    "decode", "detect_extract", "extract", "quality", "coalesced"
+};
+
+/// Sum of one histogram over all shards.
+template <class Get>
+void mergeShards(int shards, Get get, FrHistogram *merged) {
+    for (int i = 0; i < shards; i++) {
+        merged->merge(get(i));
+    }
+}
+
+} // namespace
+
+FrMetrics::FrMetrics()
+        : shards_(new Shard[kShards]),
+        start_(std::chrono::steady_clock::now()) {
+    for (int i = 0; i < kShards; i++) {
+        for (int r = 0; r < kRpcCount; r++) {
+            shards_[i].inFlight[r].store(0, std::memory_order_relaxed);
+            shards_[i].faces[r].store(0, std::memory_order_relaxed);
+            shards_[i].skipped[r].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+const char* FrMetrics::rpcName(Rpc rpc) {
+    return kRpcNames[rpc];
+}
+
+const char* FrMetrics::stageName(Stage stage) {
+    return kStageNames[stage];
+}
+
+FrMetrics::Shard& FrMetrics::shard() {
+    static std::atomic<unsigned> nextShard(0);
+    thread_local unsigned idx = nextShard.fetch_add(
+                                    1, std::memory_order_relaxed) % kShards;
+    return shards_[idx];
+}
+
+void FrMetrics::started(Rpc rpc) {
+    shard().inFlight[rpc].fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrMetrics::finished(Rpc rpc, uint64_t us) {
+    Shard &own = shard();
+    // A stream may end on another thread than the one it started on,
+    // only the sum of the gauges is meaningful.
+    own.inFlight[rpc].fetch_sub(1, std::memory_order_relaxed);
+    own.latencyUs[rpc].record(us);
+}
+
+void FrMetrics::faces(Rpc rpc, int faces, int skipped) {
+    Shard &own = shard();
+    own.faces[rpc].fetch_add(faces, std::memory_order_relaxed);
+    own.skipped[rpc].fetch_add(skipped, std::memory_order_relaxed);
+}
+
+void FrMetrics::stages(const FrStageTimer &timer) {
+    Shard &own = shard();
+    for (const auto &entry : timer.stages()) {
+        for (int s = 0; s < kStageCount; s++) {
+            if (0 == std::strcmp(entry.first, kStageNames[s])) {
+                own.stageUs[s].record(
+                            static_cast<uint64_t>(entry.second * 1000));
+                break;
+            }
+        }
+    }
+}
+
+void FrMetrics::exposition(std::ostream &os) const {
+    os << "# HELP fr_uptime_seconds Time since the server started.\n"
+        << "# TYPE fr_uptime_seconds gauge\n"
+        << "fr_uptime_seconds "
+        << std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start_).count() << '\n';
+
+    os << "# HELP fr_rpc_latency_seconds Time spent in the handler of rpcs,"
+        << " per frame for featureStream.\n"
+        << "# TYPE fr_rpc_latency_seconds histogram\n";
+    for (int r = 0; r < kRpcCount; r++) {
+        FrHistogram merged;
+        mergeShards(kShards, [this, r](int i) -> const FrHistogram& {
+            return shards_[i].latencyUs[r];
+        }, &merged);
+        merged.prometheus(os, "fr_rpc_latency_seconds",
+                        std::string("rpc=\"") + kRpcNames[r] + '"');
+    }
+
+    os << "# HELP fr_stage_latency_seconds Time spent in one stage of"
+        << " image rpcs.\n"
+        << "# TYPE fr_stage_latency_seconds histogram\n";
+    for (int s = 0; s < kStageCount; s++) {
+        FrHistogram merged;
+        mergeShards(kShards, [this, s](int i) -> const FrHistogram& {
+            return shards_[i].stageUs[s];
+        }, &merged);
+        merged.prometheus(os, "fr_stage_latency_seconds",
+                        std::string("stage=\"") + kStageNames[s] + '"');
+    }
+
+    os << "# HELP fr_rpc_in_flight Rpcs being served.\n"
+        << "# TYPE fr_rpc_in_flight gauge\n";
+    for (int r = 0; r < kRpcCount; r++) {
+        int64_t sum = 0;
+        for (int i = 0; i < kShards; i++) {
+            sum += shards_[i].inFlight[r].load(std::memory_order_relaxed);
+        }
+        os << "fr_rpc_in_flight{rpc=\"" << kRpcNames[r] << "\"} "
+            << sum << '\n';
+    }
+
+    os << "# HELP fr_faces_total Faces returned with a feature.\n"
+        << "# TYPE fr_faces_total counter\n";
+    for (int r = 0; r < kRpcCount; r++) {
+        uint64_t sum = 0;
+        for (int i = 0; i < kShards; i++) {
+            sum += shards_[i].faces[r].load(std::memory_order_relaxed);
+        }
+        if (0 != sum) {
+            os << "fr_faces_total{rpc=\"" << kRpcNames[r] << "\"} "
+                << sum << '\n';
+        }
+    }
+
+    os << "# HELP fr_faces_skipped_total Faces rejected by the quality"
+        << " gate.\n"
+        << "# TYPE fr_faces_skipped_total counter\n";
+    for (int r = 0; r < kRpcCount; r++) {
+        uint64_t sum = 0;
+        for (int i = 0; i < kShards; i++) {
+            sum += shards_[i].skipped[r].load(std::memory_order_relaxed);
+        }
+        if (0 != sum) {
+            os << "fr_faces_skipped_total{rpc=\"" << kRpcNames[r] << "\"} "
+                << sum << '\n';
+        }
+    }
+
+    for (const auto &collector : collectors_) {
+        collector(os);
+    }
+}
+
+FrMetricsHttp::FrMetricsHttp(const FrMetrics *metrics, int port,
+                            const std::string &host)
+        : metrics_(metrics), stopping_(false) {
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    if (1 != inet_pton(AF_INET, host.c_str(), &addr.sin_addr)) {
+        return;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (0 > fd) {
+        return;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (0 != bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))
+        || 0 != listen(fd, 16)) {
+        close(fd);
+        return;
+    }
+    fd_ = fd;
+    thread_ = std::thread(&FrMetricsHttp::run, this);
+}
+
+FrMetricsHttp::~FrMetricsHttp() {
+    stopping_ = true;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (0 <= fd_) {
+        close(fd_);
+    }
+}
+
+void FrMetricsHttp::run() {
+    while (!stopping_) {
+        pollfd pfd = {fd_, POLLIN, 0};
+        // Wakes up regularly to notice stopping_.
+        if (0 >= poll(&pfd, 1, 200)) {
+            continue;
+        }
+        int client = accept(fd_, nullptr, nullptr);
+        if (0 > client) {
+            continue;
+        }
+        // The request is not parsed, any path gets the metrics.
+        char request[1024];
+        pollfd cfd = {client, POLLIN, 0};
+        if (0 < poll(&cfd, 1, 1000)) {
+            ssize_t ignored = recv(client, request, sizeof(request), 0);
+            (void)ignored;
+        }
+
+        std::ostringstream body;
+        metrics_->exposition(body);
+        std::string text = body.str();
+        std::string response = "HTTP/1.0 200 OK\r\n"
+                "Content-Type: text/plain; version=0.0.4\r\n"
+                "Content-Length: " + std::to_string(text.size()) + "\r\n"
+                "Connection: close\r\n\r\n" + text;
+        size_t sent = 0;
+        while (sent < response.size()) {
+            ssize_t n = send(client, response.data() + sent,
+                            response.size() - sent, MSG_NOSIGNAL);
+            if (0 >= n) {
+                break;
+            }
+            sent += n;
+        }
+        close(client);
+    }
+}
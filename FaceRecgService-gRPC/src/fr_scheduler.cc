@@ -0,0 +1,178 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Priority and fair scheduling of the recognizer calls.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_scheduler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+const char *kPriorityNames[kFrPriorityCount] = {
+    "interactive", "normal", "bulk"
+};
+
+/// Tenants remembered by a class before the idle ones are forgotten.
+const size_t kMaxTenants = 1024;
+
+} // namespace
+
+const char* frPriorityName(FrPriority priority) {
+    return kPriorityNames[priority];
+}
+
+bool frParsePriority(const std::string &name, FrPriority *priority) {
+    for (int i = 0; i < kFrPriorityCount; i++) {
+        if (name == kPriorityNames[i]) {
+            *priority = static_cast<FrPriority>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+FrScheduler::FrScheduler(int slots,
+                        const std::map<std::string, double> &weights)
+        : slots_(0 < slots ? slots
+                : std::max(1u, std::thread::hardware_concurrency())),
+        weights_(weights) {
+}
+
+bool FrScheduler::parseWeights(const std::string &text,
+                                std::map<std::string, double> *weights) {
+    std::istringstream entries(text);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        size_t colon = entry.rfind(':');
+        if (std::string::npos == colon || 0 == colon) {
+            return false;
+        }
+        char *end = nullptr;
+        double weight = std::strtod(entry.c_str() + colon + 1, &end);
+        if (end == entry.c_str() + colon + 1 || '\0' != *end
+            || !(0 < weight)) {
+            return false;
+        }
+        (*weights)[entry.substr(0, colon)] = weight;
+    }
+    return true;
+}
+
+double FrScheduler::tag(Class &cls, const FrSchedClass &work, double cost) {
+    if (kMaxTenants < cls.lastFinish.size()) {
+        // Tenants already behind the virtual time start from it anyway.
+        for (auto it = cls.lastFinish.begin(); it != cls.lastFinish.end();) {
+            it = it->second <= cls.virtualTime ? cls.lastFinish.erase(it)
+                                                : std::next(it);
+        }
+    }
+    auto weight = weights_.find(work.tenant);
+    double &lastFinish = cls.lastFinish[work.tenant];
+    double start = std::max(cls.virtualTime, lastFinish);
+    lastFinish = start + std::max(cost, 1.0)
+                / (weights_.end() == weight ? 1.0 : weight->second);
+    return start;
+}
+
+void FrScheduler::acquire(const FrSchedClass &work, double cost) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Class &cls = classes_[work.priority];
+    double start = tag(cls, work, cost);
+    cls.calls++;
+    if (running_ < slots_ && 0 == waiting_) {
+        running_++;
+        cls.virtualTime = start;
+        cls.waitUs.record(0);
+        return;
+    }
+    Waiter waiter;
+    waiter.start = start;
+    waiter.seq = nextSeq_++;
+    cls.waiters.push_back(&waiter);
+    waiting_++;
+    std::chrono::steady_clock::time_point begin
+                                    = std::chrono::steady_clock::now();
+    waiter.ready.wait(lock, [&waiter]() { return waiter.granted; });
+    cls.waitUs.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - begin).count());
+}
+
+void FrScheduler::release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Class &cls : classes_) {
+        if (cls.waiters.empty()) {
+            continue;
+        }
+        auto next = std::min_element(cls.waiters.begin(), cls.waiters.end(),
+                        [](const Waiter *a, const Waiter *b) {
+                            return a->start < b->start
+                                || (a->start == b->start && a->seq < b->seq);
+                        });
+        Waiter *waiter = *next;
+        cls.waiters.erase(next);
+        waiting_--;
+        cls.virtualTime = waiter->start;
+        // The slot is handed over, running_ stays the same.
+        waiter->granted = true;
+        waiter->ready.notify_one();
+        return;
+    }
+    running_--;
+}
+
+void FrScheduler::dump(std::ostream &os) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    os << "Scheduler: " << slots_ << " slots" << std::endl;
+    for (int p = 0; p < kFrPriorityCount; p++) {
+        const Class &cls = classes_[p];
+        if (0 == cls.calls) {
+            continue;
+        }
+        cls.waitUs.dump(os, std::string("  ")
+                        + kPriorityNames[p] + " queue", "us");
+    }
+}
+
+void FrScheduler::exposition(std::ostream &os) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    os << "# HELP fr_sched_calls_total Recognizer calls scheduled.\n"
+        << "# TYPE fr_sched_calls_total counter\n";
+    for (int p = 0; p < kFrPriorityCount; p++) {
+        os << "fr_sched_calls_total{class=\"" << kPriorityNames[p] << "\"} "
+            << classes_[p].calls << '\n';
+    }
+    os << "# HELP fr_sched_queued Recognizer calls waiting for a slot.\n"
+        << "# TYPE fr_sched_queued gauge\n";
+    for (int p = 0; p < kFrPriorityCount; p++) {
+        os << "fr_sched_queued{class=\"" << kPriorityNames[p] << "\"} "
+            << classes_[p].waiters.size() << '\n';
+    }
+    os << "# HELP fr_sched_queue_seconds Time recognizer calls waited for"
+        << " a slot.\n"
+        << "# TYPE fr_sched_queue_seconds histogram\n";
+    for (int p = 0; p < kFrPriorityCount; p++) {
+        classes_[p].waitUs.prometheus(os, "fr_sched_queue_seconds",
+                    std::string("class=\"") + kPriorityNames[p] + '"');
+    }
+}
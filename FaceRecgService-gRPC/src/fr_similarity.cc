@@ -0,0 +1,342 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Scores of many probes against many candidates.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_similarity.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+
+#include "fr_feature_math.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FR_SIMILARITY_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/// Dot products of one probe with n packed rows.
+typedef void (*DotRows)(const float *probe, const float *rows, int n,
+                        int len, float *out);
+
+/// Candidates scored against all the probes before the next ones, so that
+/// they stay in the L2 cache: 64 faces of 512 floats take 128 KB.
+const int kCandidateBlock = 64;
+
+/// Dot product of a[from, len) and b[from, len).
+inline float dotTail(const float *a, const float *b, int from, int len) {
+    float sum = 0;
+    for (int i = from; i < len; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+void dotRowsScalar(const float *probe, const float *rows, int n, int len,
+                    float *out) {
+    for (int j = 0; j < n; j++) {
+        out[j] = frDotProduct(probe, rows + static_cast<size_t>(j) * len,
+                                len);
+    }
+}
+
+bool alwaysSupported() {
+    return true;
+}
+
+#ifdef FR_SIMILARITY_X86
+
+__attribute__((target("sse2")))
+float dotSse(const float *a, const float *b, int len) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    __m128 acc3 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i),
+                                            _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4),
+                                            _mm_loadu_ps(b + i + 4)));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(a + i + 8),
+                                            _mm_loadu_ps(b + i + 8)));
+        acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(a + i + 12),
+                                            _mm_loadu_ps(b + i + 12)));
+    }
+    __m128 acc = _mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3));
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + dotTail(a, b, i, len);
+}
+
+__attribute__((target("sse2")))
+void dotRowsSse(const float *probe, const float *rows, int n, int len,
+                float *out) {
+    for (int j = 0; j < n; j++) {
+        out[j] = dotSse(probe, rows + static_cast<size_t>(j) * len, len);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+inline float sumAvx2(__m256 v) {
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(v),
+                                _mm256_extractf128_ps(v, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    return _mm_cvtss_f32(half);
+}
+
+/**
+ * Four rows at a time share each load of the probe, which leaves the
+ * loads of the rows as the bound.
+ */
+__attribute__((target("avx2,fma")))
+void dotRowsAvx2(const float *probe, const float *rows, int n, int len,
+                float *out) {
+    int j = 0;
+    for (; j + 4 <= n; j += 4) {
+        const float *r0 = rows + static_cast<size_t>(j) * len;
+        const float *r1 = r0 + len;
+        const float *r2 = r1 + len;
+        const float *r3 = r2 + len;
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps();
+        __m256 acc3 = _mm256_setzero_ps();
+        int i = 0;
+        for (; i + 8 <= len; i += 8) {
+            __m256 p = _mm256_loadu_ps(probe + i);
+            acc0 = _mm256_fmadd_ps(p, _mm256_loadu_ps(r0 + i), acc0);
+            acc1 = _mm256_fmadd_ps(p, _mm256_loadu_ps(r1 + i), acc1);
+            acc2 = _mm256_fmadd_ps(p, _mm256_loadu_ps(r2 + i), acc2);
+            acc3 = _mm256_fmadd_ps(p, _mm256_loadu_ps(r3 + i), acc3);
+        }
+        out[j] = sumAvx2(acc0) + dotTail(probe, r0, i, len);
+        out[j + 1] = sumAvx2(acc1) + dotTail(probe, r1, i, len);
+        out[j + 2] = sumAvx2(acc2) + dotTail(probe, r2, i, len);
+        out[j + 3] = sumAvx2(acc3) + dotTail(probe, r3, i, len);
+    }
+    for (; j < n; j++) {
+        const float *row = rows + static_cast<size_t>(j) * len;
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        int i = 0;
+        for (; i + 16 <= len; i += 16) {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(probe + i),
+                                    _mm256_loadu_ps(row + i), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(probe + i + 8),
+                                    _mm256_loadu_ps(row + i + 8), acc1);
+        }
+        out[j] = sumAvx2(_mm256_add_ps(acc0, acc1))
+                    + dotTail(probe, row, i, len);
+    }
+}
+
+/**
+ * Sum of the lanes. Stored rather than shuffled, the shuffles of GCC 12
+ * warn about their undefined source and this runs once per row.
+ */
+__attribute__((target("avx512f")))
+inline float sumAvx512(__m512 v) {
+    float lanes[16];
+    _mm512_storeu_ps(lanes, v);
+    float sum = 0;
+    for (int k = 0; k < 16; k++) {
+        sum += lanes[k];
+    }
+    return sum;
+}
+
+/// Same as dotRowsAvx2 on 16 floats.
+__attribute__((target("avx512f")))
+void dotRowsAvx512(const float *probe, const float *rows, int n, int len,
+                    float *out) {
+    int j = 0;
+    for (; j + 4 <= n; j += 4) {
+        const float *r0 = rows + static_cast<size_t>(j) * len;
+        const float *r1 = r0 + len;
+        const float *r2 = r1 + len;
+        const float *r3 = r2 + len;
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps();
+        __m512 acc3 = _mm512_setzero_ps();
+        int i = 0;
+        for (; i + 16 <= len; i += 16) {
+            __m512 p = _mm512_loadu_ps(probe + i);
+            acc0 = _mm512_fmadd_ps(p, _mm512_loadu_ps(r0 + i), acc0);
+            acc1 = _mm512_fmadd_ps(p, _mm512_loadu_ps(r1 + i), acc1);
+            acc2 = _mm512_fmadd_ps(p, _mm512_loadu_ps(r2 + i), acc2);
+            acc3 = _mm512_fmadd_ps(p, _mm512_loadu_ps(r3 + i), acc3);
+        }
+        out[j] = sumAvx512(acc0) + dotTail(probe, r0, i, len);
+        out[j + 1] = sumAvx512(acc1) + dotTail(probe, r1, i, len);
+        out[j + 2] = sumAvx512(acc2) + dotTail(probe, r2, i, len);
+        out[j + 3] = sumAvx512(acc3) + dotTail(probe, r3, i, len);
+    }
+    for (; j < n; j++) {
+        const float *row = rows + static_cast<size_t>(j) * len;
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        int i = 0;
+        for (; i + 32 <= len; i += 32) {
+            acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(probe + i),
+                                    _mm512_loadu_ps(row + i), acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(probe + i + 16),
+                                    _mm512_loadu_ps(row + i + 16), acc1);
+        }
+        out[j] = sumAvx512(_mm512_add_ps(acc0, acc1))
+                    + dotTail(probe, row, i, len);
+    }
+}
+
+bool hasSse() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+bool hasAvx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+bool hasAvx512() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f");
+}
+
+#endif // FR_SIMILARITY_X86
+
+struct Kernel {
+    const char *name;
+    DotRows dotRows;
+    bool (*supported)();
+};
+
+/// Widest first, the last one runs everywhere.
+const Kernel kKernels[] = {
+#ifdef FR_SIMILARITY_X86
+    {"avx512", dotRowsAvx512, hasAvx512},
+    {"avx2", dotRowsAvx2, hasAvx2},
+    {"sse", dotRowsSse, hasSse},
+#endif
+    {"scalar", dotRowsScalar, alwaysSupported}
+};
+
+const Kernel* widestKernel() {
+    for (const Kernel &kernel : kKernels) {
+        if (kernel.supported()) {
+            return &kernel;
+        }
+    }
+    return &kKernels[sizeof(kKernels) / sizeof(kKernels[0]) - 1];
+}
+
+std::atomic<const Kernel*>& currentKernel() {
+    static std::atomic<const Kernel*> kernel(widestKernel());
+    return kernel;
+}
+
+/// 1 / norm of each feature, 0 for a zero feature.
+std::vector<float> inverseNorms(DotRows dotRows, const float *features,
+                                int count, int len) {
+    std::vector<float> inverse(count);
+    for (int i = 0; i < count; i++) {
+        const float *feature = features + static_cast<size_t>(i) * len;
+        float square;
+        dotRows(feature, feature, 1, len, &square);
+        inverse[i] = 0 < square ? 1.0f / std::sqrt(square) : 0;
+    }
+    return inverse;
+}
+
+} // namespace
+
+const char* frSimilarityKernel() {
+    return currentKernel().load(std::memory_order_relaxed)->name;
+}
+
+std::vector<std::string> frSimilarityKernels() {
+    std::vector<std::string> names;
+    for (const Kernel &kernel : kKernels) {
+        if (kernel.supported()) {
+            names.push_back(kernel.name);
+        }
+    }
+    return names;
+}
+
+bool frSelectSimilarityKernel(const std::string &name) {
+    for (const Kernel &kernel : kKernels) {
+        if (name == kernel.name && kernel.supported()) {
+            currentKernel().store(&kernel, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void frScoreMatrix(const float *probes, int m, const float *candidates,
+                    int n, int len, FrSimilarity similarity, float *scores) {
+    DotRows dotRows = currentKernel().load(std::memory_order_relaxed)
+                        ->dotRows;
+    for (int j = 0; j < n; j += kCandidateBlock) {
+        int count = std::min(kCandidateBlock, n - j);
+        for (int i = 0; i < m; i++) {
+            dotRows(probes + static_cast<size_t>(i) * len,
+                    candidates + static_cast<size_t>(j) * len, count, len,
+                    scores + static_cast<size_t>(i) * n + j);
+        }
+    }
+    if (kFrCosine != similarity) {
+        return;
+    }
+    std::vector<float> probeScale = inverseNorms(dotRows, probes, m, len);
+    std::vector<float> candidateScale = inverseNorms(dotRows, candidates, n,
+                                                        len);
+    for (int i = 0; i < m; i++) {
+        float *row = scores + static_cast<size_t>(i) * n;
+        for (int j = 0; j < n; j++) {
+            row[j] *= probeScale[i] * candidateScale[j];
+        }
+    }
+}
+
+void frTopK(const float *scores, int n, int topK,
+            std::vector<std::pair<int, float>> *best) {
+    best->clear();
+    for (int j = 0; j < n; j++) {
+        best->push_back(std::make_pair(j, scores[j]));
+    }
+    size_t keep = std::min(best->size(),
+                            static_cast<size_t>(std::max(0, topK)));
+    // Ties keep the first candidate first.
+    std::partial_sort(best->begin(), best->begin() + keep, best->end(),
+                        [](const std::pair<int, float> &a,
+                            const std::pair<int, float> &b) {
+                            return a.second > b.second
+                                || (a.second == b.second
+                                    && a.first < b.first);
+                        });
+    best->resize(keep);
+}
@@ -0,0 +1,675 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Self-checks of the server's building blocks, run by ctest.
+ * @details	Each check runs without the recognizer, models or network and
+ *          prints PASS or FAIL; the exit status is the number of failures.
+ *          --only=name runs one check.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "interface_face_recognizer.h"
+#include "fr_admission.h"
+#include "fr_ann_index.h"
+#include "fr_feature_codec.h"
+#include "fr_feature_math.h"
+#include "fr_gallery_wal.h"
+#include "fr_scheduler.h"
+#include "fr_similarity.h"
+#include "fr_singleflight.h"
+
+namespace {
+
+/**
+ * Find the value of "--key=value" in arguments, or the default one.
+ */
+std::string getArg(int argc, char** argv, const std::string &key,
+                    const std::string &defVal) {
+    std::string prefix = "--" + key + "=";
+    for (int i = 1; i < argc; i++) {
+        std::string arg_val = argv[i];
+        if (0 == arg_val.compare(0, prefix.size(), prefix)) {
+            return arg_val.substr(prefix.size());
+        }
+    }
+    return defVal;
+}
+
+/// Reports the first failed expectation of a check.
+#define FR_EXPECT(cond)                                                     \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            std::cout << "  " << __FILE__ << ":" << __LINE__                \
+                        << ": expected " << #cond << std::endl;             \
+            return false;                                                   \
+        }                                                                   \
+    } while (0)
+
+/**
+ * @brief Unit features by label, like the gallery's store.
+ *        Reading a removed label is counted instead of reading freed rows.
+ */
+class TestStore final : public FrVectorStore {
+    public:
+        explicit TestStore(uint32_t seed) : rng_(seed) {}
+
+        /// New random unit feature, returns its label.
+        uint32_t add() {
+            std::normal_distribution<float> gauss(0, 1);
+            std::vector<float> raw(HIAR_FACE_FEATURE_LEN);
+            for (float &value : raw) {
+                value = gauss(rng_);
+            }
+            std::vector<float> &feature = features_[next_];
+            feature.resize(HIAR_FACE_FEATURE_LEN);
+            frNormalize(raw.data(), feature.data(), HIAR_FACE_FEATURE_LEN);
+            return next_++;
+        }
+        void remove(uint32_t label) {
+            features_.erase(label);
+        }
+        const float* vectorOf(uint32_t label) const override {
+            auto found = features_.find(label);
+            if (features_.end() == found) {
+                badReads_++;
+                return zeros_.data();
+            }
+            return found->second.data();
+        }
+        size_t badReads() const { return badReads_; }
+
+    private:
+        std::mt19937 rng_;
+        uint32_t next_ = 0;
+        std::unordered_map<uint32_t, std::vector<float>> features_;
+        std::vector<float> zeros_ = std::vector<float>(HIAR_FACE_FEATURE_LEN);
+        mutable size_t badReads_ = 0;
+};
+
+/**
+ * Removals interleaved with additions on full neighbour lists: the index
+ * must never read a removed feature, and live faces stay reachable.
+ */
+bool checkHnswChurn() {
+    TestStore store(7);
+    FrHnswParams params;
+    // Few links per node, so that every list is full and gets pruned.
+    params.M = 4;
+    params.efConstruction = 32;
+    params.efSearch = 64;
+    FrHnswIndex index(&store, params);
+
+    std::vector<uint32_t> live;
+    for (int i = 0; i < 300; i++) {
+        uint32_t label = store.add();
+        index.add(label);
+        live.push_back(label);
+    }
+    size_t bytes = index.memoryBytes();
+    std::mt19937 rng(11);
+    for (int round = 0; round < 2000; round++) {
+        std::uniform_int_distribution<size_t> pick(0, live.size() - 1);
+        size_t victim = pick(rng);
+        // Like the gallery: unlink first, then the feature is gone.
+        index.remove(live[victim]);
+        store.remove(live[victim]);
+        live[victim] = live.back();
+        live.pop_back();
+        uint32_t label = store.add();
+        index.add(label);
+        live.push_back(label);
+        FR_EXPECT(0 == store.badReads());
+    }
+
+    size_t found = 0;
+    for (uint32_t label : live) {
+        std::vector<FrAnnResult> results = index.search(
+                                        store.vectorOf(label), 1, 0);
+        if (!results.empty() && label == results[0].label) {
+            found++;
+        }
+    }
+    FR_EXPECT(0 == store.badReads());
+    FR_EXPECT(found * 100 >= live.size() * 95);
+    // Removed slots are reused, churn does not grow the graph.
+    FR_EXPECT(index.memoryBytes() < 2 * bytes);
+    return true;
+}
+
+/**
+ * The IVF-PQ trainer runs on a copy while faces come and go: the faces
+ * removed meanwhile stay out of the lists, the ones added get encoded.
+ * Enough churn afterwards retrains it the same way.
+ */
+bool checkIvfPqTraining() {
+    TestStore store(13);
+    FrIvfPqParams params;
+    params.nlist = 4;
+    params.trainPerList = 16;
+    params.subvectors = 8;
+    params.nprobe = 4;
+    FrIvfPqIndex index(&store, params);
+
+    std::vector<uint32_t> labels;
+    for (int i = 0; i < params.nlist * params.trainPerList; i++) {
+        FR_EXPECT(nullptr == index.startTraining());
+        labels.push_back(store.add());
+        index.add(labels.back());
+    }
+    std::unique_ptr<FrAnnTrainer> trainer = index.startTraining();
+    FR_EXPECT(nullptr != trainer);
+    FR_EXPECT(nullptr == index.startTraining());
+
+    uint32_t removed = labels[5];
+    index.remove(removed);
+    store.remove(removed);
+    uint32_t added = store.add();
+    index.add(added);
+    FR_EXPECT(!index.ready());
+
+    trainer->run();
+    index.finishTraining(std::move(trainer));
+    FR_EXPECT(index.ready());
+    FR_EXPECT(0 == store.badReads());
+
+    std::vector<FrAnnResult> results = index.search(store.vectorOf(added),
+                                                    1, 0);
+    FR_EXPECT(!results.empty() && added == results[0].label);
+    results = index.search(store.vectorOf(labels[0]), 1000, 0);
+    FR_EXPECT(labels.size() == results.size());
+    for (const FrAnnResult &result : results) {
+        FR_EXPECT(removed != result.label);
+    }
+
+    // Adding and removing as many faces as the training saw makes it due
+    // again, counting the two changes made while it ran.
+    labels.erase(labels.begin() + 5);
+    labels.push_back(added);
+    for (size_t i = 0; i < labels.size() / 2 - 1; i++) {
+        FR_EXPECT(nullptr == index.startTraining());
+        index.remove(labels[i]);
+        store.remove(labels[i]);
+        labels[i] = store.add();
+        index.add(labels[i]);
+    }
+    trainer = index.startTraining();
+    FR_EXPECT(nullptr != trainer);
+    removed = labels[0];
+    index.remove(removed);
+    store.remove(removed);
+    labels[0] = store.add();
+    index.add(labels[0]);
+
+    trainer->run();
+    index.finishTraining(std::move(trainer));
+    FR_EXPECT(index.ready());
+    FR_EXPECT(nullptr == index.startTraining());
+    FR_EXPECT(0 == store.badReads());
+    results = index.search(store.vectorOf(labels[0]), 1, 0);
+    FR_EXPECT(!results.empty() && labels[0] == results[0].label);
+    results = index.search(store.vectorOf(labels[1]), 1000, 0);
+    FR_EXPECT(labels.size() == results.size());
+    for (const FrAnnResult &result : results) {
+        FR_EXPECT(removed != result.label);
+    }
+    return true;
+}
+
+/**
+ * Records appended after a rotation that appends to an existing path.1,
+ * even one ending with a torn record, survive a reopen of the log, in order.
+ */
+bool checkWalRotate() {
+    char dir[] = "/tmp/fr_test_XXXXXX";
+    FR_EXPECT(nullptr != mkdtemp(dir));
+    std::string path = std::string(dir) + "/gallery.wal";
+    std::vector<std::string> ids = {"a", "b", "c", "d", "e"};
+    auto opOf = [&](size_t i) {
+        FrGalleryOp op;
+        op.seq = i + 1;
+        op.id = ids[i];
+        op.feature.assign(HIAR_FACE_FEATURE_LEN, static_cast<float>(i));
+        return op;
+    };
+
+    bool passed = false;
+    {
+        std::string error;
+        FrGalleryWal wal(path, false);
+        // a, b then rotate to a new path.1, c then rotate appending to it.
+        passed = wal.open(&error)
+                && wal.append(opOf(0)) && wal.append(opOf(1)) && wal.rotate()
+                && wal.append(opOf(2));
+        // A crash in the middle of the previous append left a torn record.
+        std::ofstream torn(path + ".1", std::ios::binary | std::ios::app);
+        torn.write("FRWL\x10\0\0", 7);
+        torn.close();
+        passed = passed && wal.rotate()
+                && wal.append(opOf(3)) && wal.append(opOf(4));
+    }
+    std::vector<FrGalleryOp> ops;
+    if (passed) {
+        std::string error;
+        FrGalleryWal wal(path, false);
+        passed = wal.open(&error);
+        wal.readAll(0, &ops);
+    }
+    unlink(path.c_str());
+    unlink((path + ".1").c_str());
+    rmdir(dir);
+
+    FR_EXPECT(passed);
+    FR_EXPECT(ids.size() == ops.size());
+    for (size_t i = 0; i < ops.size(); i++) {
+        FR_EXPECT(ids[i] == ops[i].id && i + 1 == ops[i].seq);
+        FR_EXPECT(static_cast<float>(i) == ops[i].feature[0]);
+    }
+    return true;
+}
+
+/**
+ * Scores of one kernel against the scalar one: lengths around the vector
+ * widths and around 512, counts off the unrolling, zero features.
+ */
+bool checkKernel(const std::string &kernel) {
+    std::vector<int> lengths;
+    for (int len = 1; len <= 33; len++) {
+        lengths.push_back(len);
+    }
+    lengths.push_back(511);
+    lengths.push_back(512);
+    lengths.push_back(513);
+    // Up to 67 candidates, past one block of 64.
+    const int shapes[][2] = {{1, 1}, {3, 5}, {5, 67}};
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    for (int len : lengths) {
+        for (const auto &shape : shapes) {
+            int m = shape[0];
+            int n = shape[1];
+            std::vector<float> probes(static_cast<size_t>(m) * len);
+            std::vector<float> candidates(static_cast<size_t>(n) * len);
+            for (float &value : probes) {
+                value = uniform(rng);
+            }
+            for (float &value : candidates) {
+                value = uniform(rng);
+            }
+            // The last probe and the first candidate are zero.
+            std::fill(probes.end() - len, probes.end(), 0.0f);
+            std::fill(candidates.begin(), candidates.begin() + len, 0.0f);
+
+            for (FrSimilarity similarity : {kFrDot, kFrCosine}) {
+                std::vector<float> expected(static_cast<size_t>(m) * n);
+                std::vector<float> scores(expected.size());
+                FR_EXPECT(frSelectSimilarityKernel("scalar"));
+                frScoreMatrix(probes.data(), m, candidates.data(), n, len,
+                                similarity, expected.data());
+                FR_EXPECT(frSelectSimilarityKernel(kernel));
+                frScoreMatrix(probes.data(), m, candidates.data(), n, len,
+                                similarity, scores.data());
+                for (int i = 0; i < m; i++) {
+                    for (int j = 0; j < n; j++) {
+                        float score = scores[i * n + j];
+                        FR_EXPECT(std::isfinite(score));
+                        FR_EXPECT(std::fabs(score - expected[i * n + j])
+                                    <= 1e-5f * (len + 10));
+                        if (i == m - 1 || 0 == j) {
+                            FR_EXPECT(0.0f == score);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Every kernel runnable here scores like the scalar one, and the best
+ * candidates come out ties first by position.
+ */
+bool checkSimilarityKernels() {
+    std::string original = frSimilarityKernel();
+    bool passed = true;
+    for (const std::string &kernel : frSimilarityKernels()) {
+        if (!checkKernel(kernel)) {
+            std::cout << "  kernel " << kernel << " differs" << std::endl;
+            passed = false;
+        }
+    }
+    frSelectSimilarityKernel(original);
+    FR_EXPECT(passed);
+
+    const float scores[] = {0.5f, 0.9f, 0.5f, 0.9f, 0.1f};
+    std::vector<std::pair<int, float>> best;
+    frTopK(scores, 5, 3, &best);
+    FR_EXPECT(3 == best.size());
+    FR_EXPECT(1 == best[0].first && 3 == best[1].first
+                && 0 == best[2].first);
+    FR_EXPECT(0.5f == best[2].second);
+    frTopK(scores, 5, 10, &best);
+    FR_EXPECT(5 == best.size() && 2 == best[3].first && 4 == best[4].first);
+    frTopK(scores, 5, 0, &best);
+    FR_EXPECT(best.empty());
+    return true;
+}
+
+/// float16 bits of a value packed as f16.
+uint16_t halfOf(float value) {
+    std::string packed;
+    frPackFeature(kFrPackedF16, &value, 1, &packed);
+    uint16_t half;
+    memcpy(&half, packed.data(), sizeof(half));
+    return half;
+}
+
+/// Value of float16 bits unpacked from f16.
+float valueOfHalf(uint16_t half) {
+    std::string packed(reinterpret_cast<const char*>(&half), sizeof(half));
+    std::vector<float> values;
+    frUnpackFeatures(kFrPackedF16, packed, 1, &values);
+    return values[0];
+}
+
+/**
+ * Every float16 survives a round trip through float, and floats round to
+ * the nearest float16, ties to even, including subnormals, infinity and
+ * NaN. An i8 zero feature decodes to zeros.
+ */
+bool checkFeatureCodec() {
+    for (uint32_t bits = 0; bits <= 0xffff; bits++) {
+        uint16_t half = static_cast<uint16_t>(bits);
+        float value = valueOfHalf(half);
+        if (0x7c00 < (half & 0x7fff)) {
+            FR_EXPECT(std::isnan(value));
+            FR_EXPECT(0x7e00 == (halfOf(value) & 0x7fff));
+        } else {
+            FR_EXPECT(half == halfOf(value));
+        }
+    }
+
+    const float tiny = std::ldexp(1.0f, -24);
+    // Subnormals: exact, then ties between 0 and 1, 1 and 2 ulps.
+    FR_EXPECT(0x0001 == halfOf(tiny));
+    FR_EXPECT(0x03ff == halfOf(1023 * tiny));
+    FR_EXPECT(0x0000 == halfOf(0.5f * tiny));
+    FR_EXPECT(0x0002 == halfOf(1.5f * tiny));
+    FR_EXPECT(0x0001 == halfOf(0.75f * tiny));
+    FR_EXPECT(0x8001 == halfOf(-tiny));
+    FR_EXPECT(0x8000 == halfOf(-0.0f));
+    // Normals: ties to even below and above.
+    FR_EXPECT(0x3c00 == halfOf(1.0f + std::ldexp(1.0f, -11)));
+    FR_EXPECT(0x3c02 == halfOf(1.0f + 3 * std::ldexp(1.0f, -11)));
+    FR_EXPECT(0x3c01 == halfOf(1.0f + std::ldexp(1.0f, -11)
+                                + std::ldexp(1.0f, -20)));
+    // 65504 is the largest float16, 65520 the tie rounding to infinity.
+    FR_EXPECT(0x7bff == halfOf(65504.0f));
+    FR_EXPECT(0x7bff == halfOf(65519.0f));
+    FR_EXPECT(0x7c00 == halfOf(65520.0f));
+    FR_EXPECT(0xfc00 == halfOf(-65520.0f));
+    FR_EXPECT(0x7c00 == halfOf(1e10f));
+    FR_EXPECT(0x7c00 == halfOf(INFINITY));
+    FR_EXPECT(0xfc00 == halfOf(-INFINITY));
+    FR_EXPECT(0x7e00 == halfOf(NAN));
+    FR_EXPECT(std::isinf(valueOfHalf(0x7c00)));
+
+    const int len = 8;
+    std::vector<float> zeros(len, 0.0f);
+    std::string packed;
+    frPackFeature(kFrPackedI8, zeros.data(), len, &packed);
+    std::vector<float> values;
+    FR_EXPECT(frUnpackFeatures(kFrPackedI8, packed, len, &values));
+    FR_EXPECT(zeros == values);
+
+    const float feature[len] = {0.5f, -0.25f, 0.1f, 0, -0.5f, 0.3f, 1e-4f,
+                                -0.49f};
+    packed.clear();
+    frPackFeature(kFrPackedI8, feature, len, &packed);
+    FR_EXPECT(frUnpackFeatures(kFrPackedI8, packed, len, &values));
+    float scale = 0.5f / 127;
+    for (int i = 0; i < len; i++) {
+        FR_EXPECT(std::fabs(values[i] - feature[i]) <= 0.5f * scale * 1.001f);
+    }
+    FR_EXPECT(0.5f == values[0] && -0.5f == values[4]);
+    return true;
+}
+
+/// Sum of the samples of a metric in Prometheus text.
+int metricSum(const std::string &exposition, const std::string &prefix) {
+    std::istringstream lines(exposition);
+    std::string line;
+    int sum = 0;
+    while (std::getline(lines, line)) {
+        if (0 == line.compare(0, prefix.size(), prefix)) {
+            sum += std::stoi(line.substr(line.rfind(' ') + 1));
+        }
+    }
+    return sum;
+}
+
+/// Calls waiting in a scheduler, read from its metrics.
+int queuedCalls(const FrScheduler &scheduler) {
+    std::ostringstream os;
+    scheduler.exposition(os);
+    return metricSum(os.str(), "fr_sched_queued{");
+}
+
+/**
+ * With one slot busy, the queued calls run interactive first, then normal
+ * with tenants of weights 2 and 1 alternating 2:1, then bulk.
+ */
+bool checkSchedulerOrder() {
+    FrScheduler scheduler(1, {{"a", 2.0}, {"b", 1.0}});
+    FrSchedClass holder;
+    scheduler.acquire(holder, 1);
+
+    std::mutex mutex;
+    std::string order;
+    std::vector<std::thread> calls;
+    auto queue = [&](FrPriority priority, const std::string &tenant,
+                    char name) {
+        FrSchedClass work;
+        work.priority = priority;
+        work.tenant = tenant;
+        int queued = queuedCalls(scheduler);
+        calls.emplace_back([&, work, name]() {
+            scheduler.acquire(work, 1);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                order += name;
+            }
+            scheduler.release();
+        });
+        // Queued one at a time, so that arrival breaks ties.
+        while (queuedCalls(scheduler) == queued) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    };
+    queue(kFrBulk, "a", 'x');
+    queue(kFrBulk, "b", 'y');
+    for (int i = 0; i < 6; i++) {
+        queue(kFrNormal, "a", 'a');
+    }
+    for (int i = 0; i < 3; i++) {
+        queue(kFrNormal, "b", 'b');
+    }
+    queue(kFrInteractive, "b", 'i');
+
+    scheduler.release();
+    for (std::thread &call : calls) {
+        call.join();
+    }
+    FR_EXPECT("iabaabaabaxy" == order);
+    FR_EXPECT(0 == queuedCalls(scheduler));
+    return true;
+}
+
+/// Requests waiting in admission, read from its metrics.
+int queuedRequests(const FrAdmission &admission) {
+    std::ostringstream os;
+    admission.exposition(os);
+    return metricSum(os.str(), "fr_admission_queued ");
+}
+
+/**
+ * One slot and a queue of two: a third waiter is rejected as the queue is
+ * full, a request past or unable to meet its deadline is rejected as late,
+ * and a waiter expiring in the queue leaves the slot count as it was.
+ */
+bool checkAdmission() {
+    typedef FrAdmission::Deadline Deadline;
+    FrAdmissionOptions options;
+    options.maxConcurrent = 1;
+    options.maxQueue = 2;
+    FrAdmission admission(options);
+    const FrMetrics::Rpc rpc = FrMetrics::kIdentify;
+    auto in = [](int ms) {
+        return std::chrono::system_clock::now()
+                + std::chrono::milliseconds(ms);
+    };
+
+    FR_EXPECT(FrAdmission::kAdmitted == admission.enter(rpc, in(10000)));
+    FR_EXPECT(FrAdmission::kLate == admission.enter(rpc, in(-1)));
+    std::future<FrAdmission::Verdict> patient = std::async(
+                        std::launch::async, [&]() {
+                            return admission.enter(rpc, in(10000));
+                        });
+    while (1 != queuedRequests(admission)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    Deadline expiry = in(100);
+    std::future<FrAdmission::Verdict> hasty = std::async(
+                        std::launch::async, [&]() {
+                            return admission.enter(rpc, expiry);
+                        });
+    while (2 != queuedRequests(admission)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    FR_EXPECT(FrAdmission::kQueueFull == admission.enter(rpc, in(10000)));
+
+    FR_EXPECT(FrAdmission::kLate == hasty.get());
+    FR_EXPECT(std::chrono::system_clock::now() >= expiry);
+    FR_EXPECT(1 == queuedRequests(admission));
+    FR_EXPECT(std::future_status::timeout
+                == patient.wait_for(std::chrono::milliseconds(0)));
+
+    // The slot goes to the waiter left, then is free again.
+    admission.leave(rpc, 1000);
+    FR_EXPECT(FrAdmission::kAdmitted == patient.get());
+    FR_EXPECT(0 == queuedRequests(admission));
+    // Busy with 1 ms of mean service, 1 ms ahead cannot be met.
+    FR_EXPECT(FrAdmission::kLate == admission.enter(rpc, in(1)));
+    FR_EXPECT(0 == queuedRequests(admission));
+    admission.leave(rpc, 1000);
+    FR_EXPECT(FrAdmission::kAdmitted == admission.enter(rpc, in(10000)));
+    FR_EXPECT(FrAdmission::kLate == admission.enter(rpc, in(50)));
+    admission.leave(rpc, 1000);
+
+    std::ostringstream os;
+    admission.exposition(os);
+    FR_EXPECT(3 == metricSum(os.str(), "fr_admission_admitted_total{"));
+    FR_EXPECT(1 == metricSum(os.str(), "fr_admission_rejected_total"
+                                "{rpc=\"identify\",reason=\"queue_full\"}"));
+    return true;
+}
+
+/**
+ * A caller waiting for the computation of another one gives up at its own
+ * deadline, while the computing one still gets the value.
+ */
+bool checkSingleFlightDeadline() {
+    FrSingleFlight<int> flights;
+    FrContentHash key = frHash128("face", 4);
+    std::promise<void> started;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::future<FrSingleFlight<int>::Result> first = std::async(
+                                std::launch::async, [&]() {
+        bool coalesced;
+        return flights.run(key, [&]() {
+            started.set_value();
+            released.wait();
+            return 42;
+        }, std::chrono::system_clock::time_point::max(), &coalesced);
+    });
+    started.get_future().wait();
+
+    bool coalesced = false;
+    auto begin = std::chrono::steady_clock::now();
+    FrSingleFlight<int>::Result late = flights.run(key, []() { return 0; },
+                std::chrono::system_clock::now()
+                + std::chrono::milliseconds(50), &coalesced);
+    auto waited = std::chrono::steady_clock::now() - begin;
+    release.set_value();
+    FrSingleFlight<int>::Result value = first.get();
+
+    FR_EXPECT(coalesced);
+    FR_EXPECT(nullptr == late);
+    FR_EXPECT(waited < std::chrono::seconds(5));
+    FR_EXPECT(nullptr != value && 42 == *value);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    struct Check {
+        const char *name;
+        bool (*run)();
+    };
+    const Check checks[] = {
+        {"hnsw_churn", checkHnswChurn},
+        {"ivfpq_training", checkIvfPqTraining},
+        {"wal_rotate", checkWalRotate},
+        {"singleflight_deadline", checkSingleFlightDeadline},
+        {"similarity_kernels", checkSimilarityKernels},
+        {"feature_codec", checkFeatureCodec},
+        {"scheduler_order", checkSchedulerOrder},
+        {"admission", checkAdmission},
+    };
+    std::string only = getArg(argc, argv, "only", "");
+    int failures = 0;
+    for (const Check &check : checks) {
+        if (!only.empty() && only != check.name) {
+            continue;
+        }
+        bool passed = check.run();
+        std::cout << (passed ? "PASS " : "FAIL ") << check.name << std::endl;
+        failures += passed ? 0 : 1;
+    }
+    return failures;
+}
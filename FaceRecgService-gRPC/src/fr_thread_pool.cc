@@ -0,0 +1,84 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Fixed-size pool of worker threads.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_thread_pool.h"
+
+#include "fr_affinity.h"
+
+FrThreadPool::FrThreadPool(int threads)
+        : FrThreadPool(threads, std::vector<int>()) {
+}
+
+FrThreadPool::FrThreadPool(int threads, const std::vector<int> &cpus) {
+    if (0 >= threads) {
+        threads = cpus.empty()
+                    ? static_cast<int>(std::thread::hardware_concurrency())
+                    : static_cast<int>(cpus.size());
+        threads = 0 < threads ? threads : 1;
+    }
+    for (int i = 0; i < threads; i++) {
+        threads_.emplace_back(&FrThreadPool::run, this,
+                            cpus.empty() ? -1 : cpus[i % cpus.size()]);
+    }
+}
+
+FrThreadPool::~FrThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto &thread : threads_) {
+        thread.join();
+    }
+}
+
+std::future<void> FrThreadPool::submit(std::function<void()> task) {
+    std::packaged_task<void()> packaged(std::move(task));
+    std::future<void> done = packaged.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(packaged));
+    }
+    cv_.notify_one();
+    return done;
+}
+
+void FrThreadPool::run(int cpu) {
+    // Pinned before anything is allocated, so that the buffers of the
+    // thread land on its NUMA node.
+    if (0 <= cpu && !frPinThread(cpu)) {
+        unpinned_++;
+    }
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
@@ -0,0 +1,675 @@
+/**
+ * @file
+ * @author	Devin dai
+ * @version	0.0.1
+ * @date	2026/10/16
+ * @brief	Recognizer worker processes fed through shared memory.
+ * @section LICENSE
+ * Copyright 2020 Hiscene
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * 		http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "fr_worker_pool.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+
+#include "interface_face_recognizer.h"
+
+namespace {
+
+enum Op {
+    kExtract,
+    kDetect,
+    kQuality
+};
+
+enum State {
+    kFree,
+    kQueued,
+    /// Queued, then left by its caller: still in the ring until a worker
+    /// takes it out and posts done.
+    kAbandoned,
+    kRunning,
+    kDone
+};
+
+/// Workers of one pool, the readiness of each is in the shared header.
+const int kMaxWorkers = 256;
+
+/// Exit code of a worker whose recognizer failed to load.
+const int kInitFailed = 3;
+
+/// A worker dying sooner after its start is respawned after this delay,
+/// so that broken models do not fork in a loop.
+const std::chrono::seconds kRespawnDelay(1);
+
+/// A caller waiting for its worker checks the supervisor this often.
+const std::chrono::milliseconds kLivenessPeriod(100);
+
+/// Alignment of the parts of a slot.
+const size_t kAlign = 64;
+
+size_t alignUp(size_t bytes) {
+    return (bytes + kAlign - 1) / kAlign * kAlign;
+}
+
+/// Lock taken over from a dead process is usable as is, the fields it
+/// guards are only ever left consistent.
+void lockShared(pthread_mutex_t *mutex) {
+    if (EOWNERDEAD == pthread_mutex_lock(mutex)) {
+        pthread_mutex_consistent(mutex);
+    }
+}
+
+void waitSem(sem_t *sem) {
+    while (0 != sem_wait(sem) && EINTR == errno) {
+    }
+}
+
+/// Wait for a post until a time at most, false if none came.
+bool waitSemUntil(sem_t *sem, std::chrono::system_clock::time_point until) {
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        until.time_since_epoch()).count();
+    timespec abs;
+    abs.tv_sec = static_cast<time_t>(ns / 1000000000);
+    abs.tv_nsec = static_cast<long>(ns % 1000000000);
+    while (0 != sem_timedwait(sem, &abs)) {
+        if (EINTR != errno) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+struct FrWorkerPool::Shared {
+    /// Guards the ring and the states of the slots, robust to a worker
+    /// dying while holding it.
+    pthread_mutex_t lock;
+    /// Calls queued in the ring.
+    sem_t pending;
+    /// Queued slots are ring[head % slots] up to ring[tail % slots].
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    std::atomic<int> stopping{0};
+    /// Set by the supervisor when a worker cannot load the models.
+    std::atomic<int> failed{0};
+    std::atomic<int> readyWorkers{0};
+    std::atomic<int> ready[kMaxWorkers];
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> restarts{0};
+
+    int* ring() { return reinterpret_cast<int*>(this + 1); }
+};
+
+struct FrWorkerPool::Slot {
+    /// Posted once the results are in, or the worker is gone.
+    sem_t done;
+    int state = kFree;
+    pid_t worker = 0;
+    int op = kExtract;
+    int ret = -1;
+    /// Inputs.
+    int lenImg = 0;
+    int numBbox = 0;
+    /// Outputs: boxes of detection then features, or qualities then
+    /// directions.
+    int outBoxes = 0;
+    int lenFeatures = 0;
+
+    unsigned char* image() { return reinterpret_cast<unsigned char*>(this)
+                                    + alignUp(sizeof(Slot)); }
+    int* boxes() { return reinterpret_cast<int*>(image()
+                                                + alignUp(lenImg)); }
+    unsigned char* output() { return reinterpret_cast<unsigned char*>(
+                    boxes()) + alignUp(4 * sizeof(int) * numBbox); }
+};
+
+FrWorkerPool::FrWorkerPool(const FrWorkerPoolOptions &options)
+        : options_(options) {
+    options_.workers = 0 < options_.workers ? options_.workers : 1;
+    if (kMaxWorkers < options_.workers) {
+        options_.workers = kMaxWorkers;
+    }
+    slots_ = 0 < options_.slots ? options_.slots : 2 * options_.workers;
+    slotBytes_ = alignUp(options_.slotBytes);
+}
+
+FrWorkerPool::~FrWorkerPool() {
+    stop();
+    if (nullptr != memory_) {
+        munmap(memory_, memoryBytes_);
+    }
+}
+
+FrWorkerPool::Slot* FrWorkerPool::slot(int index) const {
+    size_t header = alignUp(sizeof(Shared) + sizeof(int) * slots_);
+    return reinterpret_cast<Slot*>(static_cast<unsigned char*>(memory_)
+                    + header + (alignUp(sizeof(Slot)) + slotBytes_) * index);
+}
+
+bool FrWorkerPool::start(std::string *error) {
+    memoryBytes_ = alignUp(sizeof(Shared) + sizeof(int) * slots_)
+                    + (alignUp(sizeof(Slot)) + slotBytes_) * slots_;
+    // Pages are only backed once written, big slots cost nothing unused.
+    memory_ = mmap(nullptr, memoryBytes_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == memory_) {
+        memory_ = nullptr;
+        *error = "cannot map " + std::to_string(memoryBytes_ >> 20) + " MB";
+        return false;
+    }
+    shared_ = new (memory_) Shared();
+    for (int i = 0; i < kMaxWorkers; i++) {
+        shared_->ready[i] = 0;
+    }
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&shared_->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    sem_init(&shared_->pending, 1, 0);
+    for (int i = 0; i < slots_; i++) {
+        Slot *s = new (slot(i)) Slot();
+        sem_init(&s->done, 1, 0);
+        freeSlots_.push_back(i);
+    }
+
+    pid_t parent = getpid();
+    supervisor_ = fork();
+    if (0 > supervisor_) {
+        *error = std::string("cannot fork: ") + strerror(errno);
+        return false;
+    }
+    if (0 == supervisor_) {
+        // Leaves with the server, however it ends.
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != parent) {
+            _exit(0);
+        }
+        supervise();
+    }
+    return true;
+}
+
+bool FrWorkerPool::waitReady(std::string *error) {
+    if (nullptr == shared_) {
+        *error = "workers not started";
+        return false;
+    }
+    while (options_.workers > shared_->readyWorkers) {
+        if (shared_->failed || !alive()) {
+            stop();
+            *error = "a worker cannot load the recognizer";
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::cout << "Recognizer workers: " << options_.workers << " processes, "
+                << slots_ << " slots of " << (slotBytes_ >> 20) << " MB"
+                << std::endl;
+    return true;
+}
+
+void FrWorkerPool::stop() {
+    if (nullptr == shared_ || shared_->stopping.exchange(1)) {
+        return;
+    }
+    pid_t supervisor;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        supervisor = supervisor_;
+        supervisor_ = -1;
+    }
+    if (0 < supervisor) {
+        // Workers go with it.
+        kill(supervisor, SIGKILL);
+        waitpid(supervisor, nullptr, 0);
+    }
+    lockShared(&shared_->lock);
+    for (int i = 0; i < slots_; i++) {
+        Slot *s = slot(i);
+        if (kQueued == s->state || kAbandoned == s->state
+            || kRunning == s->state) {
+            s->ret = -1;
+            s->state = kDone;
+            sem_post(&s->done);
+        }
+    }
+    pthread_mutex_unlock(&shared_->lock);
+}
+
+bool FrWorkerPool::alive() {
+    if (nullptr == shared_) {
+        return false;
+    }
+    bool lost = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (0 < supervisor_
+            && supervisor_ == waitpid(supervisor_, nullptr, WNOHANG)) {
+            supervisor_ = -1;
+            lost = true;
+        }
+    }
+    if (lost) {
+        if (!shared_->failed) {
+            std::cout << "Recognizer supervisor died, worker calls fail"
+                        << std::endl;
+        }
+        // Nobody would ever answer the calls in flight.
+        stop();
+    }
+    return !shared_->stopping;
+}
+
+int FrWorkerPool::acquireSlot() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    reclaim();
+    while (freeSlots_.empty()) {
+        if (abandoned_.empty()) {
+            slotFreed_.wait(lock);
+        } else {
+            // Nobody notifies when a worker is done with an abandoned slot.
+            slotFreed_.wait_for(lock, kLivenessPeriod);
+        }
+        reclaim();
+    }
+    int index = freeSlots_.back();
+    freeSlots_.pop_back();
+    return index;
+}
+
+void FrWorkerPool::releaseSlot(int index) {
+    lockShared(&shared_->lock);
+    slot(index)->state = kFree;
+    pthread_mutex_unlock(&shared_->lock);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        freeSlots_.push_back(index);
+    }
+    slotFreed_.notify_one();
+}
+
+void FrWorkerPool::abandon(int index) {
+    Slot *s = slot(index);
+    lockShared(&shared_->lock);
+    // A queued call is skipped by the worker taking it out of the ring.
+    // The slot stays out of freeSlots_ until then: queued again meanwhile,
+    // it would be in the ring twice and overwrite a live entry.
+    if (kQueued == s->state) {
+        s->state = kAbandoned;
+    }
+    pthread_mutex_unlock(&shared_->lock);
+    std::lock_guard<std::mutex> lock(mutex_);
+    abandoned_.push_back(index);
+}
+
+void FrWorkerPool::reclaim() {
+    for (size_t i = 0; i < abandoned_.size();) {
+        Slot *s = slot(abandoned_[i]);
+        // Done is posted once the worker is done, or gone.
+        if (0 != sem_trywait(&s->done)) {
+            i++;
+            continue;
+        }
+        lockShared(&shared_->lock);
+        s->state = kFree;
+        pthread_mutex_unlock(&shared_->lock);
+        freeSlots_.push_back(abandoned_[i]);
+        abandoned_[i] = abandoned_.back();
+        abandoned_.pop_back();
+    }
+}
+
+int FrWorkerPool::submit(int op, const unsigned char *imgData, int lenImg,
+                        const int *faceBboxes, int numBbox,
+                        Deadline deadline) {
+    if (nullptr == shared_) {
+        return -1;
+    }
+    if (0 > lenImg || 0 > numBbox
+        || alignUp(lenImg) + alignUp(4 * sizeof(int) * numBbox)
+            > slotBytes_) {
+        shared_->failures++;
+        return -1;
+    }
+    int index = acquireSlot();
+    Slot *s = slot(index);
+    s->op = op;
+    s->ret = -1;
+    s->lenImg = lenImg;
+    s->numBbox = numBbox;
+    s->outBoxes = 0;
+    s->lenFeatures = 0;
+    if (0 < lenImg) {
+        memcpy(s->image(), imgData, lenImg);
+    }
+    if (0 < numBbox) {
+        memcpy(s->boxes(), faceBboxes, 4 * sizeof(int) * numBbox);
+    }
+
+    lockShared(&shared_->lock);
+    if (shared_->stopping) {
+        pthread_mutex_unlock(&shared_->lock);
+        releaseSlot(index);
+        shared_->failures++;
+        return -1;
+    }
+    s->state = kQueued;
+    shared_->ring()[shared_->tail++ % slots_] = index;
+    pthread_mutex_unlock(&shared_->lock);
+    sem_post(&shared_->pending);
+    // Nobody posts done if the supervisor dies with its workers: the wait
+    // checks it every kLivenessPeriod, alive() failing the calls if so.
+    while (!waitSemUntil(&s->done, std::min(deadline,
+                        std::chrono::system_clock::now() + kLivenessPeriod))) {
+        if (alive() && std::chrono::system_clock::now() >= deadline) {
+            abandon(index);
+            shared_->failures++;
+            return -1;
+        }
+    }
+    if (1 == s->ret) {
+        shared_->calls++;
+    } else {
+        shared_->failures++;
+    }
+    return index;
+}
+
+int FrWorkerPool::extractFeature(const unsigned char *imgData,
+                                const int lenImg, const int *faceBboxes,
+                                const int numBbox, float **feature,
+                                int *lenFeatures, Deadline deadline) {
+    *feature = nullptr;
+    *lenFeatures = 0;
+    int index = submit(kExtract, imgData, lenImg, faceBboxes, numBbox, deadline);
+    if (0 > index) {
+        return -1;
+    }
+    Slot *s = slot(index);
+    int ret = s->ret;
+    if (0 < s->lenFeatures) {
+        *feature = new float[s->lenFeatures];
+        memcpy(*feature, s->output(), sizeof(float) * s->lenFeatures);
+        *lenFeatures = s->lenFeatures;
+    }
+    releaseSlot(index);
+    return ret;
+}
+
+int FrWorkerPool::detectAndExtractFeature(const unsigned char *imgData,
+                                        const int lenImg, int **faceBboxes,
+                                        int *numBbox, float **feature,
+                                        int *lenFeatures, Deadline deadline) {
+    *faceBboxes = nullptr;
+    *numBbox = 0;
+    *feature = nullptr;
+    *lenFeatures = 0;
+    int index = submit(kDetect, imgData, lenImg, nullptr, 0, deadline);
+    if (0 > index) {
+        return -1;
+    }
+    Slot *s = slot(index);
+    int ret = s->ret;
+    int *boxes = reinterpret_cast<int*>(s->output());
+    if (0 < s->outBoxes) {
+        *faceBboxes = new int[4 * s->outBoxes];
+        memcpy(*faceBboxes, boxes, 4 * sizeof(int) * s->outBoxes);
+        *numBbox = s->outBoxes;
+    }
+    if (0 < s->lenFeatures) {
+        *feature = new float[s->lenFeatures];
+        memcpy(*feature, boxes + 4 * s->outBoxes,
+                sizeof(float) * s->lenFeatures);
+        *lenFeatures = s->lenFeatures;
+    }
+    releaseSlot(index);
+    return ret;
+}
+
+int FrWorkerPool::getQualityFaceCrops(const unsigned char *imgData,
+                                    const int lenImg, const int *faceBboxes,
+                                    const int numBbox, int *faceQuality,
+                                    float *faceDirection, Deadline deadline) {
+    int index = submit(kQuality, imgData, lenImg, faceBboxes, numBbox, deadline);
+    if (0 > index) {
+        return -1;
+    }
+    Slot *s = slot(index);
+    int ret = s->ret;
+    if (1 == ret) {
+        const int *quality = reinterpret_cast<int*>(s->output());
+        memcpy(faceQuality, quality, sizeof(int) * numBbox);
+        memcpy(faceDirection, quality + numBbox, sizeof(float) * numBbox);
+    }
+    releaseSlot(index);
+    return ret;
+}
+
+void FrWorkerPool::dump(std::ostream &os) const {
+    os << "Recognizer workers: " << shared_->readyWorkers << "/"
+        << options_.workers << " ready, " << shared_->calls << " calls, "
+        << shared_->failures << " failed, " << shared_->restarts
+        << " restarts" << std::endl;
+}
+
+void FrWorkerPool::exposition(std::ostream &os) const {
+    os << "# HELP fr_worker_ready Recognizer workers with their models"
+        << " loaded.\n"
+        << "# TYPE fr_worker_ready gauge\n"
+        << "fr_worker_ready " << shared_->readyWorkers << '\n'
+        << "# HELP fr_worker_calls_total Recognizer calls run by workers.\n"
+        << "# TYPE fr_worker_calls_total counter\n"
+        << "fr_worker_calls_total " << shared_->calls << '\n'
+        << "# HELP fr_worker_failures_total Recognizer calls failed, their"
+        << " worker dead included.\n"
+        << "# TYPE fr_worker_failures_total counter\n"
+        << "fr_worker_failures_total " << shared_->failures << '\n'
+        << "# HELP fr_worker_restarts_total Recognizer workers restarted.\n"
+        << "# TYPE fr_worker_restarts_total counter\n"
+        << "fr_worker_restarts_total " << shared_->restarts << '\n';
+}
+
+void FrWorkerPool::supervise() {
+    // Ctrl+c reaches the whole process group, the server alone handles it.
+    signal(SIGINT, SIG_IGN);
+    std::vector<pid_t> pids(options_.workers, -1);
+    std::vector<std::chrono::steady_clock::time_point> started(
+                                                options_.workers);
+    for (int i = 0; i < options_.workers; i++) {
+        pids[i] = spawn(i);
+        started[i] = std::chrono::steady_clock::now();
+    }
+    while (true) {
+        int status = 0;
+        pid_t dead = waitpid(-1, &status, 0);
+        if (0 > dead) {
+            if (EINTR == errno) {
+                continue;
+            }
+            _exit(1);
+        }
+        int index = 0;
+        while (index < options_.workers && pids[index] != dead) {
+            index++;
+        }
+        if (options_.workers == index) {
+            continue;
+        }
+        if (shared_->ready[index].exchange(0)) {
+            shared_->readyWorkers--;
+        }
+        recover(dead);
+        if (WIFEXITED(status) && kInitFailed == WEXITSTATUS(status)) {
+            shared_->failed = 1;
+            for (pid_t pid : pids) {
+                if (0 < pid) {
+                    kill(pid, SIGKILL);
+                }
+            }
+            _exit(1);
+        }
+        std::cout << "Recognizer worker " << index << " died ("
+                    << (WIFSIGNALED(status) ? "signal " : "exit ")
+                    << (WIFSIGNALED(status) ? WTERMSIG(status)
+                                            : WEXITSTATUS(status))
+                    << "), restarting" << std::endl;
+        if (std::chrono::steady_clock::now() - started[index]
+                < kRespawnDelay) {
+            std::this_thread::sleep_for(kRespawnDelay);
+        }
+        pids[index] = spawn(index);
+        started[index] = std::chrono::steady_clock::now();
+        shared_->restarts++;
+    }
+}
+
+pid_t FrWorkerPool::spawn(int index) {
+    pid_t parent = getpid();
+    pid_t pid = fork();
+    if (0 == pid) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != parent) {
+            _exit(0);
+        }
+        work(index);
+    }
+    return pid;
+}
+
+void FrWorkerPool::recover(pid_t worker) {
+    lockShared(&shared_->lock);
+    for (int i = 0; i < slots_; i++) {
+        Slot *s = slot(i);
+        if (kRunning == s->state && worker == s->worker) {
+            // Not run again, the same image could kill the next worker.
+            s->ret = -1;
+            s->outBoxes = 0;
+            s->lenFeatures = 0;
+            s->state = kDone;
+            sem_post(&s->done);
+        }
+    }
+    pthread_mutex_unlock(&shared_->lock);
+    // Its wakeup may have been taken with no call, another worker gets it.
+    sem_post(&shared_->pending);
+}
+
+void FrWorkerPool::work(int index) {
+    std::string logger = options_.loggerPath.empty() ? ""
+                        : options_.loggerPath + "." + std::to_string(index);
+    if (1 != HiarFace_initRecognizer(options_.modelPath.c_str(),
+                                logger.empty() ? nullptr : logger.c_str())) {
+        _exit(kInitFailed);
+    }
+    shared_->ready[index] = 1;
+    shared_->readyWorkers++;
+
+    pid_t self = getpid();
+    while (true) {
+        waitSem(&shared_->pending);
+        lockShared(&shared_->lock);
+        if (shared_->head == shared_->tail) {
+            pthread_mutex_unlock(&shared_->lock);
+            continue;
+        }
+        Slot *s = slot(shared_->ring()[shared_->head % slots_]);
+        shared_->head++;
+        if (kAbandoned == s->state) {
+            // Left before it ran, reclaim() frees it once done is posted.
+            s->ret = -1;
+            s->state = kDone;
+            sem_post(&s->done);
+            pthread_mutex_unlock(&shared_->lock);
+            continue;
+        }
+        s->worker = self;
+        s->state = kRunning;
+        pthread_mutex_unlock(&shared_->lock);
+
+        unsigned char *output = s->output();
+        size_t room = slotBytes_ - (output - s->image());
+        int ret = -1;
+        int outBoxes = 0;
+        int lenFeatures = 0;
+        if (kQuality == s->op) {
+            if ((sizeof(int) + sizeof(float)) * s->numBbox <= room) {
+                int *quality = reinterpret_cast<int*>(output);
+                ret = HiarFace_getQualityFaceCrops(s->image(), s->lenImg,
+                            s->boxes(), s->numBbox, quality,
+                            reinterpret_cast<float*>(quality + s->numBbox));
+            }
+        } else {
+            int *boxes = nullptr;
+            float *feature = nullptr;
+            if (kDetect == s->op) {
+                ret = HiarFace_detectAndExtractFeature(s->image(), s->lenImg,
+                            &boxes, &outBoxes, &feature, &lenFeatures);
+            } else {
+                ret = HiarFace_extractFeature(s->image(), s->lenImg,
+                            s->boxes(), s->numBbox, &feature, &lenFeatures);
+            }
+            if (nullptr == boxes) {
+                outBoxes = 0;
+            }
+            if (nullptr == feature) {
+                lenFeatures = 0;
+            }
+            size_t boxBytes = 4 * sizeof(int) * outBoxes;
+            if (0 > outBoxes || 0 > lenFeatures
+                || boxBytes + sizeof(float) * lenFeatures > room) {
+                ret = -1;
+                outBoxes = 0;
+                lenFeatures = 0;
+            }
+            if (0 < outBoxes) {
+                memcpy(output, boxes, boxBytes);
+            }
+            if (0 < lenFeatures) {
+                memcpy(output + boxBytes, feature,
+                        sizeof(float) * lenFeatures);
+            }
+            delete[] boxes;
+            delete[] feature;
+        }
+
+        lockShared(&shared_->lock);
+        s->ret = ret;
+        s->outBoxes = outBoxes;
+        s->lenFeatures = lenFeatures;
+        s->state = kDone;
+        sem_post(&s->done);
+        pthread_mutex_unlock(&shared_->lock);
+    }
+}
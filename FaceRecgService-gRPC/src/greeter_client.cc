@@ -16,17 +16,27 @@
  *
  */
 
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include <grpcpp/grpcpp.h>
 
 #include "FaceRecg.grpc.pb.h"
+#include "interface_face_recognizer.h"
+#include "fr_async_client.h"
+#include "fr_feature_codec.h"
+#include "fr_image_file.h"
+#include "fr_loadgen.h"
 
 using grpc::Channel;
 using grpc::ClientContext;
+using grpc::ClientReaderWriter;
 using grpc::Status;
 
 using facerecg::LogRequest;
@@ -37,13 +47,38 @@ using facerecg::Frecg;
 using facerecg::DetectRequest;
 using facerecg::CmpFeatureRequest;
 using facerecg::CmpFeatureReply;
+using facerecg::CmpBatchRequest;
+using facerecg::CmpBatchReply;
 using facerecg::CmpImageRequest;
 using facerecg::CmpImageReply;
 using facerecg::QualityRequest;
 using facerecg::QualityReply;
+using facerecg::FrameRequest;
+using facerecg::EnrollRequest;
+using facerecg::EnrollReply;
+using facerecg::IdentifyRequest;
+using facerecg::IdentifyReply;
+using facerecg::StatsRequest;
+using facerecg::StatsReply;
 
 using facerecg::AbsRect;
 
+/**
+ * Print where the time of an rpc went: the stages reported by the server,
+ * then the rest of the wall time, i.e. protobuf parsing and serialization
+ * on both sides plus the transport, which the server cannot see.
+ */
+template <class Reply>
+void printCost(const Reply &reply, double wallMs) {
+    std::cout << "Cost " << wallMs << " ms:";
+    for (const auto &timing : reply.stages()) {
+        std::cout << ' ' << timing.stage() << ' ' << timing.ms();
+    }
+    std::cout << ", server " << reply.costinms()
+                << ", transport+protobuf " << wallMs - reply.costinms()
+                << std::endl;
+}
+
 class FrClient {
     public:
         FrClient(std::shared_ptr<Channel> channel)
@@ -72,6 +107,27 @@ class FrClient {
             }
         }
 
+        std::string getStats() {
+            // Data we are sending to the server.
+            StatsRequest request;
+            // Container for the data we expect from the server.
+            StatsReply reply;
+            // Context for the client. It could be used to convey extra information to the server and/or tweak certain RPC behaviors.
+            ClientContext context;
+            // The actual RPC.
+            Status status = stub_->getStats(&context, request, &reply);
+            // Act upon its status.
+            if (status.ok()) {
+                std::cout << reply.text();
+                return reply.message();
+            } else {
+                std::cout << status.error_code() << ": "
+                            << status.error_message()
+                            << std::endl;
+                return "RPC failed";
+            }
+        }
+
         std::string getFaceQuality(const std::string& info,
                                 const std::vector<std::vector<int>> rois) {
             if (0 >= rois.size()) {
@@ -89,16 +145,7 @@ class FrClient {
             /**
              * Load image file as bytes flow.
              */
-            std::ifstream is(info, std::ifstream::in | std::ifstream::binary);
-            if (is) {
-                is.seekg(0, is.end);
-                int length = is.tellg();
-                is.seekg(0, is.beg);
-                char *buffer = new char[length];
-                is.read(buffer, length);
-                request.set_imagedata(buffer, length);
-                delete [] buffer;
-            } else {
+            if (!frLoadImage(info, request.mutable_imagedata())) {
                 return "Image loading error: " + info;
             }
             request.set_message(info);
@@ -107,9 +154,12 @@ class FrClient {
             // Context for the client. It could be used to convey extra information to the server and/or tweak certain RPC behaviors.
             ClientContext context;
             // The actual RPC.
+            auto start = std::chrono::steady_clock::now();
             Status status = stub_->getFaceQuality(&context, request, &reply);
             // Act upon its status.
             if (status.ok()) {
+                printCost(reply, std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start).count());
                 // std::ofstream f1("./tmp/quality.txt");
                 // if (f1) {
                 //     f1 << "Quality" << '\t' << "IsFrontal" << std::endl;
@@ -142,16 +192,7 @@ class FrClient {
             /**
              * Load image file as bytes flow.
              */
-            std::ifstream is(info, std::ifstream::in | std::ifstream::binary);
-            if (is) {
-                is.seekg(0, is.end);
-                int length = is.tellg();
-                is.seekg(0, is.beg);
-                char *buffer = new char[length];
-                is.read(buffer, length);
-                request.set_imagedata(buffer, length);
-                delete [] buffer;
-            } else {
+            if (!frLoadImage(info, request.mutable_imagedata())) {
                 return "Image loading error: " + info;
             }
             request.set_message(info);
@@ -160,9 +201,12 @@ class FrClient {
             // Context for the client. It could be used to convey extra information to the server and/or tweak certain RPC behaviors.
             ClientContext context;
             // The actual RPC.
+            auto start = std::chrono::steady_clock::now();
             Status status = stub_->featureExtract(&context, request, &reply);
             // Act upon its status.
             if (status.ok()) {
+                printCost(reply, std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start).count());
                 // std::cout << "valid roi number: " << reply.rects().size()
                 //             << std::endl;
                 // std::cout << reply.rects(0).left() << ' '
@@ -185,23 +229,16 @@ class FrClient {
             }
         }
 
-        std::string featureDetect(const std::string& info) {
+        std::string featureDetect(const std::string& info,
+                                FrFeatureEncoding encoding = kFrFloats) {
             // Data we are sending to the server.
             DetectRequest request;
+            request.set_encoding(
+                        static_cast<facerecg::FeatureEncoding>(encoding));
             /**
              * Load image file as bytes flow.
              */
-            std::ifstream is(info, std::ifstream::in | std::ifstream::binary);
-            if (is) {
-                is.seekg(0, is.end);
-                int length = is.tellg();
-                is.seekg(0, is.beg);
-                char *buffer = new char[length];
-                is.read(buffer, length);
-                request.set_imagedata(buffer, length);
-                delete [] buffer;
-                is.close();
-            } else {
+            if (!frLoadImage(info, request.mutable_imagedata())) {
                 return "Image loading error: " + info;
             }
             request.set_message(info);
@@ -210,13 +247,27 @@ class FrClient {
             // Context for the client. It could be used to convey extra information to the server and/or tweak certain RPC behaviors.
             ClientContext context;
             // The actual RPC.
+            auto start = std::chrono::steady_clock::now();
             Status status = stub_->featureDetect(&context, request, &reply);
             // Act upon its status.
             if (status.ok()) {
+                printCost(reply, std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start).count());
                 std::cout << reply.rects(0).left() << ' '
                         << reply.rects(0).top() << ' '
                         << reply.rects(0).width() << ' '
                         << reply.rects(0).height() << std::endl;
+                std::vector<float> features(reply.features().begin(),
+                                            reply.features().end());
+                if (kFrFloats != encoding
+                    && !frUnpackFeatures(encoding, reply.packedfeatures(),
+                                        HIAR_FACE_FEATURE_LEN, &features)) {
+                    return "Bad packed features";
+                }
+                std::cout << features.size() / HIAR_FACE_FEATURE_LEN
+                        << " features as " << frEncodingName(encoding)
+                        << ", reply " << reply.ByteSizeLong() << " bytes"
+                        << std::endl;
                 // std::ofstream f1("./tmp/1.txt");
                 // if (f1) {
                 //     for (int i = 0; i < reply.features().size(); i++) {
@@ -262,6 +313,48 @@ class FrClient {
             }
         }
 
+        std::string compareBatch(const std::vector<float> &probes,
+                                const std::vector<float> &candidates,
+                                int topK) {
+            // Data we are sending to the server, features packed.
+            CmpBatchRequest request;
+            for (auto i : probes) {
+                request.add_probes(i);
+            }
+            for (auto i : candidates) {
+                request.add_candidates(i);
+            }
+            request.set_topk(topK);
+            // Container for the data we expect from the server.
+            CmpBatchReply reply;
+            // Context for the client. It could be used to convey extra information to the server and/or tweak certain RPC behaviors.
+            ClientContext context;
+            // The actual RPC.
+            Status status = stub_->compareBatch(&context, request, &reply);
+            // Act upon its status.
+            if (status.ok()) {
+                for (int i = 0; i < reply.best().size(); i++) {
+                    std::cout << "Probe " << i << ":";
+                    for (int j = 0; j < reply.best(i).candidates().size();
+                            j++) {
+                        std::cout << ' ' << reply.best(i).candidates(j)
+                                << '=' << reply.best(i).scores(j);
+                    }
+                    std::cout << std::endl;
+                }
+                if (0 < reply.scores().size()) {
+                    std::cout << reply.scores().size() << " scores"
+                            << std::endl;
+                }
+                return reply.message();
+            } else {
+                std::cout << status.error_code() << ": "
+                            << status.error_message()
+                            << std::endl;
+                return "RPC failed";
+            }
+        }
+
         std::string compareImage(const std::string& imgA,
                                 const std::string& imgB,
                                 const std::vector<int>& roiA,
@@ -284,30 +377,10 @@ class FrClient {
                 return "Roi info error!!!";
             }
 
-            std::ifstream is(imgA, std::ifstream::in | std::ifstream::binary);
-            if (is) {
-                is.seekg(0, is.end);
-                int length = is.tellg();
-                is.seekg(0, is.beg);
-                char *buffer = new char[length];
-                is.read(buffer, length);
-                request.set_imagedataa(buffer, length);
-                delete[] buffer;
-                is.close();
-            } else {
+            if (!frLoadImage(imgA, request.mutable_imagedataa())) {
                 return "Image loading error: " + imgA;
             }
-            is.open(imgB, std::ifstream::in | std::ifstream::binary);
-            if (is) {
-                is.seekg(0, is.end);
-                int length = is.tellg();
-                is.seekg(0, is.beg);
-                char *buffer = new char[length];
-                is.read(buffer, length);
-                request.set_imagedatab(buffer, length);
-                delete[] buffer;
-                is.close();
-            } else {
+            if (!frLoadImage(imgB, request.mutable_imagedatab())) {
                 return "Image loading error: " + imgB;
             }
             // Container for the data we expect from the server.
@@ -328,72 +401,292 @@ class FrClient {
                 return "RPC failed";
             }
         }
-    private:
-        std::unique_ptr<Frecg::Stub> stub_;
-};
-
-int main(int argc, char** argv) {
-    // Instantiate the client. It requires a channel, out of which the actual RPCs
-    // are created. This channel models a connection to an endpoint specified by
-    // the argument "--target=" which is the only expected argument.
-    // We indicate that the channel isn't authenticated (use of
-    // InsecureChannelCredentials()).
-    std::string target_str;
-    std::string arg_server("--target");
-    std::string image_str;
-    std::string arg_image("--image");
-    if (3 == argc) {
-        std::string arg_val = argv[1];
-        size_t start_pos = arg_val.find(arg_server);
-        if (start_pos != std::string::npos) {
-            start_pos += arg_server.size();
-            if (arg_val[start_pos] == '=') {
-                target_str = arg_val.substr(start_pos + 1);
+        std::string enroll(const std::string &id,
+                            const std::vector<float> &feature) {
+            // Data we are sending to the server.
+            EnrollRequest request;
+            request.set_id(id);
+            for (auto i : feature) {
+                request.add_feature(i);
+            }
+            // Container for the data we expect from the server.
+            EnrollReply reply;
+            // Context for the client. It could be used to convey extra information to the server and/or tweak certain RPC behaviors.
+            ClientContext context;
+            // The actual RPC.
+            Status status = stub_->enroll(&context, request, &reply);
+            // Act upon its status.
+            if (status.ok()) {
+                std::cout << "Gallery size: " << reply.gallerysize()
+                        << std::endl;
+                return reply.message();
             } else {
-                std::cout << "The only correct argument syntax is --target="
+                std::cout << status.error_code() << ": "
+                            << status.error_message()
                             << std::endl;
-                return 0;
+                return "RPC failed";
             }
-        } else {
-            std::cout << "The only acceptable argument is \
-                            --target=XXX --image=YYY"
-                        << std::endl;
-            return 0;
         }
 
-        arg_val = argv[2];
-        start_pos = arg_val.find(arg_image);
-        if (start_pos != std::string::npos) {
-            start_pos += arg_image.size();
-            if (arg_val[start_pos] == '=') {
-                image_str = arg_val.substr(start_pos + 1);
+        std::string identify(const std::vector<float> &feature, int topK) {
+            // Data we are sending to the server.
+            IdentifyRequest request;
+            for (auto i : feature) {
+                request.add_feature(i);
+            }
+            request.set_topk(topK);
+            // Container for the data we expect from the server.
+            IdentifyReply reply;
+            // Context for the client. It could be used to convey extra information to the server and/or tweak certain RPC behaviors.
+            ClientContext context;
+            // The actual RPC.
+            Status status = stub_->identify(&context, request, &reply);
+            // Act upon its status.
+            if (status.ok()) {
+                for (auto &match : reply.matches()) {
+                    std::cout << match.id() << ": " << match.score()
+                            << std::endl;
+                }
+                return reply.message();
             } else {
-                std::cout << "The only correct argument syntax is --image="
+                std::cout << status.error_code() << ": "
+                            << status.error_message()
                             << std::endl;
-                return 0;
+                return "RPC failed";
             }
-        } else {
-            std::cout << "The only acceptable argument is \
-                            --target=XXX --image=YYY"
+        }
+
+        std::string featureStream(const std::string& info, int frames,
+                                int window) {
+            // Data we are sending to the server, the same image as every frame.
+            FrameRequest frame;
+            /**
+             * Load image file as bytes flow.
+             */
+            if (!frLoadImage(info, frame.mutable_imagedata())) {
+                return "Image loading error: " + info;
+            }
+            frame.set_message(info);
+            // Context for the client. It could be used to convey extra information to the server and/or tweak certain RPC behaviors.
+            ClientContext context;
+            // The actual RPC, one stream for all frames.
+            std::unique_ptr<ClientReaderWriter<FrameRequest, FeatureReply>>
+                                    stream(stub_->featureStream(&context));
+
+            /**
+             * The writer keeps at most "window" frames without reply,
+             * the replies are consumed on this thread.
+             */
+            std::mutex mtx;
+            std::condition_variable cv;
+            int inFlight = 0;
+            bool readDone = false;
+            auto start = std::chrono::steady_clock::now();
+            std::thread writer([&]() {
+                for (int i = 0; i < frames; i++) {
+                    {
+                        std::unique_lock<std::mutex> lock(mtx);
+                        cv.wait(lock, [&]() {
+                            return readDone || inFlight < window;
+                        });
+                        if (readDone) {
+                            break;
+                        }
+                        inFlight++;
+                    }
+                    frame.set_frameseq(i);
+                    if (!stream->Write(frame)) {
+                        break;
+                    }
+                }
+                stream->WritesDone();
+            });
+
+            FeatureReply reply;
+            int received = 0;
+            while (stream->Read(&reply)) {
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    inFlight--;
+                }
+                cv.notify_one();
+                received++;
+                std::cout << "Frame " << reply.frameseq() << ": "
+                            << reply.rects().size() << " faces, "
+                            << reply.skipped().size() << " skipped, "
+                            << reply.costinms() << " ms on server"
+                            << std::endl;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                readDone = true;
+            }
+            cv.notify_one();
+            writer.join();
+
+            Status status = stream->Finish();
+            double costInS = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start).count();
+            std::cout << received << " frames in " << costInS << " s, "
+                        << (0 < costInS ? received / costInS : 0) << " fps"
                         << std::endl;
-            return 0;
+            // Act upon its status.
+            if (status.ok()) {
+                return reply.message();
+            } else {
+                std::cout << status.error_code() << ": "
+                            << status.error_message()
+                            << std::endl;
+                return "RPC failed";
+            }
+        }
+    private:
+        std::unique_ptr<Frecg::Stub> stub_;
+};
+
+/**
+ * Find the value of "--key=value" in arguments, or the default one.
+ */
+std::string getArg(int argc, char** argv, const std::string &key,
+                    const std::string &defVal) {
+    std::string prefix = "--" + key + "=";
+    for (int i = 1; i < argc; i++) {
+        std::string arg_val = argv[i];
+        if (0 == arg_val.compare(0, prefix.size(), prefix)) {
+            return arg_val.substr(prefix.size());
+        }
+    }
+    return defVal;
+}
+
+/**
+ * Send one image "calls" times through the asynchronous client.
+ */
+std::string pipelineDetect(const std::string &target,
+                            const std::string &info, int calls,
+                            int channels, int window) {
+    DetectRequest request;
+    if (!frLoadImage(info, request.mutable_imagedata())) {
+        return "Image loading error: " + info;
+    }
+    request.set_message(info);
+
+    FrAsyncClient client(target, channels, window);
+    std::mutex mtx;
+    int failed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++) {
+        client.featureDetect(request, [&mtx, &failed, i](
+                                const Status &status, FeatureReply &reply) {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!status.ok()) {
+                failed++;
+                std::cout << "Call " << i << ": " << status.error_code()
+                            << ": " << status.error_message() << std::endl;
+            }
+        });
+    }
+    client.drain();
+    double costInS = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count();
+    std::cout << calls << " calls in " << costInS << " s, "
+                << (0 < costInS ? calls / costInS : 0) << " calls/s, "
+                << failed << " failed" << std::endl;
+    return 0 == failed ? "In pipeline" : "RPC failed";
+}
+
+int main(int argc, char** argv) {
+    // Instantiate the client. It requires a channel, out of which the actual RPCs
+    // are created. This channel models a connection to an endpoint specified by
+    // the argument "--target=".
+    // We indicate that the channel isn't authenticated (use of
+    // InsecureChannelCredentials()).
+    // "--stream=N" sends the image N times as frames of featureStream,
+    // with at most "--window=W" frames waiting for their replies.
+    // "--stats=1" prints the metrics of the server and exits.
+    // "--encoding=floats|f32|f16|i8" is the encoding of the features
+    // returned by featureDetect.
+    // "--pipeline=N" sends the image N times to featureDetect with at most
+    // "--window=W" rpcs in flight over "--channels=C" channels.
+    // "--load=closed|open" runs a load generator instead, see fr_loadgen.h
+    // for its options, and appends its JSON report as one line to
+    // "--report=", stdout by default.
+    std::string target_str = getArg(argc, argv, "target", "localhost:50051");
+    std::string load_mode = getArg(argc, argv, "load", "");
+    if (!load_mode.empty()) {
+        FrLoadOptions load;
+        load.target = target_str;
+        load.mode = load_mode;
+        load.concurrency = std::stoi(getArg(argc, argv, "concurrency",
+                                    std::to_string(load.concurrency)));
+        load.qps = std::stod(getArg(argc, argv, "qps",
+                                    std::to_string(load.qps)));
+        load.duration = std::stod(getArg(argc, argv, "duration",
+                                    std::to_string(load.duration)));
+        load.channels = std::stoi(getArg(argc, argv, "channels",
+                                    std::to_string(load.channels)));
+        load.images = getArg(argc, argv, "images", load.images);
+        load.mix = getArg(argc, argv, "mix", load.mix);
+        load.deadlineMs = std::stod(getArg(argc, argv, "deadline_ms",
+                                    std::to_string(load.deadlineMs)));
+        load.tenant = getArg(argc, argv, "tenant", load.tenant);
+        load.priority = getArg(argc, argv, "priority", load.priority);
+        std::string report_path = getArg(argc, argv, "report", "");
+        if (report_path.empty()) {
+            return frRunLoad(load, std::cout) ? 0 : 1;
         }
-    } else {
-        target_str = "localhost:50051";
-        image_str = "test.jpg";
+        std::ofstream report(report_path, std::ofstream::app);
+        return frRunLoad(load, report) ? 0 : 1;
+    }
+    std::string image_str = getArg(argc, argv, "image", "test.jpg");
+    int stream_frames = std::stoi(getArg(argc, argv, "stream", "0"));
+    int stream_window = std::stoi(getArg(argc, argv, "window", "4"));
+    if (0 >= stream_window) {
+        // Nothing could ever be in flight, the client would wait forever.
+        std::cout << "--window must be positive" << std::endl;
+        return 1;
     }
     FrClient greeter(grpc::CreateChannel(target_str,
                         grpc::InsecureChannelCredentials()));
+    if ("1" == getArg(argc, argv, "stats", "0")) {
+        /**
+         *  Call rpc getStats (StatsRequest) returns (StatsReply) {}
+         */
+        std::cout << "faceRecg: " << greeter.getStats() << std::endl;
+        return 0;
+    }
     /**
      *  Call rpc logIn (LogRequest) returns (LogReply) {}
      */
     std::string user("My Lovely World");
     std::string reply = greeter.logIn(user);
     std::cout << "Alg Version: " << reply << std::endl;
+    int pipeline_calls = std::stoi(getArg(argc, argv, "pipeline", "0"));
+    if (0 < pipeline_calls) {
+        reply = pipelineDetect(target_str, image_str, pipeline_calls,
+                        std::stoi(getArg(argc, argv, "channels", "1")),
+                        stream_window);
+        std::cout << "faceRecg: " << reply << std::endl << std::endl;
+        return 0;
+    }
+    if (0 < stream_frames) {
+        /**
+         *  Call rpc featureStream (stream FrameRequest) returns (stream FeatureReply) {}
+         */
+        reply = greeter.featureStream(image_str, stream_frames, stream_window);
+        std::cout << "faceRecg: " << reply << std::endl << std::endl;
+        return 0;
+    }
     /**
      *  Call rpc featureDetect (DetectRequest) returns (FeatureReply) {}
      */
-    reply = greeter.featureDetect(image_str);
+    FrFeatureEncoding encoding = kFrFloats;
+    if (!frParseEncoding(getArg(argc, argv, "encoding", "floats"),
+                        &encoding)) {
+        std::cout << "--encoding is floats, f32, f16 or i8" << std::endl;
+        return 1;
+    }
+    reply = greeter.featureDetect(image_str, encoding);
     std::cout << "faceRecg: " << reply << std::endl << std::endl;
     // /**
     //  *  Call rpc featureExtract (FeatureRequest) returns (FeatureReply) {}
@@ -436,6 +729,21 @@ int main(int argc, char** argv) {
     // reply = greeter.compareFeature(cmpA, cmpB);
     // std::cout << "faceRecg: " << reply << std::endl << std::endl;
     // /**
+    //  *  Call rpc compareBatch (CmpBatchRequest) returns (CmpBatchReply) {}
+    //  */
+    // std::vector<float> candidates(cmpA);
+    // candidates.insert(candidates.end(), cmpB.begin(), cmpB.end());
+    // reply = greeter.compareBatch(cmpA, candidates, 2);
+    // std::cout << "faceRecg: " << reply << std::endl << std::endl;
+    // /**
+    //  *  Call rpc enroll (EnrollRequest) returns (EnrollReply) {}
+    //  *  Call rpc identify (IdentifyRequest) returns (IdentifyReply) {}
+    //  */
+    // reply = greeter.enroll("someone", cmpA);
+    // std::cout << "faceRecg: " << reply << std::endl << std::endl;
+    // reply = greeter.identify(cmpB, 5);
+    // std::cout << "faceRecg: " << reply << std::endl << std::endl;
+    // /**
     //  *  Call rpc compareImage (CmpImageRequest) returns (CmpImageReply) {}
     //  */
     // std::vector<int> roiA({45, 85, 218, 218});
@@ -16,9 +16,15 @@
  *
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
 
 #include <grpcpp/grpcpp.h>
 #include <grpcpp/health_check_service_interface.h>
@@ -30,27 +36,62 @@
 #include <opencv2/imgcodecs/legacy/constants_c.h>
 
 #include "interface_face_recognizer.h"
+#include "fr_admission.h"
+#include "fr_affinity.h"
+#include "fr_arena.h"
+#include "fr_async_server.h"
+#include "fr_batcher.h"
+#include "fr_feature_cache.h"
+#include "fr_feature_codec.h"
+#include "fr_bounded_queue.h"
+#include "fr_config.h"
+#include "fr_gallery.h"
+#include "fr_gallery_store.h"
+#include "fr_image_context.h"
+#include "fr_metrics.h"
+#include "fr_scheduler.h"
+#include "fr_similarity.h"
+#include "fr_singleflight.h"
+#include "fr_stage_timer.h"
+#include "fr_thread_pool.h"
+#include "fr_worker_pool.h"
 
 #include <signal.h>
 
 using grpc::Server;
 using grpc::ServerBuilder;
 using grpc::ServerContext;
+using grpc::ServerReaderWriter;
 using grpc::Status;
 
 using facerecg::LogRequest;
 using facerecg::LogReply;
 using facerecg::FeatureRequest;
 using facerecg::FeatureReply;
+using facerecg::SkippedFace;
 using facerecg::Frecg;
 using facerecg::AbsRect;
 using facerecg::DetectRequest;
 using facerecg::CmpFeatureRequest;
 using facerecg::CmpFeatureReply;
+using facerecg::CmpBatchRequest;
+using facerecg::CmpBatchReply;
+using facerecg::CandidateScores;
 using facerecg::CmpImageRequest;
 using facerecg::CmpImageReply;
 using facerecg::QualityRequest;
 using facerecg::QualityReply;
+using facerecg::FrameRequest;
+using facerecg::EnrollRequest;
+using facerecg::EnrollReply;
+using facerecg::RemoveRequest;
+using facerecg::RemoveReply;
+using facerecg::IdentifyRequest;
+using facerecg::IdentifyReply;
+using facerecg::StatsRequest;
+using facerecg::StatsReply;
+using facerecg::RawImage;
+using facerecg::FeatureEncoding;
 
 #define VERSION  "1.0.0.8"
 
@@ -63,10 +104,105 @@ void sigint_handler(int sig) {
     }
     return;
 }
+/**
+ * Options of the server, given as --key=value.
+ */
+struct ServerOptions {
+    /// "sync" or "async".
+    std::string mode = "sync";
+    /// Completion queues of async mode, 0 means one per core.
+    int cqs = 0;
+    /// Pollers of each completion queue in async mode.
+    int pollers = 2;
+    /// Threads running the handlers in async mode, 0 means one per core
+    /// and -1 runs them on the pollers, a slow SDK call then stalls every
+    /// rpc of its completion queue.
+    int asyncHandlers = 0;
+    /// Frames of one featureStream queued before being served.
+    int streamWindow = 4;
+    /// Max faces of one extraction batch, 0 disables batching.
+    int batchSize = 0;
+    /// Max time an extraction waits for its batch to fill.
+    int batchWaitUs = 2000;
+    /// Extraction batches run at the same time.
+    int batchWorkers = 2;
+    /// Threads sharing the scan of the gallery and extracting the two
+    /// faces of compareImage, 0 means one per core.
+    int galleryThreads = 0;
+    /// Search of the gallery: "flat", "hnsw" or "ivfpq".
+    std::string index = "flat";
+    FrHnswParams hnsw;
+    FrIvfPqParams ivfpq;
+    /// Gallery file loaded at startup and kept up to date, empty for none.
+    std::string galleryPath;
+    FrGalleryStoreOptions galleryStore;
+    /// Decode an image once for all the SDK calls of a request. Off until
+    /// fr_bench --mode=decode --models shows that the SDK in use reads the
+    /// BMP faster than it decodes the JPEG twice.
+    bool decodeOnce = false;
+    /// Faces with a lower quality, in [0, 10], get no feature.
+    int minQuality = 5;
+    /// Faces with a direction score up to this one are not frontal.
+    float minDirection = 0;
+    /// Score the given faces before extracting them, so that rejected
+    /// faces cost no extraction. Detected faces are always scored after,
+    /// the SDK detects and extracts in one call.
+    bool qualityFirst = true;
+    /// Port serving the metrics over HTTP for Prometheus, 0 for none.
+    /// They are also returned by the getStats rpc.
+    int metricsPort = 0;
+    /// Address the metrics port listens on, only the host by default,
+    /// "0.0.0.0" lets remote scrapers in.
+    std::string metricsAddress = "127.0.0.1";
+    /// Memory of the feature cache of given face boxes, 0 disables it.
+    int featureCacheMb = 0;
+    /// Lifetime of a cached feature, 0 for no limit.
+    double featureCacheTtl = 600;
+    /// Serve identical concurrent featureDetect, featureStream frames and
+    /// featureExtract requests with one computation.
+    bool coalesce = true;
+    /// Bound the queue and the concurrency of every rpc but logIn and
+    /// getStats, and shed requests that would miss their deadline.
+    /// In async mode requests wait on the handler threads, so fewer
+    /// threads than slots leave the limit unreached.
+    bool admission = true;
+    FrAdmissionOptions admissionLimits;
+    /// Recognizer calls run at once, by priority class and tenant, 0
+    /// means one per core and -1 runs them as they come. Batched
+    /// extractions hold a slot while their batch fills, so batches are
+    /// at most this many calls.
+    int schedSlots = 0;
+    /// Weights of the tenants sharing the recognizer, e.g. "kiosk:4",
+    /// 1 for the others.
+    std::map<std::string, double> tenantWeights;
+    /// Address the server listens on.
+    std::string address = "0.0.0.0:50051";
+    /// Max threads serving the rpcs in sync mode, 0 for gRPC's default.
+    /// Async mode sizes them with cqs and pollers.
+    int ioThreads = 0;
+    /// Threads decoding images and calling the recognizer, 0 runs them on
+    /// the rpc threads.
+    int computeThreads = 0;
+    /// CPUs the compute and gallery threads are pinned to: "all",
+    /// "node:N" or a list such as "0-7,16-23", empty for none.
+    std::string computeCpus;
+    /// Recognizer worker processes, 0 runs the recognizer in the server
+    /// process.
+    int workers = 0;
+    FrWorkerPoolOptions workerPool;
+    /// Sizes of the synthetic images run through the recognizer before
+    /// serving, none to serve at once.
+    std::vector<cv::Size> warmupSizes{cv::Size(640, 480),
+                                    cv::Size(1920, 1080)};
+    /// Warm-up calls of each size, on every worker.
+    int warmupRuns = 2;
+};
+
 // Logic and data behind the server's behavior.
 class FrServiceImpl final : public Frecg::Service {
     Status logIn(ServerContext* context, const LogRequest* request,
                     LogReply* reply) override {
+        FrRpcScope rpcScope(&metrics, FrMetrics::kLogIn);
         std::cout << "Someone use logIn~" << std::endl;
         std::string prefix("Hello ");
         reply->set_message(prefix + request->message());
@@ -77,25 +213,48 @@ class FrServiceImpl final : public Frecg::Service {
     Status compareFeature(ServerContext* context,
                         const CmpFeatureRequest* request,
                         CmpFeatureReply* reply) override {
+        if (!serving) {
+            return warmingUp();
+        }
+        FrAdmitScope admit(admission.get(), FrMetrics::kCompareFeature,
+                            context->deadline());
+        if (!admit.admitted()) {
+            return rejection(admit.verdict());
+        }
+        FrRpcScope rpcScope(&metrics, FrMetrics::kCompareFeature);
+        FrSchedClass work = schedClassOf(context, FrMetrics::kCompareFeature);
         reply->set_message("In compareFeature");
+        if (facerecg::FLOATS != request->encoding()) {
+            std::vector<float> faceA;
+            std::vector<float> faceB;
+            FrFeatureEncoding encoding =
+                        static_cast<FrFeatureEncoding>(request->encoding());
+            if (!facerecg::FeatureEncoding_IsValid(request->encoding())
+                || !frUnpackFeatures(encoding, request->packeda(),
+                                    HIAR_FACE_FEATURE_LEN, &faceA)
+                || !frUnpackFeatures(encoding, request->packedb(),
+                                    HIAR_FACE_FEATURE_LEN, &faceB)
+                || static_cast<size_t>(HIAR_FACE_FEATURE_LEN) != faceA.size()
+                || static_cast<size_t>(HIAR_FACE_FEATURE_LEN) != faceB.size()) {
+                reply->set_resemblance(0);
+                reply->set_message("In compareFeature, bad packed features!");
+                return Status::OK;
+            }
+            FrSchedScope slot(scheduler.get(), work, 1);
+            reply->set_resemblance(HiarFace_compareFaceFeature(
+                                    faceA.data(), HIAR_FACE_FEATURE_LEN,
+                                    faceB.data(), HIAR_FACE_FEATURE_LEN));
+            return Status::OK;
+        }
         if (0 != request->featurea().size()
             && request->featurea().size() == request->featureb().size()) {
-            float *faceA = new float[request->featurea().size()];
-            float *faceB = new float[request->featureb().size()];
-
-            for (int i = 0; i < request->featurea().size(); i++) {
-                faceA[i] = request->featurea(i);
-                faceB[i] = request->featureb(i);
-            }
-
+            // Scored where they were parsed, no copy.
+            FrSchedScope slot(scheduler.get(), work, 1);
             float resemblance =
-                HiarFace_compareFaceFeature(faceA, request->featurea().size(),
-                                            faceB, request->featureb().size());
-
-            delete[] faceA;
-            delete[] faceB;
-            faceA = nullptr;
-            faceB = nullptr;
+                HiarFace_compareFaceFeature(request->featurea().data(),
+                                            request->featurea().size(),
+                                            request->featureb().data(),
+                                            request->featureb().size());
             reply->set_resemblance(resemblance);
         } else {
             reply->set_resemblance(0);
@@ -104,49 +263,160 @@ class FrServiceImpl final : public Frecg::Service {
         return Status::OK;
     }
 
+    Status compareBatch(ServerContext* context,
+                        const CmpBatchRequest* request,
+                        CmpBatchReply* reply) override {
+        if (!serving) {
+            return warmingUp();
+        }
+        FrAdmitScope admit(admission.get(), FrMetrics::kCompareBatch,
+                            context->deadline());
+        if (!admit.admitted()) {
+            return rejection(admit.verdict());
+        }
+        FrRpcScope rpcScope(&metrics, FrMetrics::kCompareBatch);
+        reply->set_message("In compareBatch");
+        // Only features of the SDK: a short featureLen from the client
+        // would turn small requests into a huge score matrix.
+        if (0 != request->featurelen()
+            && HIAR_FACE_FEATURE_LEN != request->featurelen()) {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT,
+                            "In compareBatch, featureLen is not the SDK's!");
+        }
+        const int len = HIAR_FACE_FEATURE_LEN;
+        int probeFloats = request->probes().size();
+        int candidateFloats = request->candidates().size();
+        if (0 == probeFloats || 0 != probeFloats % len
+            || 0 == candidateFloats || 0 != candidateFloats % len) {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT,
+                            "In compareBatch, lengthes dismatched!");
+        }
+        int m = probeFloats / len;
+        int n = candidateFloats / len;
+        // Scores of one reply, 64 MB, checked before allocating them.
+        const int64_t kMaxScores = 16 << 20;
+        if (static_cast<int64_t>(m) * n > kMaxScores) {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT,
+                            "In compareBatch, too many scores!");
+        }
+        FrSimilarity similarity = CmpBatchRequest::DOT
+                                    == request->similarity()
+                                    ? kFrDot : kFrCosine;
+        FrSchedScope slot(scheduler.get(),
+                        schedClassOf(context, FrMetrics::kCompareBatch), m);
+        // Features are scored in place, where they were parsed.
+        if (0 >= request->topk()) {
+            reply->mutable_scores()->Resize(m * n, 0);
+            frScoreMatrix(request->probes().data(), m,
+                        request->candidates().data(), n, len, similarity,
+                        reply->mutable_scores()->mutable_data());
+            return Status::OK;
+        }
+        std::vector<float> scores(static_cast<size_t>(m) * n);
+        frScoreMatrix(request->probes().data(), m,
+                    request->candidates().data(), n, len, similarity,
+                    scores.data());
+        std::vector<std::pair<int, float>> best;
+        for (int i = 0; i < m; i++) {
+            frTopK(&scores[static_cast<size_t>(i) * n], n, request->topk(),
+                    &best);
+            CandidateScores *row = reply->add_best();
+            for (const auto &candidate : best) {
+                row->add_candidates(candidate.first);
+                row->add_scores(candidate.second);
+            }
+        }
+        return Status::OK;
+    }
+
     Status compareImage(ServerContext* context,
                         const CmpImageRequest* request,
                         CmpImageReply* reply) override {
+        if (!serving) {
+            return warmingUp();
+        }
+        FrAdmitScope admit(admission.get(), FrMetrics::kCompareImage,
+                            context->deadline());
+        if (!admit.admitted()) {
+            return rejection(admit.verdict());
+        }
+        FrRpcScope rpcScope(&metrics, FrMetrics::kCompareImage);
+        FrSchedClass work = schedClassOf(context, FrMetrics::kCompareImage);
         reply->set_message("In compareImage");
-        float *featureA = nullptr;
-        float *featureB = nullptr;
-        int len_features;
-        int ret = 0;
         if (request->has_recta() && request->has_rectb()) {
-            int face_bboxesA[4] = {request->recta().left(),
+            int face_bboxes[8] = {request->recta().left(),
                                     request->recta().top(),
                                     request->recta().width(),
-                                    request->recta().height()};
-            int face_bboxesB[4] = {request->rectb().left(),
+                                    request->recta().height(),
+                                    request->rectb().left(),
                                     request->rectb().top(),
                                     request->rectb().width(),
                                     request->rectb().height()};
+            float *featureA = nullptr;
+            float *featureB = nullptr;
+            int lenA = 0;
+            int lenB = 0;
+            int retA = 0;
+            int retB = 0;
+
+            // Both faces are often cropped from the same photo.
+            bool samePhoto = request->imagedataa() == request->imagedatab();
+            onCompute([&]() {
+                FrImageContext imageA(
+                            (unsigned char *)request->imagedataa().c_str(),
+                            request->imagedataa().size(), 1, decodeOnce);
+                imageA.setDeadline(context->deadline());
+                if (samePhoto) {
+                    // One decode and one call for both faces.
+                    FrSchedScope slot(scheduler.get(), work, 2);
+                    retA = extract(imageA, face_bboxes, 2, &featureA, &lenA);
+                    if (1 == retA && 2 * HIAR_FACE_FEATURE_LEN == lenA) {
+                        retB = retA;
+                        lenA = HIAR_FACE_FEATURE_LEN;
+                        lenB = HIAR_FACE_FEATURE_LEN;
+                    }
+                    return;
+                }
+                // A is decoded and extracted by the pool while this
+                // thread does B, the latency is the slower of both.
+                // The slot is taken here for both: a pool task waiting for
+                // a slot could block the gallery scans of identify calls
+                // that hold all the slots.
+                FrSchedScope slot(scheduler.get(), work, 2);
+                std::future<void> doneA = parallelPool->submit(
+                    [this, &imageA, &face_bboxes, &featureA, &lenA,
+                        &retA]() {
+                        retA = extract(imageA, face_bboxes, 1,
+                                        &featureA, &lenA);
+                    });
+                FrImageContext imageB(
+                            (unsigned char *)request->imagedatab().c_str(),
+                            request->imagedatab().size(), 1, decodeOnce);
+                imageB.setDeadline(context->deadline());
+                retB = extract(imageB, face_bboxes + 4, 1, &featureB, &lenB);
+                doneA.get();
+            });
+            if (workersLost()) {
+                delete[] featureA;
+                delete[] featureB;
+                return workersGone();
+            }
+            // Feature of B follows the one of A when extracted together.
+            const float *faceB = samePhoto
+                                ? featureA + HIAR_FACE_FEATURE_LEN : featureB;
 
-            ret = HiarFace_extractFeature(
-                                (unsigned char *)request->imagedataa().c_str(),
-                                request->imagedataa().size(),
-                                face_bboxesA,
-                                1,
-                                &featureA,
-                                &len_features);
-
-            // std::cout << face_bboxesB[0] << face_bboxesB[1]
-            //         << face_bboxesB[2] << face_bboxesB[3] << std::endl;
-            // saveImage(request->imagedatab().c_str(), request->imagedatab().size());
-            ret = HiarFace_extractFeature(
-                                (unsigned char *)request->imagedatab().c_str(),
-                                request->imagedatab().size(),
-                                face_bboxesB,
-                                1,
-                                &featureB,
-                                &len_features);
-            // std::cout << face_bboxesA[0] << face_bboxesA[1]
-            //         << face_bboxesA[2] << face_bboxesA[3] << std::endl;
-
-            float resemblance = HiarFace_compareFaceFeature(featureA,
+            float resemblance = 0;
+            if (1 != retA || HIAR_FACE_FEATURE_LEN != lenA) {
+                reply->set_message("In compareImage: no feature of face A!!!");
+            } else if (1 != retB || HIAR_FACE_FEATURE_LEN != lenB) {
+                reply->set_message("In compareImage: no feature of face B!!!");
+            } else {
+                FrSchedScope slot(scheduler.get(), work, 1);
+                resemblance = HiarFace_compareFaceFeature(featureA,
                                                         HIAR_FACE_FEATURE_LEN,
-                                                        featureB,
+                                                        faceB,
                                                         HIAR_FACE_FEATURE_LEN);
+            }
             delete[] featureA;
             delete[] featureB;
             reply->set_resemblance(resemblance);
@@ -159,6 +429,16 @@ class FrServiceImpl final : public Frecg::Service {
 
     Status getFaceQuality(ServerContext* context, const QualityRequest* request,
                     QualityReply* reply) override {
+        if (!serving) {
+            return warmingUp();
+        }
+        FrAdmitScope admit(admission.get(), FrMetrics::kGetFaceQuality,
+                            context->deadline());
+        if (!admit.admitted()) {
+            return rejection(admit.verdict());
+        }
+        FrRpcScope rpcScope(&metrics, FrMetrics::kGetFaceQuality);
+        FrStageTimer timer;
         reply->set_message("In getFaceQuality");
         int num_bbox = request->rects().size();
         if (0 >= num_bbox) {
@@ -166,8 +446,8 @@ class FrServiceImpl final : public Frecg::Service {
             return Status::OK;
         }
 
-        int *face_quality = new int[num_bbox];
-        float *face_direction = new float[num_bbox];
+        int *face_quality = new int[num_bbox]();
+        float *face_direction = new float[num_bbox]();
         int *face_bboxes = new int[4 * num_bbox];
         for (int i = 0; i < num_bbox; i++) {
             face_bboxes[4 * i] = request->rects(i).left();
@@ -176,13 +456,16 @@ class FrServiceImpl final : public Frecg::Service {
             face_bboxes[4 * i + 3] = request->rects(i).height();
         }
 
-        int ret = HiarFace_getQualityFaceCrops(
-                        (unsigned char *)request->imagedata().c_str(),
-                        request->imagedata().size(),
-                        face_bboxes,
-                        num_bbox,
-                        face_quality,
+        FrSchedClass work = schedClassOf(context, FrMetrics::kGetFaceQuality);
+        onCompute([&]() {
+            FrImageContext image((unsigned char *)request->imagedata().c_str(),
+                                request->imagedata().size(), 1, decodeOnce);
+            image.setDeadline(context->deadline());
+            FrSchedScope slot(scheduler.get(), work, num_bbox);
+            FrStageScope stage(&timer, "quality");
+            qualityOf(image, face_bboxes, num_bbox, face_quality,
                         face_direction);
+        });
         if (nullptr != face_quality) {
             for (int i = 0; i < num_bbox; i++) {
                 reply->add_quality(face_quality[i]);
@@ -201,18 +484,66 @@ class FrServiceImpl final : public Frecg::Service {
             delete[] face_bboxes;
             face_bboxes = nullptr;
         }
+        if (workersLost()) {
+            return workersGone();
+        }
+        timer.fill(reply);
+        metrics.stages(timer);
         return Status::OK;
     }
 
     Status featureExtract(ServerContext* context, const FeatureRequest* request,
                     FeatureReply* reply) override {
+        if (!serving) {
+            return warmingUp();
+        }
+        FrAdmitScope admit(admission.get(), FrMetrics::kFeatureExtract,
+                            context->deadline());
+        if (!admit.admitted()) {
+            return rejection(admit.verdict());
+        }
+        FrRpcScope rpcScope(&metrics, FrMetrics::kFeatureExtract);
+        FrStageTimer timer;
         reply->set_message("In featureExtract");
+        reply->set_encoding(replyEncoding(request->encoding()));
 
-        extract_feature((unsigned char *)request->imagedata().c_str(),
-                        request->imagedata().size(),
-                        reply,
-                        false,
-                        request);
+        // Extraction then quality scoring.
+        FrSchedClass work = schedClassOf(context, FrMetrics::kFeatureExtract);
+        bool decodable = true;
+        bool timely = true;
+        onCompute([&]() {
+            std::unique_ptr<FrImageContext> image = openImage(
+                                request->imagedata(), request->has_rawimage()
+                                ? &request->rawimage() : nullptr, 2,
+                                context->deadline());
+            if (!image) {
+                decodable = false;
+                return;
+            }
+            timely = coalescedExtract(*image,
+                                    reply,
+                                    false,
+                                    request,
+                                    &timer,
+                                    work,
+                                    context->deadline());
+        });
+        if (!decodable) {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT,
+                            "In featureExtract: bad raw image!!!");
+        }
+        if (workersLost()) {
+            return workersGone();
+        }
+        if (!timely) {
+            return Status(grpc::StatusCode::DEADLINE_EXCEEDED,
+                            "In featureExtract: deadline passed waiting for"
+                            " the same image");
+        }
+        timer.fill(reply);
+        metrics.stages(timer);
+        metrics.faces(FrMetrics::kFeatureExtract, reply->rects().size(),
+                        reply->skipped().size());
         // std::cout << reply->rects().size() << ' '
         //         << reply->features().size() << std::endl;
         // std::string rtvS = saveImage(request->imagedata().c_str(),
@@ -222,27 +553,592 @@ class FrServiceImpl final : public Frecg::Service {
 
     Status featureDetect(ServerContext* context, const DetectRequest* request,
                     FeatureReply* reply) override {
+        if (!serving) {
+            return warmingUp();
+        }
+        FrAdmitScope admit(admission.get(), FrMetrics::kFeatureDetect,
+                            context->deadline());
+        if (!admit.admitted()) {
+            return rejection(admit.verdict());
+        }
+        FrRpcScope rpcScope(&metrics, FrMetrics::kFeatureDetect);
         // std::string rtvS = saveImage(request->imagedata().c_str(),
         //                                 request->imagedata().size());
+        FrStageTimer timer;
         reply->set_message("In featureDetect");
+        reply->set_encoding(replyEncoding(request->encoding()));
 
-        extract_feature((unsigned char *)request->imagedata().c_str(),
-                        request->imagedata().size(),
-                        reply,
-                        true,
-                        nullptr);
+        // Detection and extraction then quality scoring.
+        FrSchedClass work = schedClassOf(context, FrMetrics::kFeatureDetect);
+        bool decodable = true;
+        bool timely = true;
+        onCompute([&]() {
+            std::unique_ptr<FrImageContext> image = openImage(
+                                request->imagedata(), request->has_rawimage()
+                                ? &request->rawimage() : nullptr, 2,
+                                context->deadline());
+            if (!image) {
+                decodable = false;
+                return;
+            }
+            timely = coalescedExtract(*image,
+                                    reply,
+                                    true,
+                                    nullptr,
+                                    &timer,
+                                    work,
+                                    context->deadline());
+        });
+        if (!decodable) {
+            return Status(grpc::StatusCode::INVALID_ARGUMENT,
+                            "In featureDetect: bad raw image!!!");
+        }
+        if (workersLost()) {
+            return workersGone();
+        }
+        if (!timely) {
+            return Status(grpc::StatusCode::DEADLINE_EXCEEDED,
+                            "In featureDetect: deadline passed waiting for"
+                            " the same image");
+        }
+        timer.fill(reply);
+        metrics.stages(timer);
+        metrics.faces(FrMetrics::kFeatureDetect, reply->rects().size(),
+                        reply->skipped().size());
         // std::cout << reply->rects().size() << ' '
         //         << reply->features().size() << std::endl;
         return Status::OK;
     }
 
+    Status featureStream(ServerContext* context,
+                    ServerReaderWriter<FeatureReply, FrameRequest>* stream)
+                    override {
+        if (!serving) {
+            return warmingUp();
+        }
+        /**
+         * A reader thread pulls frames into a bounded queue while this
+         * thread serves them in order. Once the queue is full the reader
+         * stops reading, so flow control pushes back on the client.
+         */
+        FrBoundedQueue<FrameRequest> frames(framesInFlight);
+        std::thread reader([stream, &frames]() {
+            FrameRequest frame;
+            while (stream->Read(&frame)) {
+                if (!frames.push(std::move(frame))) {
+                    break;
+                }
+                frame.Clear();
+            }
+            frames.close();
+        });
+
+        FrSchedClass work = schedClassOf(context, FrMetrics::kFeatureStream);
+        FrameRequest frame;
+        bool lost = false;
+        while (frames.pop(&frame)) {
+            // The reply of each frame reuses the block of the previous one.
+            FrCallArena arena;
+            FeatureReply &reply = *arena.create<FeatureReply>();
+            reply.set_frameseq(frame.frameseq());
+            // Frames are admitted one by one, a frame turned away is
+            // answered without faces and the stream goes on.
+            FrAdmitScope admit(admission.get(), FrMetrics::kFeatureStream,
+                                context->deadline());
+            if (!admit.admitted()) {
+                reply.set_message(FrAdmission::kQueueFull == admit.verdict()
+                                ? "In featureStream: overloaded, frame dropped"
+                                : "In featureStream: late, frame dropped");
+                if (!stream->Write(reply)) {
+                    frames.close();
+                    context->TryCancel();
+                    break;
+                }
+                continue;
+            }
+            FrRpcScope rpcScope(&metrics, FrMetrics::kFeatureStream);
+            FrStageTimer timer;
+            reply.set_message("In featureStream");
+            reply.set_encoding(replyEncoding(frame.encoding()));
+            onCompute([&]() {
+                std::unique_ptr<FrImageContext> image = openImage(
+                                    frame.imagedata(), frame.has_rawimage()
+                                    ? &frame.rawimage() : nullptr, 2,
+                                    context->deadline());
+                if (!image) {
+                    reply.set_message("In featureStream: bad raw image!!!");
+                } else if (!coalescedExtract(*image,
+                                            &reply,
+                                            true,
+                                            nullptr,
+                                            &timer,
+                                            work,
+                                            context->deadline())) {
+                    reply.set_message("In featureStream: late, frame dropped");
+                }
+            });
+            if (workersLost()) {
+                // The reader may be blocked in Read() for as long as the
+                // client keeps the stream open, cancelling wakes it up.
+                frames.close();
+                context->TryCancel();
+                lost = true;
+                break;
+            }
+            timer.fill(&reply);
+            metrics.stages(timer);
+            metrics.faces(FrMetrics::kFeatureStream, reply.rects().size(),
+                            reply.skipped().size());
+            if (!stream->Write(reply)) {
+                // Client is gone, stop reading as well.
+                frames.close();
+                context->TryCancel();
+                break;
+            }
+        }
+        reader.join();
+        if (lost) {
+            return workersGone();
+        }
+        return context->IsCancelled() ? Status::CANCELLED : Status::OK;
+    }
+
+    Status enroll(ServerContext* context, const EnrollRequest* request,
+                    EnrollReply* reply) override {
+        if (!serving) {
+            return warmingUp();
+        }
+        FrAdmitScope admit(admission.get(), FrMetrics::kEnroll,
+                            context->deadline());
+        if (!admit.admitted()) {
+            return rejection(admit.verdict());
+        }
+        FrRpcScope rpcScope(&metrics, FrMetrics::kEnroll);
+        reply->set_message("In enroll");
+        if (request->id().empty()
+            || HIAR_FACE_FEATURE_LEN != request->feature().size()) {
+            reply->set_message("In enroll: id or feature length error!!!");
+        } else if (!(galleryStore
+                    ? galleryStore->enroll(request->id(),
+                                            request->feature().data())
+                    : gallery->enroll(request->id(),
+                                        request->feature().data()))) {
+            reply->set_message("In enroll: feature is all zeros!!!");
+        }
+        reply->set_gallerysize(gallery->size());
+        return Status::OK;
+    }
+
+    Status remove(ServerContext* context, const RemoveRequest* request,
+                    RemoveReply* reply) override {
+        if (!serving) {
+            return warmingUp();
+        }
+        FrAdmitScope admit(admission.get(), FrMetrics::kRemove,
+                            context->deadline());
+        if (!admit.admitted()) {
+            return rejection(admit.verdict());
+        }
+        FrRpcScope rpcScope(&metrics, FrMetrics::kRemove);
+        reply->set_message("In remove");
+        reply->set_removed(galleryStore ? galleryStore->remove(request->id())
+                                        : gallery->remove(request->id()));
+        reply->set_gallerysize(gallery->size());
+        return Status::OK;
+    }
+
+    Status identify(ServerContext* context, const IdentifyRequest* request,
+                    IdentifyReply* reply) override {
+        if (!serving) {
+            return warmingUp();
+        }
+        FrAdmitScope admit(admission.get(), FrMetrics::kIdentify,
+                            context->deadline());
+        if (!admit.admitted()) {
+            return rejection(admit.verdict());
+        }
+        FrRpcScope rpcScope(&metrics, FrMetrics::kIdentify);
+        reply->set_message("In identify");
+        if (HIAR_FACE_FEATURE_LEN != request->feature().size()) {
+            reply->set_message("In identify: feature length error!!!");
+            return Status::OK;
+        }
+        int topK = 0 < request->topk() ? request->topk() : 1;
+        FrSchedScope slot(scheduler.get(),
+                        schedClassOf(context, FrMetrics::kIdentify), 1);
+        std::vector<FrMatch> matches = gallery->identify(
+                            request->feature().data(), topK,
+                            request->minscore(), request->effort());
+        for (auto &match : matches) {
+            auto candidate = reply->add_matches();
+            candidate->set_id(match.id);
+            candidate->set_score(match.score);
+        }
+        return Status::OK;
+    }
+
+    Status getStats(ServerContext* context, const StatsRequest* request,
+                    StatsReply* reply) override {
+        FrRpcScope rpcScope(&metrics, FrMetrics::kGetStats);
+        reply->set_message("In getStats");
+        std::ostringstream text;
+        metrics.exposition(text);
+        reply->set_text(text.str());
+        return Status::OK;
+    }
+
     public:
         std::string imagesSaver = "./";
-        FrServiceImpl(std::string folder) {
+        /// Max frames of one stream queued before being served.
+        int framesInFlight = 4;
+        /// See ServerOptions::decodeOnce.
+        bool decodeOnce = false;
+        /// Quality gate, see ServerOptions.
+        int minQuality = 5;
+        float minDirection = 0;
+        bool qualityFirst = true;
+        FrServiceImpl(std::string folder, const ServerOptions &options,
+                        FrWorkerPool *workers)
+                : workers(workers) {
             imagesSaver = folder;
+            framesInFlight = options.streamWindow;
+            decodeOnce = options.decodeOnce;
+            minQuality = options.minQuality;
+            minDirection = options.minDirection;
+            qualityFirst = options.qualityFirst;
+            std::vector<int> cpus;
+            frResolveCpus(options.computeCpus, &cpus);
+            parallelPool.reset(new FrThreadPool(options.galleryThreads, cpus));
+            if (0 < options.computeThreads) {
+                // Buffers of a pinned worker are first touched on its node.
+                computePool.reset(new FrThreadPool(options.computeThreads,
+                                                    cpus));
+            }
+            std::cout << "Compute: " << (computePool
+                        ? std::to_string(options.computeThreads) + " threads"
+                        : std::string("rpc threads"));
+            if (!cpus.empty()) {
+                std::cout << " pinned to " << cpus.size() << " cpus from "
+                            << frNumaNodes().size() << " nodes";
+            }
+            std::cout << std::endl;
+            gallery.reset(new FrGallery(parallelPool.get()));
+            gallery->setIndex([options](const FrVectorStore *store) {
+                return frCreateAnnIndex(options.index, store,
+                                        options.hnsw, options.ivfpq);
+            });
+            std::cout << "Similarity kernel: " << frSimilarityKernel()
+                        << std::endl;
+            std::cout << "Gallery search: " << gallery->describeIndex()
+                        << std::endl;
+            if (0 < options.batchSize) {
+                FrExtractBatcher::Executor executor =
+                                        FrExtractBatcher::defaultExecutor;
+                if (workers) {
+                    using namespace std::placeholders;
+                    // A batch serves several requests, only the liveness
+                    // of the workers bounds its wait.
+                    executor = FrExtractBatcher::groupingExecutor(std::bind(
+                                        &FrWorkerPool::extractFeature,
+                                        workers, _1, _2, _3, _4, _5, _6,
+                                        FrWorkerPool::Deadline::max()));
+                }
+                batcher.reset(new FrExtractBatcher(options.batchSize,
+                                                    options.batchWaitUs,
+                                                    options.batchWorkers,
+                                                    executor));
+                FrExtractBatcher *batches = batcher.get();
+                metrics.addCollector([batches](std::ostream &os) {
+                    batches->exposition(os);
+                });
+            }
+            if (workers) {
+                metrics.addCollector([workers](std::ostream &os) {
+                    workers->exposition(os);
+                });
+            }
+            if (0 < options.featureCacheMb) {
+                featureCache.reset(new FrFeatureCache(
+                            static_cast<size_t>(options.featureCacheMb) << 20,
+                            options.featureCacheTtl, HIAR_FACE_FEATURE_LEN));
+                FrFeatureCache *cache = featureCache.get();
+                metrics.addCollector([cache](std::ostream &os) {
+                    cache->exposition(os);
+                });
+            }
+            if (options.admission) {
+                admission.reset(new FrAdmission(options.admissionLimits));
+                FrAdmission *limits = admission.get();
+                metrics.addCollector([limits](std::ostream &os) {
+                    limits->exposition(os);
+                });
+            }
+            if (0 <= options.schedSlots) {
+                scheduler.reset(new FrScheduler(options.schedSlots,
+                                                options.tenantWeights));
+                FrScheduler *slots = scheduler.get();
+                metrics.addCollector([slots](std::ostream &os) {
+                    slots->exposition(os);
+                });
+            }
+            if (options.coalesce) {
+                singleFlight.reset(new FrSingleFlight<SharedFaces>());
+                FrSingleFlight<SharedFaces> *flights = singleFlight.get();
+                metrics.addCollector([flights](std::ostream &os) {
+                    os << "# HELP fr_coalesced_total Requests served by an"
+                        << " identical one in flight.\n"
+                        << "# TYPE fr_coalesced_total counter\n"
+                        << "fr_coalesced_total " << flights->coalesced()
+                        << '\n';
+                });
+            }
+        }
+        /**
+         * @brief			    Load the gallery from a file and keep it there.
+         * @param[in] path 	    Gallery file, its log is path.wal.
+         * @param[out] error    Reason of a failure.
+         * @return			    False if the file or its log is unusable.
+         */
+        bool openGallery(const std::string &path,
+                        const FrGalleryStoreOptions &options,
+                        std::string *error) {
+            galleryStore.reset(new FrGalleryStore(gallery.get(), path,
+                                                    options));
+            if (!galleryStore->open(error)) {
+                galleryStore.reset();
+                return false;
+            }
+            return true;
+        }
+        /// Counters and latencies of every rpc.
+        FrMetrics metrics;
+        /// Let the rpcs in, once the recognizer and the gallery are ready.
+        void startServing() {
+            serving = true;
+        }
+        /**
+         * @brief			Run each SDK call on synthetic images, so that
+         *                  the first requests find the recognizer warm.
+         * @param[in] sizes Image sizes expected from the clients.
+         * @param[in] runs  Calls of each size, on every worker at once.
+         * @return			Void.
+         */
+        void warmUp(const std::vector<cv::Size> &sizes, int runs) {
+            int calls = runs * (workers ? workers->workers() : 1);
+            for (const cv::Size &size : sizes) {
+                // Noise: no face, but detection scans the whole image.
+                cv::Mat pixels(size, CV_8UC3);
+                cv::randu(pixels, cv::Scalar::all(0), cv::Scalar::all(255));
+                std::vector<uchar> jpeg;
+                cv::imencode(".jpg", pixels, jpeg);
+                int box[4] = {size.width / 4, size.height / 4,
+                                size.width / 2, size.height / 2};
+                std::vector<std::thread> threads;
+                for (int i = 0; i < calls; i++) {
+                    threads.emplace_back([this, &jpeg, &box]() {
+                        FrImageContext image(jpeg.data(),
+                                            static_cast<int>(jpeg.size()),
+                                            3, decodeOnce);
+                        int *face_bboxes = nullptr;
+                        int num_bbox = 0;
+                        float *feature = nullptr;
+                        int len_features = 0;
+                        detectAndExtract(image, &face_bboxes, &num_bbox,
+                                        &feature, &len_features);
+                        delete[] face_bboxes;
+                        delete[] feature;
+                        feature = nullptr;
+                        extractBoxes(image.sdkData(), image.sdkLen(), box, 1,
+                                    &feature, &len_features,
+                                    image.deadline());
+                        delete[] feature;
+                        int quality = 0;
+                        float direction = 0;
+                        qualityOf(image, box, 1, &quality, &direction);
+                    });
+                }
+                for (auto &thread : threads) {
+                    thread.join();
+                }
+            }
+        }
+        /// Print statistics gathered since startup.
+        void dumpStats(std::ostream &os) const {
+            if (workers) {
+                workers->dump(os);
+            }
+            if (admission) {
+                admission->dump(os);
+            }
+            if (scheduler) {
+                scheduler->dump(os);
+            }
+            if (batcher) {
+                batcher->dump(os);
+            }
+            if (featureCache) {
+                featureCache->dump(os);
+            }
+            if (singleFlight) {
+                os << "Coalesced requests: " << singleFlight->coalesced()
+                    << std::endl;
+            }
+            int unpinned = parallelPool->unpinned()
+                            + (computePool ? computePool->unpinned() : 0);
+            if (0 < unpinned) {
+                os << "Workers left unpinned: " << unpinned << std::endl;
+            }
         }
 
     private:
+        /// Set once startup is over, rpcs but logIn and getStats are
+        /// turned away before.
+        std::atomic<bool> serving{false};
+        /// Processes running the recognizer, null to run it here.
+        FrWorkerPool *workers = nullptr;
+        /// Queues and slots of the rpcs, null if disabled.
+        std::unique_ptr<FrAdmission> admission;
+        /// Slots of the recognizer calls, null if disabled.
+        std::unique_ptr<FrScheduler> scheduler;
+        /// Batches extractions of concurrent rpcs, null if disabled.
+        std::unique_ptr<FrExtractBatcher> batcher;
+        /// Threads splitting the work of one rpc, e.g. a gallery scan.
+        std::unique_ptr<FrThreadPool> parallelPool;
+        /// Threads decoding images and calling the recognizer for the
+        /// rpcs, null to do it on the rpc threads.
+        std::unique_ptr<FrThreadPool> computePool;
+        /// Enrolled faces searched by identify.
+        std::unique_ptr<FrGallery> gallery;
+        /// Persists the gallery, null if kept in memory only.
+        std::unique_ptr<FrGalleryStore> galleryStore;
+        /// Features of faces already extracted, null if disabled.
+        std::unique_ptr<FrFeatureCache> featureCache;
+        /// Faces of an extraction shared by coalesced requests.
+        struct SharedFaces {
+            FeatureReply faces;
+            /// False if a recognizer call failed, faces may be missing.
+            bool ok = false;
+        };
+        /// Extractions in flight by image and boxes, null if disabled.
+        std::unique_ptr<FrSingleFlight<SharedFaces>> singleFlight;
+
+        /// Run the image work of an rpc on the compute pool and wait for it.
+        void onCompute(const std::function<void()> &work) {
+            if (!computePool) {
+                work();
+                return;
+            }
+            computePool->submit(work).get();
+        }
+
+        /**
+         * Same contract as HiarFace_extractFeature on a context, faces
+         * already in the cache are not extracted again.
+         */
+        int extract(FrImageContext &image, const int *face_bboxes,
+                    const int num_bbox, float **feature, int *len_features) {
+            if (!featureCache || 0 >= num_bbox) {
+                return extractBoxes(image.sdkData(), image.sdkLen(),
+                            face_bboxes, num_bbox, feature, len_features,
+                            image.deadline());
+            }
+            const int len = HIAR_FACE_FEATURE_LEN;
+            std::vector<FrContentHash> keys(num_bbox);
+            float *merged = new float[num_bbox * len];
+            std::vector<int> missing;
+            std::vector<int> missing_bboxes;
+            for (int i = 0; i < num_bbox; i++) {
+                keys[i] = FrFeatureCache::keyOf(image.contentHash(),
+                                                face_bboxes + 4 * i);
+                if (!featureCache->lookup(keys[i], merged + i * len)) {
+                    missing.push_back(i);
+                    missing_bboxes.insert(missing_bboxes.end(),
+                                        face_bboxes + 4 * i,
+                                        face_bboxes + 4 * i + 4);
+                }
+            }
+            int ret = 1;
+            if (!missing.empty()) {
+                // Only now is the image decoded, if at all.
+                float *extracted = nullptr;
+                int len_extracted = 0;
+                ret = extractBoxes(image.sdkData(), image.sdkLen(),
+                                missing_bboxes.data(), missing.size(),
+                                &extracted, &len_extracted,
+                                image.deadline());
+                if (1 == ret && len_extracted
+                        == static_cast<int>(missing.size()) * len) {
+                    for (size_t j = 0; j < missing.size(); j++) {
+                        std::copy(extracted + j * len,
+                                extracted + (j + 1) * len,
+                                merged + missing[j] * len);
+                        featureCache->insert(keys[missing[j]],
+                                            extracted + j * len);
+                    }
+                } else if (1 == ret) {
+                    ret = 0;
+                }
+                delete[] extracted;
+            }
+            if (1 != ret) {
+                delete[] merged;
+                *feature = nullptr;
+                *len_features = 0;
+                return ret;
+            }
+            *feature = merged;
+            *len_features = num_bbox * len;
+            return ret;
+        }
+
+        /// FrFace_detectAndExtractFeature, on a worker when enabled.
+        int detectAndExtract(FrImageContext &image, int **face_bboxes,
+                            int *num_bbox, float **feature,
+                            int *len_features) {
+            if (workers) {
+                return workers->detectAndExtractFeature(image.sdkData(),
+                            image.sdkLen(), face_bboxes, num_bbox, feature,
+                            len_features, image.deadline());
+            }
+            return FrFace_detectAndExtractFeature(image, face_bboxes,
+                                        num_bbox, feature, len_features);
+        }
+
+        /// FrFace_getQualityFaceCrops, on a worker when enabled.
+        int qualityOf(FrImageContext &image, const int *face_bboxes,
+                        const int num_bbox, int *face_quality,
+                        float *face_direction) {
+            if (workers) {
+                return workers->getQualityFaceCrops(image.sdkData(),
+                            image.sdkLen(), face_bboxes, num_bbox,
+                            face_quality, face_direction, image.deadline());
+            }
+            return FrFace_getQualityFaceCrops(image, face_bboxes, num_bbox,
+                                            face_quality, face_direction);
+        }
+
+        /**
+         * Same contract as HiarFace_extractFeature,
+         * going through the batcher when enabled. A worker is waited for
+         * until the deadline at most.
+         */
+        int extractBoxes(const unsigned char *dataImage, const int lenImage,
+                        const int *face_bboxes, const int num_bbox,
+                        float **feature, int *len_features,
+                        std::chrono::system_clock::time_point deadline) {
+            if (batcher) {
+                return batcher->extract(dataImage, lenImage, face_bboxes,
+                                        num_bbox, feature, len_features);
+            }
+            if (workers) {
+                return workers->extractFeature(dataImage, lenImage,
+                            face_bboxes, num_bbox, feature, len_features,
+                            deadline);
+            }
+            return HiarFace_extractFeature(dataImage, lenImage, face_bboxes,
+                                        num_bbox, feature, len_features);
+        }
+
         std::string saveImage(const char *dataImage,
                                 const int lenImage) {
             /**
@@ -274,19 +1170,168 @@ class FrServiceImpl final : public Frecg::Service {
             }
         }
 
-        void extract_feature(const unsigned char *dataImage,
-                            const int lenImage, 
+        /**
+         * @brief			    Image of a request.
+         * @param[in] data 	    Encoded image file, must outlive the image.
+         * @param[in] raw 	    Raw pixels used instead when not null,
+         *                      must outlive the image.
+         * @param[in] sdkCalls  SDK calls planned on the image.
+         * @param[in] deadline  Deadline of the request.
+         * @return			    Null if the raw pixels are malformed.
+         */
+        std::unique_ptr<FrImageContext> openImage(const std::string &data,
+                                const RawImage *raw, int sdkCalls,
+                                std::chrono::system_clock::time_point deadline)
+                                const {
+            std::unique_ptr<FrImageContext> image;
+            if (nullptr == raw) {
+                image.reset(new FrImageContext(
+                                (const unsigned char *)data.c_str(),
+                                data.size(), sdkCalls, decodeOnce));
+                image->setDeadline(deadline);
+                return image;
+            }
+            auto begin = std::chrono::steady_clock::now();
+            cv::Mat bgr;
+            if (!frWrapPixels((const unsigned char *)raw->data().c_str(),
+                            raw->data().size(), raw->width(), raw->height(),
+                            raw->stride(),
+                            static_cast<FrPixelFormat>(raw->format()),
+                            &bgr)) {
+                return nullptr;
+            }
+            image.reset(new FrImageContext(bgr,
+                        std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - begin).count()));
+            image->setDeadline(deadline);
+            return image;
+        }
+
+        /**
+         * @brief			    Why a face fails the quality gate.
+         * @param[out] reason   Set if the face fails.
+         * @return			    False if the face passes.
+         */
+        bool rejectFace(int quality, float direction,
+                        SkippedFace::Reason *reason) const {
+            if (quality < minQuality) {
+                *reason = SkippedFace::LOW_QUALITY;
+                return true;
+            }
+            if (direction <= minDirection) {
+                *reason = SkippedFace::NOT_FRONTAL;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * extract_feature, run once for concurrent requests on the same
+         * image and boxes: the others wait for it and copy its faces, or
+         * extract on their own if it failed. False, with no faces, if the
+         * deadline passed while waiting.
+         */
+        bool coalescedExtract(FrImageContext &image,
+                            FeatureReply* reply,
+                            bool needDetect,
+                            const FeatureRequest* request,
+                            FrStageTimer *timer,
+                            const FrSchedClass &work,
+                            std::chrono::system_clock::time_point deadline) {
+            if (!singleFlight) {
+                extract_feature(image, reply, needDetect, request, timer,
+                                work);
+                return true;
+            }
+            // Detection and given boxes never share a key, nor encodings.
+            int32_t detect = needDetect && nullptr == request ? 1 : 0;
+            int32_t kind[2] = {detect, reply->encoding()};
+            FrContentHash key = frHash128(kind, sizeof(kind),
+                                            image.contentHash());
+            for (int i = 0; 0 == detect && i < request->rects().size();
+                    i++) {
+                int box[4] = {request->rects(i).left(),
+                            request->rects(i).top(),
+                            request->rects(i).width(),
+                            request->rects(i).height()};
+                key = FrFeatureCache::keyOf(key, box);
+            }
+            std::chrono::steady_clock::time_point begin
+                                        = std::chrono::steady_clock::now();
+            bool coalesced = false;
+            std::shared_ptr<const SharedFaces> shared = singleFlight->run(key,
+                        [&]() {
+                            // Served to others too, so not bounded by the
+                            // deadline of this request.
+                            auto own = image.deadline();
+                            image.setDeadline(
+                                std::chrono::system_clock::time_point::max());
+                            SharedFaces computed;
+                            computed.faces.set_encoding(reply->encoding());
+                            computed.ok = extract_feature(image,
+                                            &computed.faces, needDetect,
+                                            request, timer, work);
+                            image.setDeadline(own);
+                            return computed;
+                        }, deadline, &coalesced);
+            if (coalesced) {
+                timer->add("coalesced",
+                        std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - begin).count());
+            }
+            if (!shared) {
+                return false;
+            }
+            if (coalesced && !shared->ok) {
+                // An empty failed result is not the answer for this image.
+                extract_feature(image, reply, needDetect, request, timer,
+                                work);
+                return true;
+            }
+            const FeatureReply *faces = &shared->faces;
+            // Faces only, the message and frame of the reply are its own.
+            reply->mutable_rects()->MergeFrom(faces->rects());
+            reply->mutable_features()->MergeFrom(faces->features());
+            reply->mutable_packedfeatures()->append(faces->packedfeatures());
+            reply->mutable_skipped()->MergeFrom(faces->skipped());
+            return true;
+        }
+
+        /**
+         * Faces of an image into a reply, false if a recognizer call
+         * failed.
+         */
+        bool extract_feature(FrImageContext &image,
                             FeatureReply* reply,
                             bool needDetect,
-                            const FeatureRequest* request) {
+                            const FeatureRequest* request,
+                            FrStageTimer *timer,
+                            const FrSchedClass &work) {
+            // Transcode up front so that decoding is its own stage. A file
+            // handed to the SDK as it is gets decoded inside the SDK calls,
+            // which is counted in their stages instead.
+            image.sdkData();
+            if (image.decoded()) {
+                timer->add("decode", image.decodeMs());
+            }
             int *face_bboxes = nullptr;
             int num_bbox;
             float *feature = nullptr;
-            int len_features;
+            int len_features = 0;
+            int *face_quality = nullptr;
+            float *face_direction = nullptr;
+            // Box of each extracted feature.
+            std::vector<int> extracted;
             int ret =  0;
             if (needDetect && nullptr == request) {
-                ret = HiarFace_detectAndExtractFeature(dataImage, lenImage,
+                // Detection comes with extraction, faces are gated after.
+                FrSchedScope slot(scheduler.get(), work, 1);
+                FrStageScope stage(timer, "detect_extract");
+                ret = detectAndExtract(image,
                             &face_bboxes, &num_bbox, &feature, &len_features);
+                for (int i = 0; 1 == ret && i < num_bbox; i++) {
+                    extracted.push_back(i);
+                }
             } else {
                 num_bbox = request->rects().size();
                 face_bboxes = new int[4 * num_bbox];
@@ -296,67 +1341,93 @@ class FrServiceImpl final : public Frecg::Service {
                     face_bboxes[4 * i + 2] = request->rects(i).width();
                     face_bboxes[4 * i + 3] = request->rects(i).height();
                 }
-                // std::cout << "num_bbox!!!" << num_bbox << std::endl;
-                ret = HiarFace_extractFeature(dataImage, lenImage,
-                        face_bboxes, num_bbox, &feature, &len_features);
+                if (qualityFirst && 0 < num_bbox) {
+                    // Score all faces, extract only the ones passing.
+                    face_quality = new int[num_bbox]();
+                    face_direction = new float[num_bbox]();
+                    {
+                        FrSchedScope slot(scheduler.get(), work, num_bbox);
+                        FrStageScope stage(timer, "quality");
+                        ret = qualityOf(image, face_bboxes,
+                                    num_bbox, face_quality, face_direction);
+                    }
+                    std::vector<int> kept_bboxes;
+                    SkippedFace::Reason reason;
+                    for (int i = 0; 1 == ret && i < num_bbox; i++) {
+                        if (!rejectFace(face_quality[i], face_direction[i],
+                                        &reason)) {
+                            extracted.push_back(i);
+                            kept_bboxes.insert(kept_bboxes.end(),
+                                                face_bboxes + 4 * i,
+                                                face_bboxes + 4 * i + 4);
+                        }
+                    }
+                    if (!extracted.empty()) {
+                        FrSchedScope slot(scheduler.get(), work,
+                                            extracted.size());
+                        FrStageScope stage(timer, "extract");
+                        ret = extract(image,
+                                    kept_bboxes.data(), extracted.size(),
+                                    &feature, &len_features);
+                    }
+                } else {
+                    FrSchedScope slot(scheduler.get(), work, num_bbox);
+                    FrStageScope stage(timer, "extract");
+                    ret = extract(image,
+                            face_bboxes, num_bbox, &feature, &len_features);
+                    for (int i = 0; 1 == ret && i < num_bbox; i++) {
+                        extracted.push_back(i);
+                    }
+                }
             }
 
             if (ret != 1 || num_bbox < 1) {
                 std::cout << "No face !!!" << std::endl;
-                if (face_bboxes != nullptr) {
-                    delete[] face_bboxes;
-                    face_bboxes = nullptr;
-                }
-
-                if (feature != nullptr) {
-                    delete[] feature;
-                    feature = nullptr;
-                }
-                return;
-            }
-
-            if (len_features != num_bbox * HIAR_FACE_FEATURE_LEN) {
+            } else if (len_features
+                        != static_cast<int>(extracted.size())
+                            * HIAR_FACE_FEATURE_LEN) {
                 std::cout << "feature of face boxes are Error!" << std::endl;
-                if (face_bboxes != nullptr) {
-                    delete[] face_bboxes;
-                    face_bboxes = nullptr;
-                }
-
-                if (feature != nullptr) {
-                    delete[] feature;
-                    feature = nullptr;
+            } else {
+                bool scored = true;
+                if (nullptr == face_quality) {
+                    face_quality = new int[num_bbox]();
+                    face_direction = new float[num_bbox]();
+                    FrSchedScope slot(scheduler.get(), work, num_bbox);
+                    FrStageScope stage(timer, "quality");
+                    scored = 1 == qualityOf(image, face_bboxes,
+                                    num_bbox, face_quality, face_direction);
                 }
-                return;
-            }
-            
-            int *face_quality = new int[num_bbox];
-            float *face_direction = new float[num_bbox];
-            HiarFace_getQualityFaceCrops(dataImage, lenImage, face_bboxes,
-                                        num_bbox, face_quality, face_direction);
-            if (nullptr != face_quality) {
+                reserveFaces(reply, num_bbox, extracted.size());
+                size_t next = 0;
                 for (int i = 0; i < num_bbox; i++) {
-                    if (face_quality[i] < 5
-                        || face_direction[i] <= 0) {
+                    bool hasFeature = next < extracted.size()
+                                        && i == extracted[next];
+                    const float *faceFeature = hasFeature
+                            ? feature + next++ * HIAR_FACE_FEATURE_LEN
+                            : nullptr;
+                    SkippedFace::Reason reason = SkippedFace::NOT_SCORED;
+                    // Unscored faces are not known to pass the gate.
+                    if (!scored || rejectFace(face_quality[i],
+                                            face_direction[i], &reason)) {
                         std::cout << "Low quality occured!!!" << std::endl
                                     << "LTWH: "
-                                    << request->rects(i).left() << ' '
-                                    << request->rects(i).top() << ' '
-                                    << request->rects(i).width() << ' '
-                                    << request->rects(i).height() << std::endl;
+                                    << face_bboxes[i * 4] << ' '
+                                    << face_bboxes[i * 4 + 1] << ' '
+                                    << face_bboxes[i * 4 + 2] << ' '
+                                    << face_bboxes[i * 4 + 3] << std::endl;
+                        auto skipped = reply->add_skipped();
+                        setRect(skipped->mutable_rect(), face_bboxes + i * 4);
+                        skipped->set_reason(reason);
+                        skipped->set_quality(face_quality[i]);
+                        skipped->set_direction(face_direction[i]);
                         continue;
                     }
-                    auto rctface = reply->add_rects();
-                    rctface->set_left(face_bboxes[i * 4]);
-                    rctface->set_top(face_bboxes[i * 4 + 1]);
-                    rctface->set_width(face_bboxes[i * 4 + 2]);
-                    rctface->set_height(face_bboxes[i * 4 + 3]);
-
-                    for (int j = 0; j < HIAR_FACE_FEATURE_LEN; j++) {
-                        reply->add_features(
-                            feature[i * HIAR_FACE_FEATURE_LEN + j]);
-                    }
+                    setRect(reply->add_rects(), face_bboxes + i * 4);
+                    addFeature(reply, faceFeature);
                 }
+            }
 
+            if (face_quality != nullptr) {
                 delete[] face_quality;
                 face_quality = nullptr;
                 delete[] face_direction;
@@ -372,33 +1443,413 @@ class FrServiceImpl final : public Frecg::Service {
                 delete[] feature;
                 feature = nullptr;
             }
-            return;
+            return 1 == ret;
+        }
+
+        /// Encoding asked by a request, FLOATS if unknown to this server.
+        static FeatureEncoding replyEncoding(FeatureEncoding encoding) {
+            return facerecg::FeatureEncoding_IsValid(encoding)
+                    ? encoding : facerecg::FLOATS;
+        }
+
+        /// Add one feature to a reply in its encoding, in one copy.
+        static void addFeature(FeatureReply *reply, const float *feature) {
+            FrFeatureEncoding encoding =
+                            static_cast<FrFeatureEncoding>(reply->encoding());
+            if (kFrFloats == encoding) {
+                reply->mutable_features()->Add(feature,
+                                        feature + HIAR_FACE_FEATURE_LEN);
+            } else {
+                frPackFeature(encoding, feature, HIAR_FACE_FEATURE_LEN,
+                                reply->mutable_packedfeatures());
+            }
+        }
+
+        /// Size the faces of a reply once, ahead of adding them.
+        static void reserveFaces(FeatureReply *reply, int faces,
+                                    size_t features) {
+            reply->mutable_rects()->Reserve(reply->rects().size() + faces);
+            FrFeatureEncoding encoding =
+                            static_cast<FrFeatureEncoding>(reply->encoding());
+            if (kFrFloats == encoding) {
+                reply->mutable_features()->Reserve(reply->features().size()
+                                    + features * HIAR_FACE_FEATURE_LEN);
+            } else {
+                reply->mutable_packedfeatures()->reserve(
+                        reply->packedfeatures().size() + features
+                            * frPackedBytes(encoding, HIAR_FACE_FEATURE_LEN));
+            }
+        }
+
+        /**
+         * @brief			    Class of the recognizer calls of a request.
+         * @param[in] context   Its "fr-priority" metadata, "interactive",
+         *                      "normal" or "bulk", overrides the class of
+         *                      the rpc; its "fr-tenant" metadata names the
+         *                      tenant, the client address by default.
+         * @param[in] rpc 	    Rpc of the request.
+         * @return			    Class and tenant.
+         */
+        static FrSchedClass schedClassOf(const ServerContext *context,
+                                        FrMetrics::Rpc rpc) {
+            FrSchedClass work;
+            switch (rpc) {
+                case FrMetrics::kFeatureDetect:
+                case FrMetrics::kEnroll:
+                    // Full-image detection, mostly bulk ingestion.
+                    work.priority = kFrBulk;
+                    break;
+                case FrMetrics::kFeatureExtract:
+                case FrMetrics::kFeatureStream:
+                    work.priority = kFrNormal;
+                    break;
+                default:
+                    // Verification and search, a user waits for them.
+                    work.priority = kFrInteractive;
+                    break;
+            }
+            const auto &metadata = context->client_metadata();
+            auto priority = metadata.find("fr-priority");
+            if (metadata.end() != priority) {
+                frParsePriority(std::string(priority->second.data(),
+                                            priority->second.size()),
+                                &work.priority);
+            }
+            auto tenant = metadata.find("fr-tenant");
+            if (metadata.end() != tenant) {
+                work.tenant.assign(tenant->second.data(),
+                                    tenant->second.size());
+            } else {
+                // "ipv4:10.0.0.1:51234", the port changes by connection.
+                work.tenant = context->peer();
+                work.tenant = work.tenant.substr(0,
+                                            work.tenant.rfind(':'));
+            }
+            return work;
+        }
+
+        /// Status of a request arriving before startup is over.
+        static Status warmingUp() {
+            return Status(grpc::StatusCode::UNAVAILABLE,
+                            "Server warming up, try again later");
+        }
+
+        /// True once the recognizer workers are gone for good, their
+        /// supervisor dead: the calls of the request failed.
+        bool workersLost() {
+            return nullptr != workers && !workers->alive();
+        }
+
+        /// Status of a request whose recognizer workers are gone.
+        static Status workersGone() {
+            return Status(grpc::StatusCode::UNAVAILABLE,
+                            "Recognizer workers are gone");
+        }
+
+        /// Status of a request turned away by admission.
+        static Status rejection(FrAdmission::Verdict verdict) {
+            if (FrAdmission::kQueueFull == verdict) {
+                return Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                                "Server overloaded, try again later");
+            }
+            return Status(grpc::StatusCode::DEADLINE_EXCEEDED,
+                            "Deadline cannot be met by the queue");
+        }
+
+        /// Copy a LTWH box into a rect of a reply.
+        static void setRect(AbsRect *rect, const int *box) {
+            rect->set_left(box[0]);
+            rect->set_top(box[1]);
+            rect->set_width(box[2]);
+            rect->set_height(box[3]);
         }
 };
 
-void RunServer() {
-    std::string server_address("0.0.0.0:50051");
-    FrServiceImpl service("tmp/");
+/**
+ * Parse image sizes such as "640x480,1920x1080", false if malformed.
+ */
+bool parseSizes(const std::string &text, std::vector<cv::Size> *sizes) {
+    std::istringstream entries(text);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        int width = 0;
+        int height = 0;
+        char by = 0;
+        std::istringstream size(entry);
+        if (!(size >> width >> by >> height) || 'x' != by || !size.eof()
+            || 0 >= width || 0 >= height) {
+            return false;
+        }
+        sizes->push_back(cv::Size(width, height));
+    }
+    return true;
+}
+
+/**
+ * Find the value of "--key=value" in arguments, or the default one.
+ */
+std::string getArg(int argc, char** argv, const std::string &key,
+                    const std::string &defVal) {
+    std::string prefix = "--" + key + "=";
+    for (int i = 1; i < argc; i++) {
+        std::string arg_val = argv[i];
+        if (0 == arg_val.compare(0, prefix.size(), prefix)) {
+            return arg_val.substr(prefix.size());
+        }
+    }
+    return defVal;
+}
+
+/**
+ * Serve until shutdown, false if the server could not start or load its
+ * models or gallery.
+ */
+bool RunServer(const ServerOptions &options, FrWorkerPool *workers,
+                const std::string &model_path,
+                const std::string &logger_path) {
+    // Phases of the startup, logged once serving.
+    FrStageTimer startup;
+    std::string server_address(options.address);
+    FrServiceImpl service("tmp/", options, workers);
+    std::unique_ptr<FrMetricsHttp> metricsHttp;
+    if (0 < options.metricsPort) {
+        metricsHttp.reset(new FrMetricsHttp(&service.metrics,
+                                            options.metricsPort,
+                                            options.metricsAddress));
+        if (!metricsHttp->listening()) {
+            std::cout << "Metrics port " << options.metricsAddress << ':'
+                        << options.metricsPort << " unavailable!!!"
+                        << std::endl;
+        }
+    }
+    std::unique_ptr<FrAsyncServer> asyncServer;
 
     grpc::EnableDefaultHealthCheckService(true);
     grpc::reflection::InitProtoReflectionServerBuilderPlugin();
     ServerBuilder builder;
     // Listen on the given address without any authentication mechanism.
     builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
-    // Register "service" as the instance through which we'll communicate with
-    // clients. In this case it corresponds to an *synchronous* service.
-    builder.RegisterService(&service);
+    if ("async" == options.mode) {
+        // Register an *asynchronous* service driven by our own pollers,
+        // each rpc is still served by the logic of "service".
+        asyncServer.reset(new FrAsyncServer(&service, options.cqs,
+                                            options.pollers,
+                                            options.asyncHandlers));
+        asyncServer->attach(builder);
+    } else {
+        // Register "service" as the instance through which we'll communicate with
+        // clients. In this case it corresponds to an *synchronous* service.
+        builder.RegisterService(&service);
+        if (0 < options.ioThreads) {
+            grpc::ResourceQuota quota("fr_io_threads");
+            quota.SetMaxThreads(options.ioThreads);
+            builder.SetResourceQuota(quota);
+        }
+    }
     // Finally assemble the server.
     server = std::unique_ptr<Server>(builder.BuildAndStart());
-    std::cout << "Server listening ON " << server_address << std::endl;
+    if (!server) {
+        std::cout << "Server building failed!!!" << std::endl;
+        return false;
+    }
+    // Probes reach the port at once and see it not serving until warm.
+    grpc::HealthCheckServiceInterface *health
+                                    = server->GetHealthCheckService();
+    if (nullptr != health) {
+        health->SetServingStatus(false);
+    }
+    if (asyncServer) {
+        asyncServer->start();
+    }
+    startup.add("listen", startup.totalMs());
+    std::cout << "Server listening ON " << server_address
+                << " (" << options.mode << "), NOT_SERVING" << std::endl;
+
+    // Models load while the gallery does; workers load theirs at once.
+    bool loaded = false;
+    double modelsMs = 0;
+    std::string modelsError = "initial Recognizer is failure!";
+    std::thread models([&]() {
+        FrStageTimer timer;
+        loaded = workers ? workers->waitReady(&modelsError)
+                : 1 == HiarFace_initRecognizer(model_path.c_str(),
+                                                logger_path.c_str());
+        modelsMs = timer.totalMs();
+    });
+    std::string error;
+    bool galleryLoaded = true;
+    {
+        FrStageScope stage(&startup, "gallery");
+        galleryLoaded = options.galleryPath.empty()
+                        || service.openGallery(options.galleryPath,
+                                                options.galleryStore, &error);
+    }
+    models.join();
+    startup.add("models", modelsMs);
+    if (!loaded || !galleryLoaded) {
+        if (!loaded) {
+            std::cout << modelsError << std::endl;
+        }
+        if (!galleryLoaded) {
+            std::cout << "Gallery loading failed: " << error << std::endl;
+        }
+        server->Shutdown();
+    } else {
+        {
+            FrStageScope stage(&startup, "warmup");
+            service.warmUp(options.warmupSizes, options.warmupRuns);
+        }
+        service.startServing();
+        if (nullptr != health) {
+            health->SetServingStatus(true);
+        }
+        std::cout << "Startup:";
+        for (const auto &stage : startup.stages()) {
+            std::cout << ' ' << stage.first << ' ' << stage.second << " ms";
+        }
+        std::cout << ", SERVING after " << startup.totalMs() << " ms"
+                    << std::endl;
+    }
 
     // Wait for the server to shutdown. Note that some other thread must be
     // responsible for shutting down the server for this call to ever return.
     server->Wait();
+    if (asyncServer) {
+        asyncServer->stop();
+    }
+    service.dumpStats(std::cout);
+    if (loaded && !workers) {
+        HiarFace_releaseRecognizer();
+    }
+    return loaded && galleryLoaded;
 }
 
 int main(int argc, char** argv) {
     signal(SIGINT, sigint_handler);
+    // Options of --config=file come after the command line ones, which
+    // getArg finds first.
+    std::vector<std::string> args(argv, argv + argc);
+    std::string config = getArg(argc, argv, "config", "");
+    std::string error;
+    if (!config.empty() && !frReadConfig(config, &args, &error)) {
+        std::cout << "Bad --config: " << error << std::endl;
+        return 1;
+    }
+    std::vector<char *> argPointers;
+    for (std::string &arg : args) {
+        argPointers.push_back(&arg[0]);
+    }
+    argc = static_cast<int>(argPointers.size());
+    argv = argPointers.data();
+    ServerOptions options;
+    options.mode = getArg(argc, argv, "mode", options.mode);
+    options.cqs = std::stoi(getArg(argc, argv, "cqs",
+                                    std::to_string(options.cqs)));
+    options.pollers = std::stoi(getArg(argc, argv, "pollers",
+                                        std::to_string(options.pollers)));
+    options.asyncHandlers = std::stoi(getArg(argc, argv, "async_handlers",
+                                    std::to_string(options.asyncHandlers)));
+    options.streamWindow = std::stoi(getArg(argc, argv, "stream_window",
+                                    std::to_string(options.streamWindow)));
+    options.batchSize = std::stoi(getArg(argc, argv, "batch",
+                                    std::to_string(options.batchSize)));
+    options.batchWaitUs = std::stoi(getArg(argc, argv, "batch_wait_us",
+                                    std::to_string(options.batchWaitUs)));
+    options.batchWorkers = std::stoi(getArg(argc, argv, "batch_workers",
+                                    std::to_string(options.batchWorkers)));
+    options.galleryThreads = std::stoi(getArg(argc, argv, "gallery_threads",
+                                    std::to_string(options.galleryThreads)));
+    options.index = getArg(argc, argv, "index", options.index);
+    options.hnsw.M = std::stoi(getArg(argc, argv, "hnsw_m",
+                                    std::to_string(options.hnsw.M)));
+    options.hnsw.efConstruction = std::stoi(getArg(argc, argv,
+                                "hnsw_ef_construction",
+                                std::to_string(options.hnsw.efConstruction)));
+    options.hnsw.efSearch = std::stoi(getArg(argc, argv, "hnsw_ef_search",
+                                    std::to_string(options.hnsw.efSearch)));
+    options.ivfpq.nlist = std::stoi(getArg(argc, argv, "ivf_nlist",
+                                    std::to_string(options.ivfpq.nlist)));
+    options.ivfpq.nprobe = std::stoi(getArg(argc, argv, "ivf_nprobe",
+                                    std::to_string(options.ivfpq.nprobe)));
+    options.ivfpq.subvectors = std::stoi(getArg(argc, argv, "pq_m",
+                                std::to_string(options.ivfpq.subvectors)));
+    options.ivfpq.refine = std::stoi(getArg(argc, argv, "ivf_refine",
+                                    std::to_string(options.ivfpq.refine)));
+    options.ivfpq.retrain = std::stof(getArg(argc, argv, "ivf_retrain",
+                                    std::to_string(options.ivfpq.retrain)));
+    options.galleryPath = getArg(argc, argv, "gallery", options.galleryPath);
+    options.galleryStore.syncWal = "1" == getArg(argc, argv, "wal_sync", "0");
+    options.galleryStore.compactBytes = std::stoul(getArg(argc, argv,
+                    "compact_mb",
+                    std::to_string(options.galleryStore.compactBytes >> 20)))
+                    << 20;
+    options.galleryStore.verify = "1" == getArg(argc, argv,
+                                                "gallery_verify", "0");
+    options.decodeOnce = "1" == getArg(argc, argv, "decode_once", "0");
+    options.minQuality = std::stoi(getArg(argc, argv, "min_quality",
+                                    std::to_string(options.minQuality)));
+    options.minDirection = std::stof(getArg(argc, argv, "min_direction",
+                                    std::to_string(options.minDirection)));
+    options.qualityFirst = "0" != getArg(argc, argv, "quality_first", "1");
+    options.metricsPort = std::stoi(getArg(argc, argv, "metrics_port",
+                                    std::to_string(options.metricsPort)));
+    options.metricsAddress = getArg(argc, argv, "metrics_address",
+                                    options.metricsAddress);
+    options.featureCacheMb = std::stoi(getArg(argc, argv, "feature_cache_mb",
+                                    std::to_string(options.featureCacheMb)));
+    options.featureCacheTtl = std::stod(getArg(argc, argv,
+                                    "feature_cache_ttl",
+                                    std::to_string(options.featureCacheTtl)));
+    options.coalesce = "0" != getArg(argc, argv, "coalesce", "1");
+    options.admission = "0" != getArg(argc, argv, "admission", "1");
+    options.admissionLimits.maxConcurrent = std::stoi(getArg(argc, argv,
+                    "max_concurrent",
+                    std::to_string(options.admissionLimits.maxConcurrent)));
+    options.admissionLimits.maxQueue = std::stoi(getArg(argc, argv,
+                    "max_queue",
+                    std::to_string(options.admissionLimits.maxQueue)));
+    options.schedSlots = std::stoi(getArg(argc, argv, "sched_slots",
+                                    std::to_string(options.schedSlots)));
+    if (!FrScheduler::parseWeights(getArg(argc, argv, "tenant_weights", ""),
+                                    &options.tenantWeights)) {
+        std::cout << "Bad --tenant_weights, e.g. kiosk:4,ingest:1"
+                    << std::endl;
+        return 1;
+    }
+    options.address = getArg(argc, argv, "address", options.address);
+    options.ioThreads = std::stoi(getArg(argc, argv, "io_threads",
+                                    std::to_string(options.ioThreads)));
+    options.computeThreads = std::stoi(getArg(argc, argv, "compute_threads",
+                                    std::to_string(options.computeThreads)));
+    options.computeCpus = getArg(argc, argv, "compute_cpus",
+                                options.computeCpus);
+    std::vector<int> cpus;
+    if (!frResolveCpus(options.computeCpus, &cpus)) {
+        std::cout << "Bad --compute_cpus, e.g. all, node:0 or 0-7,16-23"
+                    << std::endl;
+        return 1;
+    }
+    options.workers = std::stoi(getArg(argc, argv, "workers",
+                                    std::to_string(options.workers)));
+    options.workerPool.workers = options.workers;
+    options.workerPool.slots = std::stoi(getArg(argc, argv, "worker_slots",
+                                    std::to_string(options.workerPool.slots)));
+    options.workerPool.slotBytes = std::stoul(getArg(argc, argv,
+                    "worker_slot_mb",
+                    std::to_string(options.workerPool.slotBytes >> 20)))
+                    << 20;
+    std::string warmupSizes = getArg(argc, argv, "warmup_sizes", "-");
+    if ("-" != warmupSizes) {
+        options.warmupSizes.clear();
+        if (!parseSizes(warmupSizes, &options.warmupSizes)) {
+            std::cout << "Bad --warmup_sizes, e.g. 640x480,1920x1080"
+                        << std::endl;
+            return 1;
+        }
+    }
+    options.warmupRuns = std::stoi(getArg(argc, argv, "warmup_runs",
+                                    std::to_string(options.warmupRuns)));
+
     //设置logger
     std::string logger_path = "logs/log.txt";
     // 模型文件路径，该路径下的mcnn文件夹下是人脸检测模型，r50文件夹下是人脸识别模型
@@ -406,16 +1857,24 @@ int main(int argc, char** argv) {
 
     std::cout << logger_path << " " << model_path << std::endl;
 
-    int ret = HiarFace_initRecognizer(model_path.c_str(), logger_path.c_str());
-
-    if (1 != ret) {
-        std::cout << "initial Recognizer is failure!" << std::endl;
-        return 0;
+    std::unique_ptr<FrWorkerPool> workers;
+    if (0 < options.workers) {
+        // Forked before the server starts any thread.
+        options.workerPool.modelPath = model_path;
+        options.workerPool.loggerPath = logger_path;
+        workers.reset(new FrWorkerPool(options.workerPool));
+        if (!workers->start(&error)) {
+            std::cout << "initial Recognizer workers is failure: " << error
+                        << std::endl;
+            return 1;
+        }
     }
-    
-    RunServer();
 
-    HiarFace_releaseRecognizer();
+    bool served = RunServer(options, workers.get(), model_path, logger_path);
+
+    if (workers) {
+        workers->stop();
+    }
     std::cout << "Server shutdown~" << std::endl;
-    return 0;
+    return served ? 0 : 1;
 }
\ No newline at end of file